@@ -0,0 +1,347 @@
+#include "mandelbrot.h"
+#include "kernels.h"
+#include "headless.h"
+
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <algorithm>
+#include <chrono>
+
+// regression baseline: every kernel the cpu supports over a fixed catalog of views,
+// median and p99 wall time of a frame, ns/pixel, iterations/second and speedup over naive,
+// as a table on stdout and as json
+
+// static ---------------------------------------------------------------------
+
+struct BenchView {
+    const char* name;
+    const char* job; // ParseJob format, size and output are replaced
+};
+
+// job centers keep every digit, the deep one needs perturbation
+static const BenchView kViews[] = {
+    {"default",  "-0.5,0,1,0x0,253,-"},
+    {"interior", "-0.1,0.05,0.05,0x0,253,-"},
+    {"boundary", "-0.745,0.11,0.01,0x0,1000,-"},
+    {"exterior", "1.5,1.5,0.3,0x0,253,-"},
+    {"deep",     "-1.99999911758766165543764649989479,0,1e-13,0x0,1000,-"},
+};
+
+static const size_t kNumViews = sizeof(kViews) / sizeof(kViews[0]);
+
+static const size_t kDefaultWidth  = 640;
+static const size_t kDefaultHeight = 360;
+static const size_t kDefaultRuns   = 11;
+static const size_t kWarmupRuns    = 2;
+static const size_t kMaxRuns       = 1000;
+
+struct BenchOptions {
+    size_t width;
+    size_t height;
+    size_t runs;
+    size_t n_threads;
+    const char* view;   // nullptr runs the whole catalog
+    const char* kernel; // nullptr runs every supported kernel
+    const char* json;   // nullptr writes no json, "-" is stdout
+    bool refill;        // lane refill tile kernels, see MSet::refill
+    size_t interleave;  // 0 keeps the factor of every kernel table, see MSet::interleave
+};
+
+struct BenchResult {
+    const char* view;
+    const char* kernel;
+    const char* precision;
+
+    double median_ns;
+    double p99_ns;
+    double ns_per_pixel;
+    double iterations_per_second;
+    double speedup; // over naive on the same view, 0 if naive did not run
+};
+
+static bool ParseOptions(int argc, char** argv, BenchOptions* options);
+static void PinThread();
+static bool RunView(Mandelbrot::MSet* m_set, const BenchOptions& options, const BenchView& view,
+                    BenchResult* results, size_t* n_results);
+static void MeasureKernel(Mandelbrot::MSet* m_set, size_t runs, uint64_t* times);
+static uint64_t CountIterations(const Mandelbrot::MSet* m_set);
+static void PrintTable(FILE* stream, const BenchResult* results, size_t n_results);
+static bool WriteJson(const char* path, const BenchOptions& options, const BenchResult* results, size_t n_results);
+
+// global ---------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    BenchOptions options = {};
+    options.width  = kDefaultWidth;
+    options.height = kDefaultHeight;
+    options.runs   = kDefaultRuns;
+    options.n_threads = 1;
+
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr, "usage: %s [--size WxH] [--runs N] [--threads N] [--view name] [--kernel name] [--refill] [--interleave 1|2|4] [--json file]\n"
+                        "views:", argv[0]);
+        for (size_t i = 0; i < kNumViews; i++) {
+            fprintf(stderr, " %s", kViews[i].name);
+        }
+        fprintf(stderr, "\n");
+
+        return 1;
+    }
+
+    PinThread();
+
+    Mandelbrot::MSet m_set = {};
+    if (Mandelbrot::SetUp(&m_set, options.width, options.height, options.n_threads) != Mandelbrot::Error::kOk) {
+        fprintf(stderr, "# Error: bad alloc or size %zux%zu\n",
+                options.width, options.height);
+        Mandelbrot::TearDown(&m_set);
+
+        return 1;
+    }
+
+    m_set.refill = options.refill;
+    m_set.interleave = options.interleave;
+
+    size_t max_results = kNumViews * Mandelbrot::KernelCount();
+    BenchResult* results = (BenchResult*)calloc(max_results, sizeof(BenchResult));
+    if (results == nullptr) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        Mandelbrot::TearDown(&m_set);
+
+        return 1;
+    }
+
+    size_t n_results = 0;
+    bool ok = true;
+    for (size_t i = 0; i < kNumViews && ok; i++) {
+        if (options.view == nullptr || strcmp(options.view, kViews[i].name) == 0) {
+            ok = RunView(&m_set, options, kViews[i], results, &n_results);
+        }
+    }
+
+    // json on stdout keeps it parsable, the table moves to stderr then
+    if (ok) {
+        bool json_stdout = (options.json != nullptr && strcmp(options.json, "-") == 0);
+        PrintTable(json_stdout ? stderr : stdout, results, n_results);
+    }
+
+    if (ok && options.json != nullptr) {
+        ok = WriteJson(options.json, options, results, n_results);
+        if (!ok) {
+            fprintf(stderr, "# Error: can not write %s\n", options.json);
+        }
+    }
+
+    free(results);
+    Mandelbrot::TearDown(&m_set);
+
+    return ok ? 0 : 1;
+}
+
+// static ---------------------------------------------------------------------
+
+static bool ParseOptions(int argc, char** argv, BenchOptions* options) {
+    assert(argv != nullptr);
+    assert(options != nullptr);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%zux%zu", &options->width, &options->height) != 2) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            options->runs = strtoul(argv[++i], nullptr, 10);
+            if (options->runs == 0 || options->runs > kMaxRuns) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->n_threads = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--view") == 0 && i + 1 < argc) {
+            options->view = argv[++i];
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            options->kernel = argv[++i];
+        } else if (strcmp(argv[i], "--refill") == 0) {
+            options->refill = true;
+        } else if (strcmp(argv[i], "--interleave") == 0 && i + 1 < argc) {
+            options->interleave = strtoul(argv[++i], nullptr, 10);
+            if (options->interleave != 1 && options->interleave != 2 && options->interleave != 4) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            options->json = argv[++i];
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// keeps the measuring thread on one core, so its caches and clock stay the same between runs,
+// pool workers (--threads above 1) are left to the scheduler
+static void PinThread() {
+    int cpu = sched_getcpu();
+    if (cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((size_t)cpu, &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "# Warning: can not pin the bench thread to cpu %d\n", cpu);
+    }
+}
+
+// naive goes last in the kernel list, so speedups are filled in once the whole view is done
+static bool RunView(Mandelbrot::MSet* m_set, const BenchOptions& options, const BenchView& view,
+                    BenchResult* results, size_t* n_results) {
+    assert(m_set != nullptr);
+    assert(results != nullptr);
+    assert(n_results != nullptr);
+
+    RenderJob job = {};
+    if (!ParseJob(view.job, &job)) {
+        fprintf(stderr, "# Error: bad catalog view %s\n", view.name);
+        return false;
+    }
+
+    SetJobView(m_set, &job);
+
+    uint64_t* times = (uint64_t*)calloc(options.runs, sizeof(uint64_t));
+    if (times == nullptr) {
+        return false;
+    }
+
+    size_t first = *n_results;
+    double naive_ns = 0.0;
+    double n_pixels = (double)(m_set->width * m_set->height);
+
+    for (size_t i = 0; i < Mandelbrot::KernelCount(); i++) {
+        const Mandelbrot::KernelTable* kernels = Mandelbrot::KernelAt(i);
+        if (!kernels->supported() || (options.kernel != nullptr && strcmp(options.kernel, kernels->name) != 0
+                                      && strcmp(kernels->name, "naive") != 0)) {
+            continue;
+        }
+
+        m_set->kernels = kernels;
+        MeasureKernel(m_set, options.runs, times);
+
+        BenchResult* result = &results[(*n_results)++];
+        result->view      = view.name;
+        result->kernel    = kernels->name;
+        result->precision = Mandelbrot::PrecisionName(m_set->used_precision);
+
+        // nearest rank
+        result->median_ns = (double)times[options.runs / 2];
+        result->p99_ns    = (double)times[(options.runs * 99 + 99) / 100 - 1];
+
+        result->ns_per_pixel = result->median_ns / n_pixels;
+        result->iterations_per_second = (double)CountIterations(m_set) * 1e9 / result->median_ns;
+
+        if (strcmp(kernels->name, "naive") == 0) {
+            naive_ns = result->median_ns;
+        }
+    }
+
+    for (size_t i = first; i < *n_results; i++) {
+        results[i].speedup = (naive_ns > 0.0) ? naive_ns / results[i].median_ns : 0.0;
+    }
+
+    // naive only ran as the baseline of the asked kernel
+    if (options.kernel != nullptr && strcmp(options.kernel, "naive") != 0 && *n_results > first) {
+        (*n_results)--;
+    }
+
+    free(times);
+
+    return true;
+}
+
+// sorted wall times of runs frames in ns, after a few warmup frames,
+// every frame is drawn from scratch
+static void MeasureKernel(Mandelbrot::MSet* m_set, size_t runs, uint64_t* times) {
+    assert(m_set != nullptr);
+    assert(times != nullptr);
+
+    using Clock = std::chrono::steady_clock;
+
+    for (size_t i = 0; i < kWarmupRuns; i++) {
+        Mandelbrot::Invalidate(m_set);
+        Mandelbrot::Compute(m_set);
+    }
+
+    for (size_t i = 0; i < runs; i++) {
+        Mandelbrot::Invalidate(m_set);
+
+        Clock::time_point start = Clock::now();
+        Mandelbrot::Compute(m_set);
+        times[i] = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    std::sort(times, times + runs);
+}
+
+// iterations the frame stands for: escaped pixels their count, interior ones max_iter,
+// so kernels which skip the interior are credited with the work they avoided
+static uint64_t CountIterations(const Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    uint64_t n_iterations = 0;
+    for (size_t i = 0; i < m_set->width * m_set->height; i++) {
+        n_iterations += std::min((size_t)m_set->iter_counts[i], m_set->max_iter);
+    }
+
+    return n_iterations;
+}
+
+static void PrintTable(FILE* stream, const BenchResult* results, size_t n_results) {
+    assert(stream != nullptr);
+    assert(results != nullptr);
+
+    fprintf(stream, "%10s %8s %13s %12s %12s %10s %10s %9s\n",
+            "view", "kernel", "precision", "median ms", "p99 ms", "ns/pixel", "Giter/s", "speedup");
+
+    for (size_t i = 0; i < n_results; i++) {
+        const BenchResult& result = results[i];
+        fprintf(stream, "%10s %8s %13s %12.3f %12.3f %10.2f %10.3f %8.2fx\n",
+                result.view, result.kernel, result.precision, result.median_ns / 1e6, result.p99_ns / 1e6,
+                result.ns_per_pixel, result.iterations_per_second / 1e9, result.speedup);
+    }
+}
+
+static bool WriteJson(const char* path, const BenchOptions& options, const BenchResult* results, size_t n_results) {
+    assert(path != nullptr);
+    assert(results != nullptr);
+
+    FILE* file = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"width\": %zu,\n  \"height\": %zu,\n  \"runs\": %zu,\n  \"threads\": %zu,\n"
+                  "  \"refill\": %s,\n  \"interleave\": %zu,\n  \"results\": [\n",
+            options.width, options.height, options.runs, options.n_threads, options.refill ? "true" : "false",
+            options.interleave);
+
+    for (size_t i = 0; i < n_results; i++) {
+        const BenchResult& result = results[i];
+        fprintf(file, "    {\"view\": \"%s\", \"kernel\": \"%s\", \"precision\": \"%s\", "
+                      "\"median_ns\": %.0f, \"p99_ns\": %.0f, \"ns_per_pixel\": %.4f, "
+                      "\"iterations_per_second\": %.6g, \"speedup_over_naive\": %.4f}%s\n",
+                result.view, result.kernel, result.precision, result.median_ns, result.p99_ns,
+                result.ns_per_pixel, result.iterations_per_second, result.speedup,
+                (i + 1 < n_results) ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+
+    bool ok = (ferror(file) == 0);
+    if (file != stdout) {
+        ok = (fclose(file) == 0) && ok;
+    }
+
+    return ok;
+}
@@ -0,0 +1,17 @@
+#ifndef ANTIALIAS_H_
+#define ANTIALIAS_H_
+
+#include "kernels.h"
+
+namespace Mandelbrot {
+    // pixels of the tile whose count differs from one of their four neighbours (every pixel with
+    // Antialias::kFull) get the mean color of kAntialiasGrid x kAntialiasGrid jittered samples,
+    // which go through the point kernels in full vectors; counts of the frame stay as they are,
+    // so neighbour tiles may be resampled at the same time; returns how many samples it took
+    size_t ComputeAntialiased(const Frame& frame, Tile tile);
+
+    // resampled pixels and extra samples per pixel of the last Compute
+    void PrintAntialias(FILE* stream, const MSet* m_set);
+}
+
+#endif // ANTIALIAS_H_
@@ -3,6 +3,39 @@
 
 #include <stdint.h>
 
+#include "mandelbrot.h"
+
 uint64_t GetTime();
 
-#endif // BENCH_H_
\ No newline at end of file
+// computes the current view with 1..max_threads threads and prints speedup over 1 thread
+void ReportThreadScaling(Mandelbrot::MSet* m_set, size_t max_threads);
+
+// computes the current view with float, double and perturbation kernels, prints throughput of each
+void ReportPrecisionThroughput(Mandelbrot::MSet* m_set);
+
+// computes the current view with and without interior checks,
+// prints both times and how many pixels came out different
+void ReportInteriorChecks(Mandelbrot::MSet* m_set);
+
+// computes the current view per pixel and with subdivision, prints both times,
+// the fraction of pixels subdivision iterated and how many pixels came out different
+void ReportSubdivision(Mandelbrot::MSet* m_set);
+
+// computes the current view from scratch and panned by a few pixels, prints both times,
+// the fraction of pixels a pan iterated and how many pixels differ from a full recompute
+void ReportPanLatency(Mandelbrot::MSet* m_set);
+
+// computes the current view in one call and progressively, prints time of the full frame,
+// of the first coarse frame, of the slowest refining call, how many calls refining took
+// and how many pixels of the refined frame differ from the full one
+void ReportProgressive(Mandelbrot::MSet* m_set);
+
+// computes the current view, then only recolors it from plain and smoothed counts,
+// prints ticks per pixel of the frame and of both recoloring passes
+void ReportColorize(Mandelbrot::MSet* m_set);
+
+// computes the current view without antialiasing, resampling only edges and resampling every pixel,
+// prints times, samples per pixel and the mean color error and number of pixels different from the last
+void ReportAntialias(Mandelbrot::MSet* m_set);
+
+#endif // BENCH_H_
@@ -0,0 +1,31 @@
+#ifndef CLUSTER_H_
+#define CLUSTER_H_
+
+#include <stdio.h>
+
+#include "mandelbrot.h"
+
+// a coordinator listens on an address, "unix:/path" or "host:port", and worker processes of the same
+// build connect to it; a frame goes out as tiles (view, tile rectangle, max_iter, precision), every
+// worker computes its tile with ComputeRect and sends the counts back run length coded, the coordinator
+// puts them into its own frame and colors it; a tile of a worker which died or got stuck goes to another one
+struct Cluster;
+
+// listens on address, nullptr if it can not; workers may connect at any time from here on
+Cluster* CreateCluster(const char* address);
+
+// closes every worker link, which is what tells the workers to quit
+void DestroyCluster(Cluster* cluster);
+
+// counts of the whole frame of m_set from the workers, the same a local Compute gives with the same
+// kernels, colored here; subdivision, progressive passes, the tile cache and antialiasing do not apply
+Mandelbrot::Error ComputeOnCluster(Cluster* cluster, Mandelbrot::MSet* m_set);
+
+// tiles, workers, retries and bytes on the wire so far
+void PrintCluster(FILE* stream, const Cluster* cluster);
+
+// connects to the coordinator at address and computes the tiles it sends until it closes the link;
+// kernels, threads and refill are the worker's own, everything that changes pixels comes with the tile
+Mandelbrot::Error RunWorker(Mandelbrot::MSet* m_set, const char* address);
+
+#endif // CLUSTER_H_
@@ -3,13 +3,23 @@
 
 #include <SFML/Window/Keyboard.hpp>
 #include <stddef.h>
+#include <stdint.h>
 
 // window config --------------------------------------------------------------
 
+// frame size without --size, the window is fullscreen then
 static const unsigned int kWindowWidth = 1920;
 static const unsigned int kWindowHight = 1080;
 static const char*        kWindowTitle [[maybe_unused]] = "Mandelbrot!" ;
 
+// frames go to the screen through this many long lived textures in turn
+static const size_t kScreenTextures = 2;
+
+// the compute thread hands frames to the window through a ring of this many pixel buffers,
+// the window draws at most kFrameRateLimit frames a second and reads input between them
+static const size_t       kFrameQueueSlots = 3;
+static const unsigned int kFrameRateLimit  = 60;
+
 static const sf::Keyboard::Key kButtonMoveLeft    = sf::Keyboard::Left;
 static const sf::Keyboard::Key kButtonMoveRight   = sf::Keyboard::Right;
 static const sf::Keyboard::Key kButtonMoveUp      = sf::Keyboard::Up;
@@ -18,14 +28,106 @@ static const sf::Keyboard::Key kButtonDefaultView = sf::Keyboard::Num0;
 static const sf::Keyboard::Key kButtonZoomIn      = sf::Keyboard::Z;
 static const sf::Keyboard::Key kButtonZoomOut     = sf::Keyboard::X;
 static const sf::Keyboard::Key kButtonQuit        = sf::Keyboard::Q;
+static const sf::Keyboard::Key kButtonCycleColors = sf::Keyboard::C;
+static const sf::Keyboard::Key kButtonSmoothColors = sf::Keyboard::S;
 
 // compute config -------------------------------------------------------------
 
+// defaults of --max-iter and --bailout, both are runtime settings of the frame
 static const size_t kMaxIteration = 253;
+static const double kEscapeRadius = 2.0;
+
+// headless jobs with more rgba bytes than this are computed and written in strips of full rows,
+// memory stays about 4 * kStripBytes (pixels, counts, |z|^2 and the copy being written) at any size
+static const size_t kStripBytes = 64 << 20;
+
+// largest --bailout, |z|^4 of a lane one step past it still fits in float
+static const double kMaxEscapeRadius = 1 << 16;
+
+// zoom videos resample frames from an exponential map around the zoom center computed kZoomChunkRows
+// rows at a time; pixels near the center of the last frames need deep rows few other pixels use,
+// so a square of 2 * kZoomCenterPixels around the center of every frame is computed directly instead
+static const size_t kZoomCenterPixels = 16;
+static const size_t kZoomChunkRows    = 32;
+
+// --serve hands frames out to --worker processes in kClusterTileWidth x kClusterTileHight tiles;
+// a worker which holds a tile longer than kClusterTimeoutMs is dropped and the tile goes to another one,
+// a tile lost kClusterRetries times fails the job, so does kClusterWaitMs without any worker connected;
+// a link which does not say hello within kClusterHelloMs is closed without holding up the tiles,
+// workers keep trying to connect for kClusterConnectMs, so they may start before the coordinator
+static const unsigned int kClusterTileWidth = 256;
+static const unsigned int kClusterTileHight = 64;
+static const unsigned int kClusterTimeoutMs = 60000;
+static const unsigned int kClusterHelloMs   = 2000;
+static const unsigned int kClusterRetries   = 3;
+static const unsigned int kClusterWaitMs    = 30000;
+static const unsigned int kClusterConnectMs = 10000;
+
+// auto precision switches to double kernels when pixel step drops below
+// this fraction of the largest coordinate in the frame (float has 24 bit mantissa)
+static const double kFloatPrecisionLimit = 1.0 / (1 << 16);
+
+// same for double (53 bit mantissa) and perturbation
+static const double kDoublePrecisionLimit = 1.0 / (1ull << 42);
+
+// iteration count and |z|^2 buffers start on a cache line, which is also a whole avx-512 vector
+static const size_t kBufferAlign = 64;
+
+// lane stops as interior when its orbit comes back closer than
+// this fraction of the pixel step to a saved point (periodicity check)
+static const double kPeriodTolerance = 1.0 / 1024;
+
+// view origin is rounded to 1 / kViewQuant of a pixel step, the rest is a whole number of pixels,
+// so a pan is drawn by shifting the old frame when the view moved by whole pixels
+static const int64_t kViewQuant = 64;
+
+// frame is split into tiles which are spread over the thread pool,
+// tile width has to be a multiple of the widest simd group (16), the frame width does not
+static const unsigned int kTileWidth = 64;
+static const unsigned int kTileHight = 32;
+
+// --tile-cache keeps kTileCacheTiles tiles in memory (16 KiB each) and kTileCacheSlots in the file
+// of --tile-cache-file; tiles are blocks of whole pixel steps from 0 of the plane, so overlapping views
+// share the tiles they both cover; tile origins are rounded to 1 / kTileCacheQuant of a pixel step and
+// the lowest kTileCacheStepBits bits of the step are dropped, closer views than that share tiles
+static const size_t   kTileCacheTiles    = 4096;
+static const size_t   kTileCacheSlots    = 16384;
+static const int64_t  kTileCacheQuant    = 64;
+static const unsigned kTileCacheStepBits = 16;
+
+// --antialias takes kAntialiasGrid x kAntialiasGrid samples in every edge pixel, one jittered point
+// in each cell of the grid; the jitter is the same in every pixel and every frame, so a still edge stays still
+static const size_t kAntialiasGrid = 4;
+
+// lane refill kernels run fixed groups for this many iterations and refill lanes only with
+// the pixels still iterating then, handing a pixel over costs about as much as a few trips
+static const size_t kRefillTrips = 32;
+
+// subdivision works on bigger tiles, a rectangle is not split further
+// when its inside has at most kSubdivideMinArea pixels
+static const unsigned int kSubdivideTileSide = 256;
+static const unsigned int kSubdivideMinArea  = 64;
+
+// progressive frames start at every kProgressiveStep-th pixel in both directions
+// and halve the step pass by pass, refining stops for the frame after
+// kFrameBudgetMs and goes on in the next one (0 means one pass per frame)
+static const unsigned int kProgressiveStep = 8;
+static const unsigned int kFrameBudgetMs   = 12;
+
+// one cycle of the palette is resampled to kPaletteLutSize colors (a power of two),
+// 8 KiB of lut stays in L1 next to the rows being colored; palette files have at most
+// kMaxPaletteColors colors, 0xRRGGBBAA like mcolor.h, kInteriorColor is for points which never escape
+static const size_t   kPaletteLutSize   = 2048;
+static const size_t   kMaxPaletteColors = kPaletteLutSize;
+static const uint32_t kInteriorColor    = 0x000000FF;
 
-// #define COMPUTE_NAIVE 1
-// #define COMPUTE_ARRAY 1
-#define COMPUTE_SIMD 1
 // #define LOG_TIME 1
 
+// kernels count their iterations, lane utilization, escape counts and tile ticks into MSet::stats,
+// the window and headless jobs print them after every frame (stats.h), costs about a store per vector
+// #define KERNEL_STATS 1
+
+// escape histogram bin k holds counts in [2^(k - 1), 2^k), bin 0 holds count 0
+static const size_t kStatsBins = 33;
+
 #endif // CONFIG_H_
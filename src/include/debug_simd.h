@@ -5,8 +5,11 @@
 #include <stdio.h>
 #include <stdint.h>
 
-void PrintYValueFloat(__m256 value);
-void PrintYValueDouble(__m256d value);
-void PrintYValueInt(__m256i value);
+// binary is built for baseline x86-64, these are only called from avx2 kernels
+#define DEBUG_SIMD_TARGET __attribute__((target("avx2")))
+
+DEBUG_SIMD_TARGET void PrintYValueFloat(__m256 value);
+DEBUG_SIMD_TARGET void PrintYValueDouble(__m256d value);
+DEBUG_SIMD_TARGET void PrintYValueInt(__m256i value);
 
 #endif // DEBUG_SIMD_H_
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "config.h"
+#include "mandelbrot.h"
+
+// what the window asked for since the engine last looked, requests merge as they come in,
+// so a slow frame is followed by the latest view and never by the views in between
+struct ViewRequest {
+    bool reset;    // default view first, drops the pans and zooms posted before it
+    double pan_x;  // pixels of the current scale
+    double pan_y;
+    double zoom;   // scale multiplier, 1 keeps it
+
+    int32_t palette_shift; // iterations
+    bool toggle_smooth;
+};
+
+// finished frame, the window shows it while the engine computes the next one
+struct FrameSlot {
+    sf::Uint8* pixels;
+    size_t width;
+    size_t height;
+    size_t frame_id; // MSet::frame_id it was copied at
+};
+
+// lock free single producer single consumer ring: the engine fills slots at head,
+// the window reads at tail, each side only ever writes its own index
+struct FrameQueue {
+    FrameSlot slots[kFrameQueueSlots];
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+// compute thread owning the MSet: takes the latest request, computes it (and refines
+// a progressive frame while nothing new comes in), hands every new frame to the queue,
+// sleeps when the frame is complete, so input and drawing never wait for compute
+struct Engine {
+    Mandelbrot::MSet* m_set;
+    FrameQueue queue;
+
+    std::thread thread;
+    std::mutex lock; // guards request, n_requests and quit
+    std::condition_variable changed;
+
+    ViewRequest request;
+    size_t n_requests; // posted so far, the engine compares it with the ones it took
+    std::atomic<bool> quit;
+};
+
+ViewRequest EmptyRequest();
+
+// next as if it was applied after request
+void MergeRequest(ViewRequest* request, const ViewRequest& next);
+
+// slots are allocated for the current size of m_set, which the engine owns until StopEngine
+Mandelbrot::Error StartEngine(Engine* engine, Mandelbrot::MSet* m_set);
+void StopEngine(Engine* engine);
+
+// merges request into the one the engine has not taken yet
+void PostRequest(Engine* engine, const ViewRequest& request);
+
+// newest finished frame or nullptr, older ones are dropped unseen,
+// the slot stays valid until ReleaseFrame
+const FrameSlot* AcquireFrame(Engine* engine);
+void ReleaseFrame(Engine* engine);
+
+#endif // ENGINE_H_
@@ -0,0 +1,28 @@
+#ifndef EXPMAP_H_
+#define EXPMAP_H_
+
+#include "kernels.h"
+
+namespace Mandelbrot {
+    // log-polar grid around the view center for zoom videos: row k, column j is the point
+    // center + radius * exp(-2 pi k / n_angles) * (cos, sin)(2 pi j / n_angles), so cells are about
+    // square and every row is the row above it zoomed in by exp(2 pi / n_angles)
+    struct ExpMap {
+        double radius;
+        size_t n_angles;
+        double* cos_table; // n_angles each, one per column
+        double* sin_table;
+    };
+
+    Error SetUpExpMap(ExpMap* map, double radius, size_t n_angles);
+    void TearDownExpMap(ExpMap* map);
+
+    // of a row, fractional rows are between two of them
+    double ExpMapRadius(const ExpMap& map, double row);
+
+    // n_angles rgba pixels of the row through the offset kernels and KernelTable::colorize_points,
+    // frame view corner is the center of the map
+    void ComputeExpRow(const Frame& frame, const ExpMap& map, size_t row, uint32_t* pixels);
+}
+
+#endif // EXPMAP_H_
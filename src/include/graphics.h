@@ -10,8 +10,23 @@
 
 #include "config.h"
 #include "mandelbrot.h"
+#include "engine.h"
 
-void Render(sf::RenderWindow& window, const Mandelbrot::MSet& m_set);
-void CheckWindowEvents(sf::RenderWindow& window, Mandelbrot::MSet* m_set);
+// textures live as long as the window: a new frame is uploaded into the texture which was not
+// drawn last, so the upload does not wait for the gpu to finish with the previous frame,
+// and nothing is allocated per frame unless the frame size changes
+struct Screen {
+    sf::Texture textures[kScreenTextures];
+    sf::Sprite sprite;
+
+    size_t front; // texture the sprite shows
+    bool valid;
+};
+
+// uploads frame if there is a new one (not nullptr), draws the newest one uploaded
+void Render(sf::RenderWindow& window, Screen* screen, const FrameSlot* frame);
+
+// merges what the keys ask for into request, returns false if they asked for nothing
+bool CheckWindowEvents(sf::RenderWindow& window, ViewRequest* request);
 
 #endif // GRAPHICS_CFG_H_
\ No newline at end of file
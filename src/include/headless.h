@@ -0,0 +1,45 @@
+#ifndef HEADLESS_H_
+#define HEADLESS_H_
+
+#include <stddef.h>
+
+#include "mandelbrot.h"
+#include "cluster.h"
+
+static const size_t kMaxPathLen = 256;
+
+// one frame of batch rendering, center is a point of the complex plane,
+// scale has the same meaning as MSet::scale (1.0 is the default view)
+struct RenderJob {
+    HpReal center_x; // parsed with all the digits given, deep zooms need them
+    HpReal center_y;
+    double scale;
+
+    size_t width;
+    size_t height;
+    size_t max_iter;
+
+    char output[kMaxPathLen]; // .png, .ppm, raw rgba otherwise, "-" is raw rgba to stdout
+};
+
+// "re,im,scale,WxH,max_iter,output"
+bool ParseJob(const char* spec, RenderJob* job);
+
+// jobs array is grown with realloc, caller frees it
+bool AppendJob(RenderJob** jobs, size_t* n_jobs, const RenderJob* job);
+
+// one job per line in ParseJob format, empty lines and lines starting with '#' are skipped
+bool ReadJobFile(const char* path, RenderJob** jobs, size_t* n_jobs);
+
+// points m_set at the center, scale and max_iter of the job, size is up to Resize
+void SetJobView(Mandelbrot::MSet* m_set, const RenderJob* job);
+
+// computes jobs in order, strip N is written by a separate thread while strip N + 1 is computed;
+// a job bigger than kStripBytes goes in strips of full rows, so memory does not grow with the image,
+// and saves its progress after every strip; with resume a job goes on from its saved progress
+// and one whose output exists without progress is skipped as done; with a cluster the strips
+// are computed by its workers, nullptr computes them here
+Mandelbrot::Error RenderJobs(Mandelbrot::MSet* m_set, const RenderJob* jobs, size_t n_jobs, bool resume,
+                             Cluster* cluster);
+
+#endif // HEADLESS_H_
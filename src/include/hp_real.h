@@ -0,0 +1,25 @@
+#ifndef HP_REAL_H_
+#define HP_REAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fixed point two's complement number: limb[kHpLimbs - 1] is the signed integer part,
+// the rest is fraction, which gives 32 * (kHpLimbs - 1) = 416 bits (about 1e-125) after the point
+static const size_t kHpLimbs = 14;
+
+struct HpReal {
+    uint32_t limb[kHpLimbs]; // least significant first
+};
+
+HpReal HpFromDouble(double value);
+double HpToDouble(const HpReal& value);
+
+// "[+-]digits[.digits]", integer part has to fit in int32_t
+bool HpParse(const char* str, HpReal* value);
+
+HpReal HpAdd(const HpReal& a, const HpReal& b);
+HpReal HpSub(const HpReal& a, const HpReal& b);
+HpReal HpMul(const HpReal& a, const HpReal& b);
+
+#endif // HP_REAL_H_
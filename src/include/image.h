@@ -0,0 +1,59 @@
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum class ImageFormat {
+    kPng = 0,
+    kPpm = 1,
+    kRaw = 2, // rgba bytes without header
+};
+
+// by extension: .png, .ppm, everything else is raw rgba
+ImageFormat FormatFromPath(const char* path);
+
+bool WriteImage(FILE* file, ImageFormat format, const uint8_t* rgba, size_t width, size_t height);
+
+// png is written row by row with stored (uncompressed) deflate blocks,
+// so rows can be streamed out without holding the whole image
+struct PngWriter {
+    FILE* file;
+    size_t width;
+    size_t height;
+    size_t rows_written;
+
+    uint32_t adler_a;
+    uint32_t adler_b;
+};
+
+bool PngBegin(PngWriter* png, FILE* file, size_t width, size_t height);
+bool PngWriteRows(PngWriter* png, const uint8_t* rgba, size_t n_rows);
+bool PngEnd(PngWriter* png);
+
+// continues a png whose first rows_written rows are already in the file, which is positioned
+// right after them; adler is PngAdler of the writer which wrote them
+void PngResume(PngWriter* png, FILE* file, size_t width, size_t height, size_t rows_written, uint32_t adler);
+uint32_t PngAdler(const PngWriter* png);
+
+// image of any format written a band of rows at a time, so it never has to be in memory whole
+struct ImageWriter {
+    FILE* file;
+    ImageFormat format;
+    size_t width;
+    size_t height;
+    size_t rows_written;
+
+    PngWriter png;
+};
+
+bool ImageBegin(ImageWriter* image, FILE* file, ImageFormat format, size_t width, size_t height);
+bool ImageWriteRows(ImageWriter* image, const uint8_t* rgba, size_t n_rows);
+bool ImageEnd(ImageWriter* image);
+
+// same as PngResume for any format, adler only matters for png
+void ImageResume(ImageWriter* image, FILE* file, ImageFormat format, size_t width, size_t height,
+                 size_t rows_written, uint32_t adler);
+
+#endif // IMAGE_H_
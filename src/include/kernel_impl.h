@@ -0,0 +1,1293 @@
+#ifndef KERNEL_IMPL_H_
+#define KERNEL_IMPL_H_
+
+// kernel bodies shared by every instruction set,
+// included by kernels_<isa>.cpp after its target pragma and its simd_<isa>.h
+//
+// Simd is a set of static functions over one vector type:
+// Real (kLanes floats or doubles), Mask (result of Less), Count (iteration counter per lane),
+// Index (perturbation orbit index per lane), see simd_scalar.h for the plainest one
+//
+// Formula is the iteration the float and double kernels run, one type per formula (MandelbrotFormula and
+// the rest below), picked by WithFormula once per tile, so the loops themselves never branch on it
+//
+// kernels only write iteration counts and |z|^2 at escape, pixels are colored from them by ColorizeTile
+// with the palette lut
+
+#include "kernels.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+// full vectors go straight to the frame buffers, lanes past the tile edge are computed but not stored;
+// without kMagnitudes the |z|^2 buffer is not touched at all, the frame is memory bound enough as it is
+template <typename Simd, bool kMagnitudes>
+void StoreLanes(Mandelbrot::MSet* m_set, size_t pos, int32_t n_lanes,
+                typename Simd::Count iter_count, typename Simd::Real escape_mag) {
+    if (n_lanes >= Simd::kLanes) {
+        Simd::StoreCounts(iter_count, m_set->iter_counts + pos);
+        if constexpr (kMagnitudes) {
+            Simd::StoreMagnitudes(escape_mag, m_set->magnitudes + pos);
+        }
+        return;
+    }
+
+    uint32_t counts[Simd::kLanes] = {};
+    Simd::StoreCounts(iter_count, counts);
+    std::copy_n(counts, n_lanes, m_set->iter_counts + pos);
+
+    if constexpr (kMagnitudes) {
+        float magnitudes[Simd::kLanes] = {};
+        Simd::StoreMagnitudes(escape_mag, magnitudes);
+        std::copy_n(magnitudes, n_lanes, m_set->magnitudes + pos);
+    }
+}
+
+// KERNEL_STATS only: active_count is how many iterations each lane was active in,
+// iter_count what it stores, interior lanes have max_iter + 1 there
+template <typename Simd>
+void RecordLanes(typename Simd::Count active_count, typename Simd::Count iter_count, size_t max_iter) {
+    uint32_t active[Simd::kLanes] = {};
+    uint32_t counts[Simd::kLanes] = {};
+    Simd::StoreCounts(active_count, active);
+    Simd::StoreCounts(iter_count, counts);
+
+    Mandelbrot::RecordVector(active, counts, Simd::kLanes, max_iter);
+}
+
+// |z|^2 a lane escapes at, the same for every kernel of the frame
+template <typename Simd>
+typename Simd::Real EscapeRadius(const Mandelbrot::MSet* m_set) {
+    return Simd::Set1(m_set->escape_radius * m_set->escape_radius);
+}
+
+// coordinates of pixel column x and row y (plus a sample offset inside the pixel), see Viewport:
+// each one is rounded from double on its own, so a pixel gets the same one whatever kernel, group
+// or lane computes it, and keeps it when a pan shifts it
+inline double PixelReal(const Mandelbrot::Viewport& view, int64_t x, double sample) {
+    return view.x0 + ((double)(view.origin_x + x) + sample) * view.step;
+}
+
+inline double PixelImag(const Mandelbrot::Viewport& view, int64_t y, double sample) {
+    return view.y0 + ((double)(view.origin_y + y) + sample) * view.step;
+}
+
+// real parts of the tile columns, every row of the tile loads its groups from them;
+// lanes past the tile edge read zeros
+template <typename Simd>
+void TileReals(const Mandelbrot::Viewport& view, Mandelbrot::Tile tile, typename Simd::Scalar* reals) {
+    assert(tile.x_end - tile.x_begin <= (int32_t)kTileWidth);
+
+    for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+        reals[x - tile.x_begin] = (typename Simd::Scalar)PixelReal(view, x, 0.0);
+    }
+}
+
+// main cardioid: q * (q + (x - 1/4)) < y^2 / 4, where q = (x - 1/4)^2 + y^2,
+// period 2 bulb: (x + 1)^2 + y^2 < 1/16, points inside never escape
+template <typename Simd>
+typename Simd::Mask InsideMainComponents(typename Simd::Real real, typename Simd::Real imag) {
+    typedef typename Simd::Real Real;
+
+    Real y_sqr   = Simd::Mul(imag, imag);
+    Real x_shift = Simd::Sub(real, Simd::Set1(0.25));
+    Real q       = Simd::MulAdd(x_shift, x_shift, y_sqr);
+    Real x_bulb  = Simd::Add(real, Simd::Set1(1.0));
+
+    typename Simd::Mask cardioid = Simd::Less(Simd::Mul(q, Simd::Add(q, x_shift)), 
+                                              Simd::Mul(y_sqr, Simd::Set1(0.25)));
+    typename Simd::Mask bulb     = Simd::Less(Simd::MulAdd(x_bulb, x_bulb, y_sqr), Simd::Set1(1.0 / 16.0));
+
+    return Simd::Or(cardioid, bulb);
+}
+
+// z' = z^2 + c from z = 0, c is the pixel;
+// Start gives z and c of a vector of pixels, Step is one iteration, it takes x^2 and y^2 from the escape test;
+// kMainComponents says InsideMainComponents holds, the cycle check holds for every formula
+template <typename Simd>
+struct MandelbrotFormula {
+    typedef typename Simd::Real Real;
+
+    static const bool kMainComponents = true;
+
+    explicit MandelbrotFormula(const Mandelbrot::MSet*) {}
+
+    void Start(Real real, Real imag, Real* x, Real* y, Real* c_x, Real* c_y) const {
+        *x   = Simd::Zero();
+        *y   = Simd::Zero();
+        *c_x = real;
+        *c_y = imag;
+    }
+
+    static void Step(Real* x, Real* y, Real x_mul, Real y_mul, Real c_x, Real c_y) {
+        Real tmp = Simd::Add(Simd::Sub(x_mul, y_mul), c_x);
+        *y = Simd::MulAdd(Simd::Add(*x, *x), *y, c_y);
+        *x = tmp;
+    }
+};
+
+// the same z^2 + c, but z starts at the pixel and c is the one of the whole frame
+template <typename Simd>
+struct JuliaFormula {
+    typedef typename Simd::Real Real;
+
+    static const bool kMainComponents = false;
+
+    Real julia_x;
+    Real julia_y;
+
+    explicit JuliaFormula(const Mandelbrot::MSet* m_set)
+        : julia_x(Simd::Set1(m_set->julia_x)), julia_y(Simd::Set1(m_set->julia_y)) {}
+
+    void Start(Real real, Real imag, Real* x, Real* y, Real* c_x, Real* c_y) const {
+        *x   = real;
+        *y   = imag;
+        *c_x = julia_x;
+        *c_y = julia_y;
+    }
+
+    static void Step(Real* x, Real* y, Real x_mul, Real y_mul, Real c_x, Real c_y) {
+        MandelbrotFormula<Simd>::Step(x, y, x_mul, y_mul, c_x, c_y);
+    }
+};
+
+// z' = z^3 + c or z^4 + c from z = 0:
+// (x + iy)^3 = x (x^2 - 3y^2) + i y (3x^2 - y^2), (x + iy)^4 = (a + ib)^2 with a = x^2 - y^2, b = 2xy
+template <typename Simd, int kPower>
+struct MultibrotFormula {
+    static_assert(kPower == 3 || kPower == 4, "only z^3 and z^4 are written out");
+
+    typedef typename Simd::Real Real;
+
+    static const bool kMainComponents = false;
+
+    explicit MultibrotFormula(const Mandelbrot::MSet*) {}
+
+    void Start(Real real, Real imag, Real* x, Real* y, Real* c_x, Real* c_y) const {
+        MandelbrotFormula<Simd>(nullptr).Start(real, imag, x, y, c_x, c_y);
+    }
+
+    static void Step(Real* x, Real* y, Real x_mul, Real y_mul, Real c_x, Real c_y) {
+        if constexpr (kPower == 3) {
+            Real three = Simd::Set1(3.0);
+
+            Real tmp = Simd::MulAdd(*x, Simd::Sub(x_mul, Simd::Mul(three, y_mul)), c_x);
+            *y = Simd::MulAdd(*y, Simd::Sub(Simd::Mul(three, x_mul), y_mul), c_y);
+            *x = tmp;
+        } else {
+            Real a = Simd::Sub(x_mul, y_mul);
+            Real b = Simd::Mul(Simd::Add(*x, *x), *y);
+
+            *x = Simd::Add(Simd::Sub(Simd::Mul(a, a), Simd::Mul(b, b)), c_x);
+            *y = Simd::MulAdd(Simd::Add(a, a), b, c_y);
+        }
+    }
+};
+
+// z' = (|x| + i |y|)^2 + c from z = 0, the imaginary part is 2 |x| |y| + c_y
+template <typename Simd>
+struct BurningShipFormula {
+    typedef typename Simd::Real Real;
+
+    static const bool kMainComponents = false;
+
+    explicit BurningShipFormula(const Mandelbrot::MSet*) {}
+
+    void Start(Real real, Real imag, Real* x, Real* y, Real* c_x, Real* c_y) const {
+        MandelbrotFormula<Simd>(nullptr).Start(real, imag, x, y, c_x, c_y);
+    }
+
+    static void Step(Real* x, Real* y, Real x_mul, Real y_mul, Real c_x, Real c_y) {
+        Real tmp = Simd::Add(Simd::Sub(x_mul, y_mul), c_x);
+        *y = Simd::MulAdd(Simd::Abs(Simd::Add(*x, *x)), Simd::Abs(*y), c_y);
+        *x = tmp;
+    }
+};
+
+// calls kernel(formula) with the formula of m_set, the dispatchers below do it once per tile or batch of points
+template <typename Simd, typename Kernel>
+void WithFormula(const Mandelbrot::MSet* m_set, Kernel kernel) {
+    switch (m_set->formula) {
+        case Mandelbrot::Formula::kJulia:
+            kernel(JuliaFormula<Simd>(m_set));
+            return;
+        case Mandelbrot::Formula::kMultibrot3:
+            kernel(MultibrotFormula<Simd, 3>(m_set));
+            return;
+        case Mandelbrot::Formula::kMultibrot4:
+            kernel(MultibrotFormula<Simd, 4>(m_set));
+            return;
+        case Mandelbrot::Formula::kBurningShip:
+            kernel(BurningShipFormula<Simd>(m_set));
+            return;
+        case Mandelbrot::Formula::kMandelbrot:
+        default:
+            kernel(MandelbrotFormula<Simd>(m_set));
+            return;
+    }
+}
+
+// interior lanes (inside the main components or caught in a cycle) stop iterating
+// and get max_iter + 1, the count they would reach by iterating to the end, and zero |z|^2 like
+// every lane that never escapes;
+// with kMagnitudes |z|^2 of a lane is taken on every iteration it was still active before,
+// so it stops at the escape one, it costs a blend per iteration and is only done when asked for;
+// cycles are found Brent style: z is saved at iterations 2^k - 1 and each following
+// z is compared with it, so any period up to 2^k is caught within 2^(k+1) iterations;
+// with a running mask the loop stops after max_trips, lanes still iterating then are set in it
+// and their count and |z|^2 mean nothing
+template <typename Simd, typename Formula, bool kInteriorChecks, bool kMagnitudes>
+typename Simd::Count CheckPixel(const Formula& formula, typename Simd::Real real, typename Simd::Real imag,
+                                size_t max_iter, typename Simd::Real radius, typename Simd::Real period_eps,
+                                typename Simd::Real* escape_mag,
+                                size_t max_trips = SIZE_MAX, typename Simd::Mask* running = nullptr) {
+    typedef typename Simd::Real Real;
+    typedef typename Simd::Mask Mask;
+
+    Real x = Simd::Zero();
+    Real y = Simd::Zero();
+    Real c_x = Simd::Zero();
+    Real c_y = Simd::Zero();
+    formula.Start(real, imag, &x, &y, &c_x, &c_y);
+
+    typename Simd::Count iter_count = Simd::CountZero();
+
+    Real mag = Simd::Zero();
+    Mask was_active = Simd::Less(mag, radius); // all lanes
+
+    Mask interior = {}; // no lanes
+    Real saved_x = Simd::Zero();
+    Real saved_y = Simd::Zero();
+    size_t next_save = 1;
+
+    if constexpr (kInteriorChecks && Formula::kMainComponents) {
+        interior = InsideMainComponents<Simd>(c_x, c_y);
+    }
+
+    size_t n_trips = std::min(max_iter, max_trips - 1) + 1;
+    Mask last_active = {};
+
+    for (size_t iter = 0; iter < n_trips; iter++) {
+        Real x_mul = Simd::Mul(x, x);
+        Real y_mul = Simd::Mul(y, y);
+        Real z_mag = Simd::Add(x_mul, y_mul);
+        Mask mask = Simd::Less(z_mag, radius);
+
+        if constexpr (kInteriorChecks) {
+            mask = Simd::AndNot(interior, mask);
+        }
+
+        if constexpr (kMagnitudes) {
+            mag = Simd::Blend(mag, z_mag, was_active);
+            was_active = mask;
+        }
+
+        last_active = mask;
+        if (!Simd::Any(mask)) { break; }
+
+        iter_count = Simd::CountActive(iter_count, mask);
+
+        Formula::Step(&x, &y, x_mul, y_mul, c_x, c_y);
+
+        if constexpr (kInteriorChecks) {
+            Real dx = Simd::Sub(x, saved_x);
+            Real dy = Simd::Sub(y, saved_y);
+            Mask cycle = Simd::Less(Simd::MulAdd(dx, dx, Simd::Mul(dy, dy)), period_eps);
+            interior = Simd::Or(interior, Simd::And(mask, cycle));
+
+            if (iter + 1 == next_save) {
+                saved_x = x;
+                saved_y = y;
+                next_save *= 2;
+            }
+        }
+    }
+
+#if defined(KERNEL_STATS)
+    typename Simd::Count active_count = iter_count;
+#endif
+
+    if (running != nullptr) {
+        *running = (n_trips <= max_iter) ? last_active : Simd::AndNot(last_active, last_active);
+    }
+
+    if constexpr (kInteriorChecks) {
+        iter_count = Simd::CountWhere(iter_count, interior, (uint32_t)(max_iter + 1));
+        mag = Simd::ZeroWhere(mag, interior);
+    }
+
+#if defined(KERNEL_STATS)
+    RecordLanes<Simd>(active_count, iter_count, max_iter);
+#endif
+
+    // lanes still active ran out of iterations without escaping
+    *escape_mag = Simd::ZeroWhere(mag, was_active);
+
+    return iter_count;
+}
+
+template <typename Simd, typename Formula, bool kInteriorChecks, bool kMagnitudes>
+void ComputeTileRows(const Formula& formula, const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    typedef typename Simd::Real Real;
+
+    Mandelbrot::MSet* m_set = frame.m_set;
+    const Mandelbrot::Viewport& view = frame.view;
+
+    typename Simd::Scalar reals[kTileWidth] = {};
+    TileReals<Simd>(view, tile, reals);
+
+    Real radius = EscapeRadius<Simd>(m_set);
+    double period_tolerance = view.step * kPeriodTolerance;
+    Real period_eps = Simd::Set1(period_tolerance * period_tolerance);
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        Real imag = Simd::Set1(PixelImag(view, y, 0.0));
+        for (int32_t x = tile.x_begin; x < tile.x_end; x += Simd::kLanes) {
+            Real real = Simd::Load(reals + (x - tile.x_begin));
+
+            Real escape_mag = Simd::Zero();
+            typename Simd::Count iter_count = CheckPixel<Simd, Formula, kInteriorChecks, kMagnitudes>(
+                formula, real, imag, m_set->max_iter, radius, period_eps, &escape_mag);
+
+            int32_t n_lanes = (tile.x_end - x < Simd::kLanes) ? tile.x_end - x : Simd::kLanes;
+            StoreLanes<Simd, kMagnitudes>(m_set, (size_t)y * m_set->width + (size_t)x, n_lanes, 
+                                          iter_count, escape_mag);
+        }
+    }
+}
+
+// interleaved: kInterleave slots iterate a vector group each, side by side in one loop;
+// a single group is one chain of dependent mul/add/compare and leaves most of the floating point
+// ports idle while it waits on its latency, the other chains fill them;
+// a slot whose group is done stores it and takes the next group of the tile right away, so slots
+// never wait for each other, and every group goes through the same steps as in CheckPixel,
+// the counts and |z|^2 match ComputeTileRows bit for bit
+template <typename Simd, typename Formula, bool kInteriorChecks, bool kMagnitudes, size_t kInterleave>
+void ComputeTileSlots(const Formula& formula, const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    typedef typename Simd::Real Real;
+    typedef typename Simd::Mask Mask;
+    typedef typename Simd::Count Count;
+
+    Mandelbrot::MSet* m_set = frame.m_set;
+    const Mandelbrot::Viewport& view = frame.view;
+    size_t max_iter = m_set->max_iter;
+
+    typename Simd::Scalar reals[kTileWidth] = {};
+    TileReals<Simd>(view, tile, reals);
+
+    double period_tolerance = view.step * kPeriodTolerance;
+    Real period_eps = Simd::Set1(period_tolerance * period_tolerance);
+
+    Real radius = EscapeRadius<Simd>(m_set);
+
+    // the next group to take, row by row as ComputeTileRows goes
+    int32_t next_x = tile.x_begin;
+    int32_t next_y = tile.y_begin;
+
+    // slots left without a group in a small tile still take the steps, with zeros
+    Real c_x[kInterleave] = {};
+    Real c_y[kInterleave] = {};
+    Real x[kInterleave] = {};
+    Real y[kInterleave] = {};
+    Real mag[kInterleave] = {};
+    Mask was_active[kInterleave] = {};
+    Count iter_count[kInterleave] = {};
+
+    Mask interior[kInterleave] = {};
+    Real saved_x[kInterleave] = {};
+    Real saved_y[kInterleave] = {};
+
+    size_t iter[kInterleave] = {};
+    size_t next_save[kInterleave] = {};
+    size_t pos[kInterleave] = {};
+    int32_t n_lanes[kInterleave] = {};
+    uint32_t live = 0; // slots which hold a group
+
+    auto take_group = [&](size_t i) {
+        if (next_y == tile.y_end) {
+            live &= ~(1u << i);
+            return;
+        }
+
+        int32_t group_x = next_x;
+        int32_t group_y = next_y;
+
+        next_x += Simd::kLanes;
+        if (next_x >= tile.x_end) {
+            next_x = tile.x_begin;
+            next_y++;
+        }
+
+        Real real = Simd::Load(reals + (group_x - tile.x_begin));
+        Real imag = Simd::Set1(PixelImag(view, group_y, 0.0));
+        formula.Start(real, imag, &x[i], &y[i], &c_x[i], &c_y[i]);
+        mag[i] = Simd::Zero();
+        was_active[i] = Simd::Less(mag[i], radius); // all lanes
+        iter_count[i] = Simd::CountZero();
+
+        interior[i] = Simd::AndNot(was_active[i], was_active[i]); // no lanes
+        saved_x[i] = Simd::Zero();
+        saved_y[i] = Simd::Zero();
+        if constexpr (kInteriorChecks && Formula::kMainComponents) {
+            interior[i] = InsideMainComponents<Simd>(c_x[i], c_y[i]);
+        }
+
+        iter[i] = 0;
+        next_save[i] = 1;
+        pos[i] = (size_t)group_y * m_set->width + (size_t)group_x;
+        n_lanes[i] = (tile.x_end - group_x < Simd::kLanes) ? tile.x_end - group_x : Simd::kLanes;
+    };
+
+    auto store_group = [&](size_t i) {
+#if defined(KERNEL_STATS)
+        Count active_count = iter_count[i];
+#endif
+
+        if constexpr (kInteriorChecks) {
+            iter_count[i] = Simd::CountWhere(iter_count[i], interior[i], (uint32_t)(max_iter + 1));
+            mag[i] = Simd::ZeroWhere(mag[i], interior[i]);
+        }
+
+#if defined(KERNEL_STATS)
+        RecordLanes<Simd>(active_count, iter_count[i], max_iter);
+#endif
+
+        // lanes still active ran out of iterations without escaping
+        StoreLanes<Simd, kMagnitudes>(m_set, pos[i], n_lanes[i], iter_count[i], Simd::ZeroWhere(mag[i], was_active[i]));
+    };
+
+    for (size_t i = 0; i < kInterleave; i++) {
+        live |= 1u << i;
+        take_group(i);
+    }
+
+    // every slot takes every step, one which is done has an empty mask and its step changes nothing
+    // it stores, so the only branch of the loop is the one to store and take groups;
+    // the steps of different slots do not depend on each other and the cpu runs them side by side
+    while (live != 0) {
+        uint32_t done = 0;
+
+        for (size_t i = 0; i < kInterleave; i++) {
+            Real x_mul = Simd::Mul(x[i], x[i]);
+            Real y_mul = Simd::Mul(y[i], y[i]);
+            Real z_mag = Simd::Add(x_mul, y_mul);
+            Mask mask = Simd::Less(z_mag, radius);
+
+            if constexpr (kInteriorChecks) {
+                mask = Simd::AndNot(interior[i], mask);
+            }
+
+            if constexpr (kMagnitudes) {
+                mag[i] = Simd::Blend(mag[i], z_mag, was_active[i]);
+                was_active[i] = mask;
+            }
+
+            iter_count[i] = Simd::CountActive(iter_count[i], mask);
+
+            Formula::Step(&x[i], &y[i], x_mul, y_mul, c_x[i], c_y[i]);
+
+            if constexpr (kInteriorChecks) {
+                Real dx = Simd::Sub(x[i], saved_x[i]);
+                Real dy = Simd::Sub(y[i], saved_y[i]);
+                Mask cycle = Simd::Less(Simd::MulAdd(dx, dx, Simd::Mul(dy, dy)), period_eps);
+                interior[i] = Simd::Or(interior[i], Simd::And(mask, cycle));
+
+                if (iter[i] + 1 == next_save[i]) {
+                    saved_x[i] = x[i];
+                    saved_y[i] = y[i];
+                    next_save[i] *= 2;
+                }
+            }
+
+            // the same two ends as the loop of CheckPixel: no lane active or max_iter + 1 trips
+            iter[i]++;
+            done |= (uint32_t)(!Simd::Any(mask) || iter[i] > max_iter) << i;
+        }
+
+        done &= live;
+        if (done != 0) {
+            for (size_t i = 0; i < kInterleave; i++) {
+                if (done & (1u << i)) {
+                    store_group(i);
+                    take_group(i);
+                }
+            }
+        }
+    }
+}
+
+template <typename Simd, size_t kInterleave, typename Formula>
+void ComputeTileInterleaved(const Formula& formula, const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    bool checks = frame.m_set->interior_checks;
+    bool magnitudes = frame.m_set->keep_magnitudes;
+
+    if (checks && magnitudes) {
+        ComputeTileSlots<Simd, Formula, true, true, kInterleave>(formula, frame, tile);
+    } else if (checks) {
+        ComputeTileSlots<Simd, Formula, true, false, kInterleave>(formula, frame, tile);
+    } else if (magnitudes) {
+        ComputeTileSlots<Simd, Formula, false, true, kInterleave>(formula, frame, tile);
+    } else {
+        ComputeTileSlots<Simd, Formula, false, false, kInterleave>(formula, frame, tile);
+    }
+}
+
+template <typename Simd, typename Formula>
+void ComputeTileFormula(const Formula& formula, const Mandelbrot::Frame& frame, Mandelbrot::Tile tile,
+                        size_t interleave) {
+    if (interleave >= 4) {
+        ComputeTileInterleaved<Simd, 4>(formula, frame, tile);
+        return;
+    }
+    if (interleave >= 2) {
+        ComputeTileInterleaved<Simd, 2>(formula, frame, tile);
+        return;
+    }
+
+    bool checks = frame.m_set->interior_checks;
+    bool magnitudes = frame.m_set->keep_magnitudes;
+
+    if (checks && magnitudes) {
+        ComputeTileRows<Simd, Formula, true, true>(formula, frame, tile);
+    } else if (checks) {
+        ComputeTileRows<Simd, Formula, true, false>(formula, frame, tile);
+    } else if (magnitudes) {
+        ComputeTileRows<Simd, Formula, false, true>(formula, frame, tile);
+    } else {
+        ComputeTileRows<Simd, Formula, false, false>(formula, frame, tile);
+    }
+}
+
+// kInterleave is the factor a kernel table found fastest over the views of mandelbrot_bench,
+// MSet::interleave overrides it, 1 is the plain row kernel
+template <typename Simd, size_t kInterleave = 1>
+void ComputeTile(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    size_t interleave = (frame.m_set->interleave != 0) ? frame.m_set->interleave : kInterleave;
+
+    WithFormula<Simd>(frame.m_set, [&](const auto& formula) {
+        ComputeTileFormula<Simd>(formula, frame, tile, interleave);
+    });
+}
+
+// lane refill: the tile goes through fixed groups for kRefillTrips iterations first, most pixels
+// are done by then, and only the rest is queued; a lane then takes the next queued pixel as soon
+// as its own one is done instead of waiting for the slowest lane of a group, so one slow pixel
+// holds only its lane; every lane keeps the trip count and the Brent checkpoint of its own pixel
+// and the coordinate ComputePointsChecked gives it, so counts and |z|^2 match ComputeTileRows bit for bit
+template <typename Simd, typename Formula, bool kInteriorChecks, bool kMagnitudes>
+void ComputeTileRefillRows(const Formula& formula, const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    typedef typename Simd::Scalar Scalar;
+    typedef typename Simd::Real Real;
+    typedef typename Simd::Mask Mask;
+
+    int32_t tile_width = tile.x_end - tile.x_begin;
+    assert(tile_width <= (int32_t)kTileWidth);
+    assert(tile_width * (tile.y_end - tile.y_begin) <= (int32_t)(kTileWidth * kTileHight));
+
+    Mandelbrot::MSet* m_set = frame.m_set;
+    const Mandelbrot::Viewport& view = frame.view;
+    size_t max_iter = m_set->max_iter;
+
+    Scalar reals[kTileWidth] = {};
+    TileReals<Simd>(view, tile, reals);
+
+    Real radius = EscapeRadius<Simd>(m_set);
+    double period_tolerance = view.step * kPeriodTolerance;
+    Real period_eps = Simd::Set1(period_tolerance * period_tolerance);
+
+    // pixels still iterating after kRefillTrips, as offsets in the tile
+    uint16_t queue[kTileWidth * kTileHight];
+    size_t n_queued = 0;
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        Real imag = Simd::Set1(PixelImag(view, y, 0.0));
+        for (int32_t x = tile.x_begin; x < tile.x_end; x += Simd::kLanes) {
+            Real real = Simd::Load(reals + (x - tile.x_begin));
+
+            Real escape_mag = Simd::Zero();
+            Mask running = {};
+            typename Simd::Count iter_count = CheckPixel<Simd, Formula, kInteriorChecks, kMagnitudes>(
+                formula, real, imag, max_iter, radius, period_eps, &escape_mag, kRefillTrips, &running);
+
+            int32_t n_lanes = (tile.x_end - x < Simd::kLanes) ? tile.x_end - x : Simd::kLanes;
+            StoreLanes<Simd, kMagnitudes>(m_set, (size_t)y * m_set->width + (size_t)x, n_lanes,
+                                          iter_count, escape_mag);
+
+            uint32_t bits = Simd::MaskBits(running) & ((n_lanes < 32) ? (1u << n_lanes) - 1 : ~0u);
+            for (; bits != 0; bits &= bits - 1) {
+                int32_t offset = (y - tile.y_begin) * tile_width + (x - tile.x_begin) + __builtin_ctz(bits);
+                queue[n_queued++] = (uint16_t)offset;
+            }
+        }
+    }
+
+    if (n_queued == 0) {
+        return;
+    }
+
+    Real one    = Simd::Set1(1.0);
+    Real half   = Simd::Set1(0.5);
+    Real limit  = Simd::Set1((double)max_iter + 1.0); // a lane is done after max_iter + 1 active trips
+    Mask all    = Simd::AllLanes();
+
+    Scalar real_s[Simd::kLanes] = {};
+    Scalar imag_s[Simd::kLanes] = {};
+    Scalar fresh[Simd::kLanes]  = {}; // 1 in lanes which just took a pixel
+    size_t lane_pos[Simd::kLanes] = {};
+
+    size_t next = 0;
+    uint32_t live = 0; // lanes which hold a pixel
+
+    auto take_pixel = [&](int32_t lane) {
+        if (next == n_queued) {
+            live &= ~(1u << lane);
+            return;
+        }
+
+        int32_t x = tile.x_begin + queue[next] % tile_width;
+        int32_t y = tile.y_begin + queue[next] / tile_width;
+        next++;
+
+        real_s[lane]   = reals[x - tile.x_begin];
+        imag_s[lane]   = (Scalar)PixelImag(view, y, 0.0);
+        fresh[lane]    = 1;
+        lane_pos[lane] = (size_t)y * m_set->width + (size_t)x;
+        live |= 1u << lane;
+    };
+
+    for (int32_t lane = 0; lane < Simd::kLanes; lane++) {
+        take_pixel(lane);
+    }
+
+    Real c_x = Simd::Zero();
+    Real c_y = Simd::Zero();
+    Real x = Simd::Zero();
+    Real y = Simd::Zero();
+    Real trips = Simd::Zero();
+    typename Simd::Count iter_count = Simd::CountZero();
+
+    Mask interior = Simd::AndNot(all, all); // no lanes
+    Real saved_x = Simd::Zero();
+    Real saved_y = Simd::Zero();
+    Real save_after = Simd::Zero(); // Brent checkpoint trip minus one, 2^k - 1
+
+    bool refilled = true;
+
+#if defined(KERNEL_STATS)
+    uint64_t n_trips = 0;
+    uint64_t partial_trips = 0;
+#endif
+
+    while (live != 0) {
+        if (refilled) {
+            Mask taken = Simd::Less(half, Simd::Load(fresh));
+
+            // c of lanes still iterating comes out the same again, their pixels did not move
+            Real start_x = Simd::Zero();
+            Real start_y = Simd::Zero();
+            formula.Start(Simd::Load(real_s), Simd::Load(imag_s),
+                          &start_x, &start_y, &c_x, &c_y);
+
+            x = Simd::Blend(x, start_x, taken);
+            y = Simd::Blend(y, start_y, taken);
+            trips = Simd::ZeroWhere(trips, taken);
+            iter_count = Simd::CountWhere(iter_count, taken, 0);
+
+            if constexpr (kInteriorChecks) {
+                Mask inside = Simd::AndNot(all, all); // no lanes
+                if constexpr (Formula::kMainComponents) {
+                    inside = InsideMainComponents<Simd>(c_x, c_y);
+                }
+                interior   = Simd::Or(Simd::AndNot(taken, interior), Simd::And(taken, inside));
+                saved_x    = Simd::ZeroWhere(saved_x, taken);
+                saved_y    = Simd::ZeroWhere(saved_y, taken);
+                save_after = Simd::ZeroWhere(save_after, taken);
+            }
+
+            refilled = false;
+        }
+
+        Real x_mul = Simd::Mul(x, x);
+        Real y_mul = Simd::Mul(y, y);
+        Real z_mag = Simd::Add(x_mul, y_mul);
+
+        Mask running = Simd::Less(trips, limit);
+        Mask mask = Simd::And(Simd::Less(z_mag, radius), running);
+
+        if constexpr (kInteriorChecks) {
+            mask = Simd::AndNot(interior, mask);
+        }
+
+        // done lanes hand their pixel in and take the next one, the trip starts over for them
+        uint32_t done = ~Simd::MaskBits(mask) & live;
+        if (done != 0) {
+            uint32_t counts[Simd::kLanes] = {};
+            Simd::StoreCounts(iter_count, counts);
+
+            float magnitudes[Simd::kLanes] = {};
+            if constexpr (kMagnitudes) {
+                Simd::StoreMagnitudes(z_mag, magnitudes);
+            }
+
+            // interior lanes never escape, lanes out of trips did not escape either
+            uint32_t never = Simd::MaskBits(interior) | ~Simd::MaskBits(running);
+
+            std::fill_n(fresh, Simd::kLanes, (Scalar)0);
+
+            for (uint32_t bits = done; bits != 0; bits &= bits - 1) {
+                int32_t lane = __builtin_ctz(bits);
+
+                bool escaped = (never & (1u << lane)) == 0;
+                uint32_t count = escaped ? counts[lane] : (uint32_t)(max_iter + 1);
+
+                m_set->iter_counts[lane_pos[lane]] = count;
+                if constexpr (kMagnitudes) {
+                    m_set->magnitudes[lane_pos[lane]] = escaped ? magnitudes[lane] : 0.0f;
+                }
+
+#if defined(KERNEL_STATS)
+                Mandelbrot::RecordPixel(counts[lane], count, max_iter);
+#endif
+
+                take_pixel(lane);
+            }
+
+            refilled = true;
+            continue;
+        }
+
+#if defined(KERNEL_STATS)
+        n_trips++;
+        partial_trips += (live != Simd::MaskBits(all));
+#endif
+
+        iter_count = Simd::CountActive(iter_count, mask);
+        trips = Simd::Add(trips, one);
+
+        Formula::Step(&x, &y, x_mul, y_mul, c_x, c_y);
+
+        if constexpr (kInteriorChecks) {
+            Real dx = Simd::Sub(x, saved_x);
+            Real dy = Simd::Sub(y, saved_y);
+            Mask cycle = Simd::Less(Simd::MulAdd(dx, dx, Simd::Mul(dy, dy)), period_eps);
+            interior = Simd::Or(interior, Simd::And(mask, cycle));
+
+            // trips is iter + 1 of CheckPixel now, so a lane saves z when it passes 2^k - 1
+            Mask save = Simd::Less(save_after, trips);
+            if (Simd::Any(save)) {
+                saved_x    = Simd::Blend(saved_x, x, save);
+                saved_y    = Simd::Blend(saved_y, y, save);
+                save_after = Simd::Blend(save_after, Simd::Add(Simd::Add(save_after, save_after), one), save);
+            }
+        }
+    }
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::RecordTrips(n_trips, partial_trips, Simd::kLanes);
+#endif
+}
+
+template <typename Simd>
+void ComputeTileRefill(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    // lanes count their trips in Real, float stops counting by one at 2^24, the fixed groups give
+    // the same picture
+    if (frame.m_set->max_iter + 1 >= (1ull << std::numeric_limits<typename Simd::Scalar>::digits)) {
+        ComputeTile<Simd>(frame, tile);
+        return;
+    }
+
+    bool checks = frame.m_set->interior_checks;
+    bool magnitudes = frame.m_set->keep_magnitudes;
+
+    WithFormula<Simd>(frame.m_set, [&](const auto& formula) {
+        typedef std::decay_t<decltype(formula)> Formula;
+
+        if (checks && magnitudes) {
+            ComputeTileRefillRows<Simd, Formula, true, true>(formula, frame, tile);
+        } else if (checks) {
+            ComputeTileRefillRows<Simd, Formula, true, false>(formula, frame, tile);
+        } else if (magnitudes) {
+            ComputeTileRefillRows<Simd, Formula, false, true>(formula, frame, tile);
+        } else {
+            ComputeTileRefillRows<Simd, Formula, false, false>(formula, frame, tile);
+        }
+    });
+}
+
+// same lanes as ComputeTileRows, but for any set of pixels: every pixel gets its PixelReal and PixelImag,
+// so counts match the tile kernels bit for bit
+template <typename Simd, typename Formula, bool kInteriorChecks, bool kMagnitudes>
+void ComputePointsChecked(const Formula& formula, const Mandelbrot::Frame& frame, const Mandelbrot::Point* points,
+                          size_t n_points, uint32_t* iter_count, float* magnitude) {
+    typedef typename Simd::Scalar Scalar;
+    typedef typename Simd::Real Real;
+
+    const Mandelbrot::Viewport& view = frame.view;
+
+    Real radius = EscapeRadius<Simd>(frame.m_set);
+    double period_tolerance = view.step * kPeriodTolerance;
+    Real period_eps = Simd::Set1(period_tolerance * period_tolerance);
+
+    for (size_t first = 0; first < n_points; first += Simd::kLanes) {
+        size_t n_lanes = (n_points - first < Simd::kLanes) ? n_points - first : Simd::kLanes;
+
+        Scalar real[Simd::kLanes] = {};
+        Scalar imag[Simd::kLanes] = {};
+
+        // spare lanes repeat the first point
+        for (size_t i = 0; i < Simd::kLanes; i++) {
+            const Mandelbrot::Point& point = points[first + ((i < n_lanes) ? i : 0)];
+
+            real[i] = (Scalar)PixelReal(view, point.x, frame.sample_x);
+            imag[i] = (Scalar)PixelImag(view, point.y, frame.sample_y);
+        }
+
+        Real escape_mag = Simd::Zero();
+        uint32_t counts[Simd::kLanes] = {};
+        float magnitudes[Simd::kLanes] = {};
+
+        Simd::StoreCounts(CheckPixel<Simd, Formula, kInteriorChecks, kMagnitudes>(formula, Simd::Load(real),
+                                                                                  Simd::Load(imag),
+                                                                                  frame.m_set->max_iter, radius,
+                                                                                  period_eps, &escape_mag),
+                          counts);
+        Simd::StoreMagnitudes(escape_mag, magnitudes);
+
+        std::copy_n(counts, n_lanes, iter_count + first);
+        std::copy_n(magnitudes, n_lanes, magnitude + first);
+    }
+}
+
+template <typename Simd>
+void ComputePoints(const Mandelbrot::Frame& frame, const Mandelbrot::Point* points, size_t n_points,
+                   uint32_t* iter_count, float* magnitude) {
+    bool checks = frame.m_set->interior_checks;
+    bool magnitudes = frame.m_set->keep_magnitudes;
+
+    WithFormula<Simd>(frame.m_set, [&](const auto& formula) {
+        typedef std::decay_t<decltype(formula)> Formula;
+
+        if (checks && magnitudes) {
+            ComputePointsChecked<Simd, Formula, true, true>(formula, frame, points, n_points, iter_count, magnitude);
+        } else if (checks) {
+            ComputePointsChecked<Simd, Formula, true, false>(formula, frame, points, n_points, iter_count, magnitude);
+        } else if (magnitudes) {
+            ComputePointsChecked<Simd, Formula, false, true>(formula, frame, points, n_points, iter_count, magnitude);
+        } else {
+            ComputePointsChecked<Simd, Formula, false, false>(formula, frame, points, n_points, iter_count, magnitude);
+        }
+    });
+}
+
+// points of any shape around the center view.x0, view.y0: exponential maps of zoom videos have no lattice,
+// a point is only center + offset rounded to Scalar
+template <typename Simd, typename Formula, bool kInteriorChecks, bool kMagnitudes>
+void ComputeOffsetsChecked(const Formula& formula, const Mandelbrot::Frame& frame, const double* offset_x,
+                           const double* offset_y, size_t n_points, uint32_t* iter_count, float* magnitude) {
+    typedef typename Simd::Scalar Scalar;
+
+    const Mandelbrot::Viewport& view = frame.view;
+
+    typename Simd::Real radius = EscapeRadius<Simd>(frame.m_set);
+    double period_tolerance = view.step * kPeriodTolerance;
+    typename Simd::Real period_eps = Simd::Set1(period_tolerance * period_tolerance);
+
+    for (size_t first = 0; first < n_points; first += Simd::kLanes) {
+        size_t n_lanes = (n_points - first < Simd::kLanes) ? n_points - first : Simd::kLanes;
+
+        Scalar real[Simd::kLanes] = {};
+        Scalar imag[Simd::kLanes] = {};
+
+        // spare lanes repeat the first point
+        for (size_t i = 0; i < Simd::kLanes; i++) {
+            size_t point = first + ((i < n_lanes) ? i : 0);
+
+            real[i] = (Scalar)(view.x0 + offset_x[point]);
+            imag[i] = (Scalar)(view.y0 + offset_y[point]);
+        }
+
+        typename Simd::Real escape_mag = Simd::Zero();
+        uint32_t counts[Simd::kLanes] = {};
+        float magnitudes[Simd::kLanes] = {};
+
+        Simd::StoreCounts(CheckPixel<Simd, Formula, kInteriorChecks, kMagnitudes>(formula, Simd::Load(real),
+                                                                                  Simd::Load(imag),
+                                                                                  frame.m_set->max_iter, radius,
+                                                                                  period_eps, &escape_mag),
+                          counts);
+        Simd::StoreMagnitudes(escape_mag, magnitudes);
+
+        std::copy_n(counts, n_lanes, iter_count + first);
+        std::copy_n(magnitudes, n_lanes, magnitude + first);
+    }
+}
+
+template <typename Simd>
+void ComputeOffsets(const Mandelbrot::Frame& frame, const double* offset_x, const double* offset_y, size_t n_points,
+                    uint32_t* iter_count, float* magnitude) {
+    bool checks = frame.m_set->interior_checks;
+    bool magnitudes = frame.m_set->keep_magnitudes;
+
+    WithFormula<Simd>(frame.m_set, [&](const auto& formula) {
+        typedef std::decay_t<decltype(formula)> Formula;
+
+        if (checks && magnitudes) {
+            ComputeOffsetsChecked<Simd, Formula, true, true>(formula, frame, offset_x, offset_y, n_points,
+                                                             iter_count, magnitude);
+        } else if (checks) {
+            ComputeOffsetsChecked<Simd, Formula, true, false>(formula, frame, offset_x, offset_y, n_points,
+                                                              iter_count, magnitude);
+        } else if (magnitudes) {
+            ComputeOffsetsChecked<Simd, Formula, false, true>(formula, frame, offset_x, offset_y, n_points,
+                                                              iter_count, magnitude);
+        } else {
+            ComputeOffsetsChecked<Simd, Formula, false, false>(formula, frame, offset_x, offset_y, n_points,
+                                                               iter_count, magnitude);
+        }
+    });
+}
+
+// z = Z[ref] + dz, where Z is the reference orbit:
+// dz' = 2 * Z[ref] * dz + dz^2 + dc = (2 * Z[ref] + dz) * dz + dc
+//
+// when |z| < |dz| the delta has lost its relative precision against Z (the glitch),
+// so the lane rebases: dz = z, ref = 0 (Z[0] = 0), the same happens at the end of the orbit
+template <typename Simd>
+typename Simd::Count CheckPixelPerturbation(typename Simd::Real dc_x, typename Simd::Real dc_y,
+                                            const Mandelbrot::Frame& frame, size_t max_iter,
+                                            typename Simd::Real* escape_mag) {
+    typedef typename Simd::Real Real;
+    typedef typename Simd::Mask Mask;
+    typedef typename Simd::Index Index;
+
+    Real dz_x  = Simd::Zero();
+    Real dz_y  = Simd::Zero();
+    Real ref_x = Simd::Zero();
+    Real ref_y = Simd::Zero();
+    Real x     = Simd::Zero();
+    Real y     = Simd::Zero();
+
+    Real radius = EscapeRadius<Simd>(frame.m_set);
+
+    Index ref_iter = Simd::IndexZero();
+    Mask active = Simd::AllLanes();
+    typename Simd::Count iter_count = Simd::CountZero();
+
+    Real kept_mag = Simd::Zero();
+
+    for (size_t iter = 0; iter <= max_iter; iter++) {
+        Real mag = Simd::Add(Simd::Mul(x, x), Simd::Mul(y, y));
+        kept_mag = Simd::Blend(kept_mag, mag, active);
+        active = Simd::And(active, Simd::Less(mag, radius));
+
+        if (!Simd::Any(active)) { break; }
+
+        iter_count = Simd::CountActive(iter_count, active);
+
+        Real tmp_x = Simd::Add(Simd::Add(ref_x, ref_x), dz_x);
+        Real tmp_y = Simd::Add(Simd::Add(ref_y, ref_y), dz_y);
+
+        Real new_dz_x = Simd::MulAdd(tmp_x, dz_x, Simd::Sub(dc_x, Simd::Mul(tmp_y, dz_y)));
+        dz_y = Simd::MulAdd(tmp_x, dz_y, Simd::MulAdd(tmp_y, dz_x, dc_y));
+        dz_x = new_dz_x;
+
+        ref_iter = Simd::IndexInc(ref_iter);
+        ref_x = Simd::Gather(frame.orbit_x, ref_iter);
+        ref_y = Simd::Gather(frame.orbit_y, ref_iter);
+
+        x = Simd::Add(ref_x, dz_x);
+        y = Simd::Add(ref_y, dz_y);
+
+        Real dz_mag = Simd::Add(Simd::Mul(dz_x, dz_x), Simd::Mul(dz_y, dz_y));
+        Real z_mag  = Simd::Add(Simd::Mul(x, x), Simd::Mul(y, y));
+
+        Mask rebase = Simd::Or(Simd::Less(z_mag, dz_mag), Simd::IndexEqual(ref_iter, frame.orbit_len));
+
+        dz_x     = Simd::Blend(dz_x, x, rebase);
+        dz_y     = Simd::Blend(dz_y, y, rebase);
+        ref_x    = Simd::ZeroWhere(ref_x, rebase);
+        ref_y    = Simd::ZeroWhere(ref_y, rebase);
+        ref_iter = Simd::IndexZeroWhere(ref_iter, rebase);
+    }
+
+    *escape_mag = Simd::ZeroWhere(kept_mag, active);
+
+#if defined(KERNEL_STATS)
+    RecordLanes<Simd>(iter_count, iter_count, max_iter);
+#endif
+
+    return iter_count;
+}
+
+template <typename Simd>
+void ComputePerturbation(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    typedef typename Simd::Real Real;
+
+    Mandelbrot::MSet* m_set = frame.m_set;
+
+    // reference is the frame center, so dc does not depend on the center at all
+    double step   = frame.view.step;
+    double half_x = (double)m_set->width  / 2.0;
+    double half_y = (double)m_set->height / 2.0;
+
+    Real lane_offset = Simd::Mul(Simd::LaneIndex(), Simd::Set1(step));
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        Real dc_y = Simd::Set1(((double)y - half_y) * step);
+        for (int32_t x = tile.x_begin; x < tile.x_end; x += Simd::kLanes) {
+            Real dc_x = Simd::Add(Simd::Set1(((double)x - half_x) * step), lane_offset);
+
+            Real escape_mag = Simd::Zero();
+            typename Simd::Count iter_count = CheckPixelPerturbation<Simd>(dc_x, dc_y, frame, m_set->max_iter,
+                                                                           &escape_mag);
+
+            int32_t n_lanes = (tile.x_end - x < Simd::kLanes) ? tile.x_end - x : Simd::kLanes;
+            StoreLanes<Simd, true>(m_set, (size_t)y * m_set->width + (size_t)x, n_lanes, iter_count, escape_mag);
+        }
+    }
+}
+
+template <typename Simd>
+void ComputePointsPerturbation(const Mandelbrot::Frame& frame, const Mandelbrot::Point* points, size_t n_points,
+                               uint32_t* iter_count, float* magnitude) {
+    typedef typename Simd::Scalar Scalar;
+    typedef typename Simd::Real Real;
+
+    Mandelbrot::MSet* m_set = frame.m_set;
+
+    double step   = frame.view.step;
+    double half_x = (double)m_set->width  / 2.0;
+    double half_y = (double)m_set->height / 2.0;
+
+    Scalar lane_offset[Simd::kLanes] = {};
+    Simd::Store(Simd::Mul(Simd::LaneIndex(), Simd::Set1(step)), lane_offset);
+
+    for (size_t first = 0; first < n_points; first += Simd::kLanes) {
+        size_t n_lanes = (n_points - first < Simd::kLanes) ? n_points - first : Simd::kLanes;
+
+        Scalar base[Simd::kLanes] = {};
+        Scalar offset[Simd::kLanes] = {};
+        Scalar dc_y[Simd::kLanes] = {};
+
+        for (size_t i = 0; i < Simd::kLanes; i++) {
+            const Mandelbrot::Point& point = points[first + ((i < n_lanes) ? i : 0)];
+            int32_t lane_index = point.x % Simd::kLanes;
+
+            base[i]   = ((double)(point.x - lane_index) + frame.sample_x - half_x) * step;
+            offset[i] = lane_offset[lane_index];
+            dc_y[i]   = ((double)point.y + frame.sample_y - half_y) * step;
+        }
+
+        Real dc_x = Simd::Add(Simd::Load(base), Simd::Load(offset));
+
+        Real escape_mag = Simd::Zero();
+        uint32_t counts[Simd::kLanes] = {};
+        float magnitudes[Simd::kLanes] = {};
+
+        Simd::StoreCounts(CheckPixelPerturbation<Simd>(dc_x, Simd::Load(dc_y), frame, m_set->max_iter, &escape_mag),
+                          counts);
+        Simd::StoreMagnitudes(escape_mag, magnitudes);
+
+        std::copy_n(counts, n_lanes, iter_count + first);
+        std::copy_n(magnitudes, n_lanes, magnitude + first);
+    }
+}
+
+// offsets are the deltas from the reference orbit point itself
+template <typename Simd>
+void ComputeOffsetsPerturbation(const Mandelbrot::Frame& frame, const double* offset_x, const double* offset_y,
+                                size_t n_points, uint32_t* iter_count, float* magnitude) {
+    typedef typename Simd::Scalar Scalar;
+
+    for (size_t first = 0; first < n_points; first += Simd::kLanes) {
+        size_t n_lanes = (n_points - first < Simd::kLanes) ? n_points - first : Simd::kLanes;
+
+        Scalar dc_x[Simd::kLanes] = {};
+        Scalar dc_y[Simd::kLanes] = {};
+
+        for (size_t i = 0; i < Simd::kLanes; i++) {
+            size_t point = first + ((i < n_lanes) ? i : 0);
+
+            dc_x[i] = offset_x[point];
+            dc_y[i] = offset_y[point];
+        }
+
+        typename Simd::Real escape_mag = Simd::Zero();
+        uint32_t counts[Simd::kLanes] = {};
+        float magnitudes[Simd::kLanes] = {};
+
+        Simd::StoreCounts(CheckPixelPerturbation<Simd>(Simd::Load(dc_x), Simd::Load(dc_y), frame,
+                                                       frame.m_set->max_iter, &escape_mag),
+                          counts);
+        Simd::StoreMagnitudes(escape_mag, magnitudes);
+
+        std::copy_n(counts, n_lanes, iter_count + first);
+        std::copy_n(magnitudes, n_lanes, magnitude + first);
+    }
+}
+
+// log2 to about 1e-3, which is well below one lut entry: value = 2^e * m with m in [1, 2),
+// log2(m) is a cubic through (1, 0) and (2, 1), so it stays continuous from one octave to the next
+template <typename Simd>
+typename Simd::Real Log2(typename Simd::Real value) {
+    typedef typename Simd::Real Real;
+
+    typename Simd::Count bits = Simd::RealBits(value);
+
+    Real exponent = Simd::Sub(Simd::CountToReal(Simd::CountShiftRight(bits, 23)), Simd::Set1(127.0));
+    Real mantissa = Simd::Sub(Simd::FromBits(Simd::CountOr(Simd::CountAnd(bits, 0x007FFFFFu), 0x3F800000u)),
+                              Simd::Set1(1.0));
+
+    // no MulAdd, avx2fma and avx2 have to color pixels the same
+    Real poly = Simd::Add(Simd::Mul(mantissa, Simd::Set1(0.1563861133764295)), Simd::Set1(-0.577250650806566));
+    poly = Simd::Add(Simd::Mul(mantissa, poly), Simd::Set1(1.4208645374301365));
+
+    return Simd::Add(exponent, Simd::Mul(mantissa, poly));
+}
+
+// fraction of an iteration the pixel escaped by, 1 - log2(log2 |z| / log2 R) =
+// 1 + log2(log2 R^2) - log2(log2 |z|^2) for escape radius R, so it goes from 0 to 1 between
+// |z| = R^2 and |z| = R, as lut position; |z|^2 below the bailout (interior, not kept)
+// counts as exactly at it; offset is 1 + log2(log2 R^2), 2 for R = 2;
+// z^d + c goes from |z| = R^d to R, which takes log_d instead of log2: slope is 1 / log2(d), see SmoothSlope
+template <typename Simd>
+typename Simd::Count SmoothPosition(typename Simd::Real escape_mag, typename Simd::Real bailout,
+                                    typename Simd::Real offset, typename Simd::Real slope, uint32_t step) {
+    typedef typename Simd::Real Real;
+
+    escape_mag = Simd::Blend(bailout, escape_mag, Simd::Less(bailout, escape_mag));
+
+    Real fraction = Simd::Sub(offset, Simd::Mul(Log2<Simd>(Log2<Simd>(escape_mag)), slope));
+
+    return Simd::RealToCount(Simd::Mul(fraction, Simd::Set1((double)step)));
+}
+
+// 1 / log2 of the power of the formula, exactly 1 for the z^2 ones
+inline double SmoothSlope(const Mandelbrot::MSet* m_set) {
+    switch (m_set->formula) {
+        case Mandelbrot::Formula::kMultibrot3: return 1.0 / std::log2(3.0);
+        case Mandelbrot::Formula::kMultibrot4: return 0.5;
+        case Mandelbrot::Formula::kMandelbrot:
+        case Mandelbrot::Formula::kJulia:
+        case Mandelbrot::Formula::kBurningShip:
+        default:                               return 1.0;
+    }
+}
+
+// rgba pixels of kLanes counts (and |z|^2) from the palette lut
+template <typename Simd, bool kSmooth>
+void ColorizeLanes(const Mandelbrot::MSet* m_set, typename Simd::Real bailout, typename Simd::Real offset,
+                   typename Simd::Real slope, const uint32_t* counts, const float* magnitudes, uint32_t* pixels) {
+    typedef typename Simd::Count Count;
+
+    const Mandelbrot::Palette& palette = m_set->palette;
+
+    Count count = Simd::LoadCounts(counts);
+    Count lut_pos = Simd::CountAdd(Simd::CountMul(count, palette.step), Simd::CountSet1(palette.offset));
+    if constexpr (kSmooth) {
+        lut_pos = Simd::CountAdd(lut_pos, SmoothPosition<Simd>(Simd::Load(magnitudes), bailout, offset, slope,
+                                                               palette.step));
+    }
+
+    Count index = Simd::CountAnd(Simd::CountShiftRight(lut_pos, 16), (uint32_t)kPaletteLutSize - 1);
+    Count color = Simd::GatherCounts(palette.lut, index);
+
+    Simd::StoreCounts(Simd::CountWhere(color, Simd::CountAbove(count, (uint32_t)m_set->max_iter), palette.interior),
+                      pixels);
+}
+
+// full vectors go straight from the frame buffers to the pixels, the tile edge goes through a copy
+template <typename Simd, bool kSmooth>
+void ColorizeTileRows(Mandelbrot::MSet* m_set, Mandelbrot::Tile tile) {
+    double bailout_mag = m_set->escape_radius * m_set->escape_radius;
+    double slope_value = SmoothSlope(m_set);
+    typename Simd::Real bailout = Simd::Set1(bailout_mag);
+    typename Simd::Real offset  = Simd::Set1(1.0 + std::log2(std::log2(bailout_mag)) * slope_value);
+    typename Simd::Real slope   = Simd::Set1(slope_value);
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        size_t row = (size_t)y * m_set->width;
+
+        const uint32_t* counts = m_set->iter_counts + row;
+        const float* magnitudes = m_set->magnitudes + row;
+        uint32_t* pixels = (uint32_t*)(void*)&m_set->pixels[4 * row];
+
+        int32_t x = tile.x_begin;
+        for (; x + Simd::kLanes <= tile.x_end; x += Simd::kLanes) {
+            ColorizeLanes<Simd, kSmooth>(m_set, bailout, offset, slope, counts + x, magnitudes + x, pixels + x);
+        }
+
+        int32_t n_lanes = tile.x_end - x;
+        if (n_lanes > 0) {
+            uint32_t edge_counts[Simd::kLanes] = {};
+            float edge_magnitudes[Simd::kLanes] = {};
+            uint32_t edge_pixels[Simd::kLanes] = {};
+
+            std::copy_n(counts + x, n_lanes, edge_counts);
+            std::copy_n(magnitudes + x, n_lanes, edge_magnitudes);
+
+            ColorizeLanes<Simd, kSmooth>(m_set, bailout, offset, slope, edge_counts, edge_magnitudes, edge_pixels);
+            std::copy_n(edge_pixels, n_lanes, pixels + x);
+        }
+    }
+}
+
+// Simd has to have 32 bit lanes (float), counts and pixels are 32 bit too;
+// smoothing needs |z|^2, without keep_magnitudes the plain counts are colored
+template <typename Simd>
+void ColorizeTile(Mandelbrot::MSet* m_set, Mandelbrot::Tile tile) {
+    if (m_set->palette.smooth && m_set->keep_magnitudes) {
+        ColorizeTileRows<Simd, true>(m_set, tile);
+    } else {
+        ColorizeTileRows<Simd, false>(m_set, tile);
+    }
+}
+
+// same lanes as ColorizeTileRows for counts of any pixels, the last vector goes through a copy
+template <typename Simd, bool kSmooth>
+void ColorizePointsChecked(const Mandelbrot::MSet* m_set, const uint32_t* iter_count, const float* magnitude,
+                           size_t n_points, uint32_t* pixels) {
+    double bailout_mag = m_set->escape_radius * m_set->escape_radius;
+    double slope_value = SmoothSlope(m_set);
+    typename Simd::Real bailout = Simd::Set1(bailout_mag);
+    typename Simd::Real offset  = Simd::Set1(1.0 + std::log2(std::log2(bailout_mag)) * slope_value);
+    typename Simd::Real slope   = Simd::Set1(slope_value);
+
+    size_t first = 0;
+    for (; first + Simd::kLanes <= n_points; first += Simd::kLanes) {
+        ColorizeLanes<Simd, kSmooth>(m_set, bailout, offset, slope, iter_count + first, magnitude + first,
+                                     pixels + first);
+    }
+
+    size_t n_lanes = n_points - first;
+    if (n_lanes > 0) {
+        uint32_t edge_counts[Simd::kLanes] = {};
+        float edge_magnitudes[Simd::kLanes] = {};
+        uint32_t edge_pixels[Simd::kLanes] = {};
+
+        std::copy_n(iter_count + first, n_lanes, edge_counts);
+        std::copy_n(magnitude + first, n_lanes, edge_magnitudes);
+
+        ColorizeLanes<Simd, kSmooth>(m_set, bailout, offset, slope, edge_counts, edge_magnitudes, edge_pixels);
+        std::copy_n(edge_pixels, n_lanes, pixels + first);
+    }
+}
+
+template <typename Simd>
+void ColorizePoints(const Mandelbrot::MSet* m_set, const uint32_t* iter_count, const float* magnitude,
+                    size_t n_points, uint32_t* pixels) {
+    if (m_set->palette.smooth && m_set->keep_magnitudes) {
+        ColorizePointsChecked<Simd, true>(m_set, iter_count, magnitude, n_points, pixels);
+    } else {
+        ColorizePointsChecked<Simd, false>(m_set, iter_count, magnitude, n_points, pixels);
+    }
+}
+
+} // namespace
+
+#endif // KERNEL_IMPL_H_
@@ -0,0 +1,127 @@
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include "mandelbrot.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace Mandelbrot {
+    struct Tile {
+        int32_t x_begin;
+        int32_t y_begin;
+        int32_t x_end;
+        int32_t y_end;
+    };
+
+    // everything a tile task needs, fixed for the whole frame
+    struct Frame {
+        MSet* m_set;
+        Viewport view;
+        Precision precision;
+
+        // part of the frame to compute; ComputeRegion and ComputeRect keep x_begin a multiple of the
+        // widest simd group (16), ComputeCached starts it at -lead_x of the plane tile lattice instead,
+        // which is fine since a pixel comes out the same in whatever group it falls (PixelReal)
+        Tile region;
+        int32_t tile_hight; // tasks split the region into kTileWidth x tile_hight tiles
+
+        // progressive only, pixel step of the pass being computed
+        int32_t pass_step;
+
+        // point kernels take the point (x + sample_x, y + sample_y) for pixel (x, y),
+        // antialiasing moves it around the pixel, 0 everywhere else
+        double sample_x;
+        double sample_y;
+
+        // perturbation only, orbit_x[orbit_len] is the last point of the reference orbit
+        const double* orbit_x;
+        const double* orbit_y;
+        size_t orbit_len;
+
+        std::atomic<size_t> n_iterated;
+        std::atomic<size_t> n_samples; // antialiasing samples of all tiles
+
+        // KERNEL_STATS only, tile tasks add what their kernels recorded
+        KernelStats stats;
+        std::mutex stats_lock;
+    };
+
+    struct Point {
+        int32_t x;
+        int32_t y;
+    };
+
+    // writes iteration counts and |z|^2 at escape of every pixel of the tile to m_set
+    typedef void (*TileKernel)(const Frame& frame, Tile tile);
+
+    // same for the given pixels, but into iter_count[i] and magnitude[i] for points[i]
+    typedef void (*PointKernel)(const Frame& frame, const Point* points, size_t n_points,
+                                uint32_t* iter_count, float* magnitude);
+
+    // same for points off any lattice: (view.x0 + offset_x[i], view.y0 + offset_y[i]), the view
+    // corner is the center the offsets are taken from (the reference orbit point of perturbation)
+    // and view.step is the cell size the period check compares orbits to
+    typedef void (*OffsetKernel)(const Frame& frame, const double* offset_x, const double* offset_y, size_t n_points,
+                                 uint32_t* iter_count, float* magnitude);
+
+    // RGBA pixels of the tile from its iteration counts (and |z|^2) through MSet::palette
+    typedef void (*ColorKernel)(MSet* m_set, Tile tile);
+
+    // same for n_points counts (and |z|^2) of point kernels, into pixels[i]
+    typedef void (*ColorPointsKernel)(const MSet* m_set, const uint32_t* iter_count, const float* magnitude,
+                                      size_t n_points, uint32_t* pixels);
+
+    // one set of kernels per instruction set, every kernels_<isa>.cpp is compiled
+    // for its own target, so the binary runs anywhere and picks the widest at startup
+    struct KernelTable {
+        const char* name;
+        bool (*supported)();
+
+        TileKernel tile_f32;
+        TileKernel tile_f64;
+        TileKernel tile_perturbation;
+
+        // lane refill versions of tile_f32 and tile_f64, used with MSet::refill
+        TileKernel tile_refill_f32;
+        TileKernel tile_refill_f64;
+
+        PointKernel points_f32;
+        PointKernel points_f64;
+        PointKernel points_perturbation;
+
+        OffsetKernel offsets_f32;
+        OffsetKernel offsets_f64;
+        OffsetKernel offsets_perturbation;
+
+        ColorKernel colorize;
+        ColorPointsKernel colorize_points;
+    };
+
+    extern const KernelTable kKernelsNaive;
+    extern const KernelTable kKernelsArray;
+    extern const KernelTable kKernelsScalar;
+    extern const KernelTable kKernelsSse4;
+    extern const KernelTable kKernelsAvx2;
+    extern const KernelTable kKernelsAvx2Fma;
+    extern const KernelTable kKernelsAvx512;
+
+    // widest kernels this cpu can run
+    const KernelTable* BestKernels();
+
+    // every built in table, widest first, whether the cpu supports it or not
+    size_t KernelCount();
+    const KernelTable* KernelAt(size_t index);
+
+    // nullptr if there is no such kernel or cpu does not support it
+    const KernelTable* FindKernels(const char* name);
+
+    void PrintKernels(FILE* stream);
+
+    // kernels of the frame precision from the frame kernel table
+    TileKernel ChooseTileKernel(const Frame& frame);
+    PointKernel ChoosePointKernel(const Frame& frame);
+    OffsetKernel ChooseOffsetKernel(const Frame& frame);
+}
+
+#endif // KERNELS_H_
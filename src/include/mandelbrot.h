@@ -10,28 +10,229 @@
 #include <immintrin.h> // simd
 
 #include "config.h"
+#include "thread_pool.h"
+#include "hp_real.h"
 
 namespace Mandelbrot {
     const size_t kMaxIter = kMaxIteration;
 
+    // interior pixels store max_iter + 1 and vector kernels compare counts as signed 32 bit lanes
+    const size_t kMaxIterLimit = INT32_MAX - 1;
+
     enum class Error {
         kOk       = 0,
         kBadAlloc = 1,
+        kBadSize  = 2,
+        kBadFile  = 3,
+        kBadLink  = 4, // cluster sockets, see cluster.h
+    };
+
+    enum class Precision {
+        kAuto         = 0, // float while it can resolve neighbour pixels, double, then perturbation
+        kFloat        = 1,
+        kDouble       = 2,
+        kPerturbation = 3, // double deltas against a high precision reference orbit
+    };
+
+    // z' = f(z, c) the kernels iterate, every one runs on the same simd engine, see kernel_impl.h
+    enum class Formula {
+        kMandelbrot  = 0, // z^2 + c, z starts at 0 and c is the pixel
+        kJulia       = 1, // z^2 + c, z starts at the pixel and c is MSet::julia_x + i julia_y
+        kMultibrot3  = 2, // z^3 + c
+        kMultibrot4  = 3, // z^4 + c
+        kBurningShip = 4, // (|x| + i |y|)^2 + c
+    };
+
+    enum class Antialias {
+        kOff   = 0,
+        kEdges = 1, // pixels whose count differs from a neighbour's get kAntialiasGrid^2 samples
+        kFull  = 2, // every pixel does, what kEdges approximates
+    };
+
+    struct KernelTable;
+    struct TileCache;
+    struct ExpMap;
+
+    // pixel (x, y) is the point x0 + (origin_x + x) * step + i * (y0 + (origin_y + y) * step);
+    // x0, y0 are the deep center moved by a fraction of a step, so a pan by whole pixels
+    // changes only the origin and the pixels which stay in view keep their exact coordinates
+    struct Viewport {
+        double x0;
+        double y0;
+        double step;
+        int64_t origin_x;
+        int64_t origin_y;
+    };
+
+    // what the pixels show after the last Compute, lets the next one skip or shift the frame
+    struct ShownView {
+        bool valid;
+
+        Viewport view;
+        HpReal deep_x;
+        HpReal deep_y;
+
+        size_t width;
+        size_t height;
+        size_t max_iter;
+        double escape_radius;
+        Formula formula;
+        double julia_x;
+        double julia_y;
+
+        Precision precision;
+        const KernelTable* kernels;
+        bool interior_checks;
+        bool keep_magnitudes;
+        Antialias antialias;
+    };
+
+    // colors of iteration counts, one cycle of the palette resampled to kPaletteLutSize pixels,
+    // so a pixel is a single lookup whatever the palette length, see palette.h
+    struct Palette {
+        uint32_t* lut;     // rgba pixels, aligned to kBufferAlign
+        uint32_t step;     // lut position per iteration in 16.16 fixed point, kPaletteLutSize / n_colors
+        uint32_t offset;   // lut position of count 0 in the same units, cycling moves it
+        uint32_t interior; // pixel of points which never escape
+        bool smooth;       // fractional iteration count from |z|^2 at escape, needs keep_magnitudes
+    };
+
+    // hot path counters of one frame, only collected with KERNEL_STATS (config.h), see stats.h;
+    // a vector runs as many trips as its slowest lane, every lane pays for each of them
+    struct KernelStats {
+        uint64_t n_vectors;          // CheckPixel calls, lanes past a tile edge included
+        uint64_t n_trips;            // loop trips of all vectors
+        uint64_t lane_slots;         // trips times lanes, what the vectors could have done
+        uint64_t lane_iterations;    // iterations lanes actually needed, all that a scalar loop would do
+        uint64_t partial_trips;      // trips with at least one lane already done
+        uint64_t n_interior;         // lanes which never escaped (interior checks or max_iter)
+        uint64_t histogram[kStatsBins]; // escaped lanes by iteration count, log2 bins
+
+        uint64_t n_tiles;
+        uint64_t tile_ticks;         // rdtsc ticks of the tile tasks (kernel and colorize) together
+        uint64_t max_tile_ticks;
+        uint64_t frame_ticks;        // whole Compute
     };
 
     struct MSet {
         sf::Uint8* pixels;
-        size_t n_pixels;
+        size_t n_pixels; // bytes in use, 4 * width * height
+        size_t capacity; // bytes allocated, kept across Resize calls
+        size_t frame_id; // changes whenever pixels do, so the screen uploads only new frames
+
+        // what kernels write, structure of arrays aligned to kBufferAlign: iteration count
+        // and |z|^2 at escape (0 inside) of every pixel, pixels are colored from them in a separate pass;
+        // float and double kernels only keep |z|^2 with keep_magnitudes, it is stale otherwise
+        uint32_t* iter_counts;
+        float* magnitudes;
+        bool keep_magnitudes;
+
+        Palette palette;
+
+        size_t width;    // any, the last group of a row goes through a copy of kLanes pixels
+        size_t height;
+        size_t max_iter;
+        double escape_radius;    // |z| a pixel escapes at, counts and smoothing depend on it
+
+        // reference orbits are z^2 + c from z = 0, so the other formulas stop at double precision
+        Formula formula;
+        double julia_x; // c of Formula::kJulia
+        double julia_y;
       
-        float move_x;
-        float move_y;
-        float scale;    
+        double move_x;
+        double move_y;
+        double scale;    
+
+        // part of the view center which does not fit in double,
+        // center = deep + move * 4 / avg_side, perturbation folds move into deep
+        HpReal deep_x;
+        HpReal deep_y;
+
+        // reference orbit of the frame center for perturbation, kept between frames
+        double* orbit_x;
+        double* orbit_y;
+        size_t orbit_capacity;
+        size_t orbit_len; // of the last perturbation frame, Recolor resamples its edges with it
+
+        // float and double kernels skip the main cardioid, the period 2 bulb and cycling orbits
+        bool interior_checks;
+
+        // float and double tiles go through lane refill kernels: pixels still iterating after
+        // kRefillTrips are queued and a lane takes the next one as soon as its own is done,
+        // the picture is the same
+        bool refill;
+
+        // vectors float and double tile kernels iterate side by side, 1, 2 or 4,
+        // 0 keeps the factor the kernel table found fastest
+        size_t interleave;
+
+        // full frames of float and double views take tiles computed before from here
+        // and put the new ones in, nullptr computes every tile, see tile_cache.h
+        TileCache* tile_cache;
+
+        // Mariani-Silver: iterate rectangle borders only and fill the ones with a single count
+        bool subdivide;
+        size_t n_iterated; // pixels the last Compute actually iterated
+
+        // coarse-to-fine: a new view first shows every kProgressiveStep-th pixel,
+        // later calls with the same view refine it for frame_budget_ms each
+        bool progressive;
+        size_t frame_budget_ms; // 0 means one pass per call
+        size_t pass_step;       // shown frame is complete at this step, 0 or 1 is full resolution
+        size_t pass_row;        // tile rows of the next finer pass already done
+
+        // pixels on the edges of count bands get the mean color of jittered samples around them,
+        // counts stay one sample per pixel, see antialias.h
+        Antialias antialias;
+        size_t n_samples; // extra samples the last Compute took, on top of one per pixel
+
+        ShownView shown;
+        ShownView rect_view; // of the last ComputeRect, later rects of the same view reuse its reference orbit
+
+        Precision precision;      // requested
+        Precision used_precision; // chosen by the last Compute
+
+        ThreadPool* pool;
+        const KernelTable* kernels; // widest the cpu supports unless set by hand, see kernels.h
+
+        KernelStats stats; // of the last Compute which computed anything, zero without KERNEL_STATS
     };
 
-    Error SetUp(MSet* m_set);
+    // buffers are sized for a width x height frame, n_threads = 0 means one thread per hardware thread
+    Error SetUp(MSet* m_set, size_t width, size_t height, size_t n_threads = 0);
     void TearDown(MSet* m_set);
 
+    // reuses pixel buffer if it is big enough; sides are up to INT32_MAX, tiles use int32_t
+    Error Resize(MSet* m_set, size_t width, size_t height);
+
+    Error SetThreadCount(MSet* m_set, size_t n_threads);
+
+    Viewport GetViewport(const MSet* m_set);
+    Precision ChoosePrecision(const MSet* m_set, const Viewport& view);
+    const char* PrecisionName(Precision precision);
+    const char* FormulaName(Formula formula);
+
+    // skips the frame if the view did not change since the last call,
+    // on a pure pan shifts the pixels and computes only the exposed strips,
+    // a progressive frame which is not refined yet is refined further instead
     void Compute(MSet* m_set);
+
+    // pixels were changed outside Compute, the next one has to draw the whole frame
+    void Invalidate(MSet* m_set);
+
+    // colors pixels again from the counts of the last Compute, without iterating anything,
+    // shows a new palette, its cycling or smoothing
+    void Recolor(MSet* m_set);
+
+    // computes and colors only the given rectangle of the frame, the same pixels a full Compute gives
+    // (subdivision, progressive passes, the cache and antialiasing aside), the rest stays as it is;
+    // x has to be a multiple of the widest simd group (16), cluster workers compute tiles with it
+    void ComputeRect(MSet* m_set, size_t x, size_t y, size_t width, size_t height);
+
+    // rows [first_row, first_row + n_rows) of an exponential map around the view center,
+    // n_angles rgba pixels each, see expmap.h; every call picks the precision its innermost row needs,
+    // the frame pixels are not touched, but the next Compute draws the whole frame
+    void ComputeExpMap(MSet* m_set, const ExpMap& map, size_t first_row, size_t n_rows, uint32_t* pixels);
 }
 
 #endif // MANDELBROT_H_
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#include "mandelbrot.h"
+
+namespace Mandelbrot {
+    // mcolor.h colors, no cycling, no smoothing
+    Error SetUpPalette(Palette* palette);
+    void TearDownPalette(Palette* palette);
+
+    // colors are 0xRRGGBBAA like in mcolor.h, one per iteration, the lut is linearly
+    // interpolated between them and wraps around after the last one
+    void SetPalette(Palette* palette, const uint32_t* colors, size_t n_colors);
+
+    // built in "mcolor" or "gray", otherwise a file of 0xRRGGBBAA numbers separated by spaces,
+    // commas or new lines, lines starting with # are skipped (so mcolor.h itself is a palette file)
+    Error LoadPalette(Palette* palette, const char* name);
+
+    // moves colors along the counts, Recolor shows it
+    void CyclePalette(Palette* palette, double n_iterations);
+}
+
+#endif // PALETTE_H_
@@ -0,0 +1,13 @@
+#ifndef PROGRESSIVE_H_
+#define PROGRESSIVE_H_
+
+#include "kernels.h"
+
+namespace Mandelbrot {
+    // one coarse-to-fine pass inside one tile: iterates pixels on the frame.pass_step lattice
+    // that coarser passes have not iterated yet and fills pass_step x pass_step blocks with them,
+    // the last pass iterates the whole tile; returns how many pixels were actually iterated
+    size_t ComputePass(const Frame& frame, Tile tile);
+}
+
+#endif // PROGRESSIVE_H_
@@ -0,0 +1,158 @@
+#ifndef SIMD_AVX2_H_
+#define SIMD_AVX2_H_
+
+// 256 bit vectors for kernel_impl.h, include only after #pragma GCC target("avx2")
+// or target("avx2,fma") when kFma is set
+
+#include <immintrin.h>
+
+namespace {
+
+template <bool kFma>
+struct Avx2F32 {
+    typedef float   Scalar;
+    typedef __m256  Real;
+    typedef __m256  Mask;  // all ones in active lanes
+    typedef __m256i Count; // 8 x int32
+
+    static const int32_t kLanes = 8;
+
+    static Real Set1(double value)   { return _mm256_set1_ps((float)value); }
+    static Real Zero()               { return _mm256_setzero_ps(); }
+    static Real Load(const Scalar* src) { return _mm256_loadu_ps(src); }
+    static void Store(Real value, Scalar* dest) { _mm256_storeu_ps(dest, value); }
+    static Real LaneIndex()          { return _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f); }
+
+    static Real Add(Real a, Real b)  { return _mm256_add_ps(a, b); }
+    static Real Sub(Real a, Real b)  { return _mm256_sub_ps(a, b); }
+    static Real Mul(Real a, Real b)  { return _mm256_mul_ps(a, b); }
+
+    static Real MulAdd(Real a, Real b, Real c) {
+        if constexpr (kFma) {
+            return _mm256_fmadd_ps(a, b, c);
+        } else {
+            return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+        }
+    }
+
+    static Real Abs(Real a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+    static Mask Less(Real a, Real b)   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask And(Mask a, Mask b)    { return _mm256_and_ps(a, b); }
+    static Mask Or(Mask a, Mask b)     { return _mm256_or_ps(a, b); }
+    static Mask AndNot(Mask a, Mask b) { return _mm256_andnot_ps(a, b); }
+    static Mask AllLanes()             { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+    static bool Any(Mask mask)         { return _mm256_movemask_ps(mask) != 0; }
+    static uint32_t MaskBits(Mask mask) { return (uint32_t)_mm256_movemask_ps(mask); }
+
+    static Real Blend(Real a, Real b, Mask mask) { return _mm256_blendv_ps(a, b, mask); }
+    static Real ZeroWhere(Real a, Mask mask)     { return _mm256_andnot_ps(mask, a); }
+
+    // active lanes of mask are -1, subtracting it counts them
+    static Count CountZero()                         { return _mm256_setzero_si256(); }
+    static Count CountActive(Count count, Mask mask) { return _mm256_sub_epi32(count, _mm256_castps_si256(mask)); }
+
+    static Count CountWhere(Count count, Mask mask, uint32_t value) {
+        return _mm256_blendv_epi8(count, _mm256_set1_epi32((int)value), _mm256_castps_si256(mask));
+    }
+
+    static void  StoreCounts(Count count, uint32_t* dest) { _mm256_storeu_si256((__m256i*)dest, count); }
+    static void  StoreMagnitudes(Real value, float* dest)  { _mm256_storeu_ps(dest, value); }
+
+    // colorizing, counts and rgba pixels as 32 bit integer lanes
+    static Count LoadCounts(const uint32_t* src)          { return _mm256_loadu_si256((const __m256i*)src); }
+    static Count CountSet1(uint32_t value)                { return _mm256_set1_epi32((int)value); }
+    static Count CountAdd(Count a, Count b)               { return _mm256_add_epi32(a, b); }
+    static Count CountMul(Count count, uint32_t value)    { return _mm256_mullo_epi32(count, _mm256_set1_epi32((int)value)); }
+    static Count CountAnd(Count count, uint32_t value)    { return _mm256_and_si256(count, _mm256_set1_epi32((int)value)); }
+    static Count CountOr(Count count, uint32_t value)     { return _mm256_or_si256(count, _mm256_set1_epi32((int)value)); }
+    static Count CountShiftRight(Count count, int shift)  { return _mm256_srl_epi32(count, _mm_cvtsi32_si128(shift)); }
+
+    // counts stay far below 2^31, so the signed compare will do
+    static Mask CountAbove(Count count, uint32_t value) {
+        return _mm256_castsi256_ps(_mm256_cmpgt_epi32(count, _mm256_set1_epi32((int)value)));
+    }
+
+    static Count RealBits(Real value)    { return _mm256_castps_si256(value); }
+    static Real  FromBits(Count bits)    { return _mm256_castsi256_ps(bits); }
+    static Real  CountToReal(Count count) { return _mm256_cvtepi32_ps(count); }
+    static Count RealToCount(Real value) { return _mm256_cvttps_epi32(value); }
+
+    static Count GatherCounts(const uint32_t* base, Count index) {
+        return _mm256_i32gather_epi32((const int*)base, index, 4);
+    }
+};
+
+template <bool kFma>
+struct Avx2F64 {
+    typedef double  Scalar;
+    typedef __m256d Real;
+    typedef __m256d Mask;
+    typedef __m256i Count; // 4 x int64
+    typedef __m256i Index; // 4 x int64
+
+    static const int32_t kLanes = 4;
+
+    static Real Set1(double value)   { return _mm256_set1_pd(value); }
+    static Real Zero()               { return _mm256_setzero_pd(); }
+    static Real Load(const Scalar* src) { return _mm256_loadu_pd(src); }
+    static void Store(Real value, Scalar* dest) { _mm256_storeu_pd(dest, value); }
+    static Real LaneIndex()          { return _mm256_set_pd(3.0, 2.0, 1.0, 0.0); }
+
+    static Real Add(Real a, Real b)  { return _mm256_add_pd(a, b); }
+    static Real Sub(Real a, Real b)  { return _mm256_sub_pd(a, b); }
+    static Real Mul(Real a, Real b)  { return _mm256_mul_pd(a, b); }
+
+    static Real MulAdd(Real a, Real b, Real c) {
+        if constexpr (kFma) {
+            return _mm256_fmadd_pd(a, b, c);
+        } else {
+            return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+        }
+    }
+
+    static Real Abs(Real a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+
+    static Mask Less(Real a, Real b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static Mask And(Mask a, Mask b)  { return _mm256_and_pd(a, b); }
+    static Mask Or(Mask a, Mask b)   { return _mm256_or_pd(a, b); }
+    static Mask AndNot(Mask a, Mask b) { return _mm256_andnot_pd(a, b); }
+    static Mask AllLanes()           { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+    static bool Any(Mask mask)       { return _mm256_movemask_pd(mask) != 0; }
+    static uint32_t MaskBits(Mask mask) { return (uint32_t)_mm256_movemask_pd(mask); }
+
+    static Real Blend(Real a, Real b, Mask mask) { return _mm256_blendv_pd(a, b, mask); }
+    static Real ZeroWhere(Real a, Mask mask)     { return _mm256_andnot_pd(mask, a); }
+
+    static Count CountZero()                         { return _mm256_setzero_si256(); }
+    static Count CountActive(Count count, Mask mask) { return _mm256_sub_epi64(count, _mm256_castpd_si256(mask)); }
+
+    static Count CountWhere(Count count, Mask mask, uint32_t value) {
+        return _mm256_blendv_epi8(count, _mm256_set1_epi64x(value), _mm256_castpd_si256(mask));
+    }
+
+    // low halves of the 64 bit counters
+    static void StoreCounts(Count count, uint32_t* dest) {
+        __m256i packed = _mm256_permutevar8x32_epi32(count, _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0));
+        _mm_storeu_si128((__m128i*)dest, _mm256_castsi256_si128(packed));
+    }
+
+    static void StoreMagnitudes(Real value, float* dest) { _mm_storeu_ps(dest, _mm256_cvtpd_ps(value)); }
+
+    static Index IndexZero()           { return _mm256_setzero_si256(); }
+    static Index IndexInc(Index index) { return _mm256_add_epi64(index, _mm256_set1_epi64x(1)); }
+
+    static Mask IndexEqual(Index index, size_t value) {
+        return _mm256_castsi256_pd(_mm256_cmpeq_epi64(index, _mm256_set1_epi64x((long long)value)));
+    }
+
+    static Index IndexZeroWhere(Index index, Mask mask) {
+        return _mm256_andnot_si256(_mm256_castpd_si256(mask), index);
+    }
+
+    static Real Gather(const double* base, Index index) { return _mm256_i64gather_pd(base, index, 8); }
+};
+
+} // namespace
+
+#endif // SIMD_AVX2_H_
@@ -0,0 +1,152 @@
+#ifndef SIMD_AVX512_H_
+#define SIMD_AVX512_H_
+
+// 512 bit vectors for kernel_impl.h, include only after #pragma GCC target("avx512f"),
+// masks live in k registers, so counting and blending need no vector compares
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512F32 {
+    typedef float     Scalar;
+    typedef __m512    Real;
+    typedef __mmask16 Mask;
+    typedef __m512i   Count; // 16 x int32
+
+    static const int32_t kLanes = 16;
+
+    static Real Set1(double value)   { return _mm512_set1_ps((float)value); }
+    static Real Zero()               { return _mm512_setzero_ps(); }
+    static Real Load(const Scalar* src) { return _mm512_loadu_ps(src); }
+    static void Store(Real value, Scalar* dest) { _mm512_storeu_ps(dest, value); }
+
+    static Real LaneIndex() {
+        return _mm512_set_ps(15.0f, 14.0f, 13.0f, 12.0f, 11.0f, 10.0f, 9.0f, 8.0f,
+                             7.0f,  6.0f,  5.0f,  4.0f,  3.0f,  2.0f,  1.0f, 0.0f);
+    }
+
+    static Real Add(Real a, Real b)  { return _mm512_add_ps(a, b); }
+    static Real Sub(Real a, Real b)  { return _mm512_sub_ps(a, b); }
+    static Real Mul(Real a, Real b)  { return _mm512_mul_ps(a, b); }
+    static Real MulAdd(Real a, Real b, Real c) { return _mm512_fmadd_ps(a, b, c); }
+    static Real Abs(Real a)          { return _mm512_abs_ps(a); }
+
+    static Mask Less(Real a, Real b)   { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static Mask And(Mask a, Mask b)    { return (Mask)(a & b); }
+    static Mask Or(Mask a, Mask b)     { return (Mask)(a | b); }
+    static Mask AndNot(Mask a, Mask b) { return (Mask)(~a & b); }
+    static Mask AllLanes()             { return (Mask)0xFFFF; }
+    static bool Any(Mask mask)         { return mask != 0; }
+    static uint32_t MaskBits(Mask mask) { return mask; }
+
+    static Real Blend(Real a, Real b, Mask mask) { return _mm512_mask_blend_ps(mask, a, b); }
+    static Real ZeroWhere(Real a, Mask mask)     { return _mm512_maskz_mov_ps((Mask)~mask, a); }
+
+    static Count CountZero() { return _mm512_setzero_si512(); }
+
+    static Count CountActive(Count count, Mask mask) {
+        return _mm512_mask_add_epi32(count, mask, count, _mm512_set1_epi32(1));
+    }
+
+    static Count CountWhere(Count count, Mask mask, uint32_t value) {
+        return _mm512_mask_mov_epi32(count, mask, _mm512_set1_epi32((int)value));
+    }
+
+    static void StoreCounts(Count count, uint32_t* dest) { _mm512_storeu_si512(dest, count); }
+    static void StoreMagnitudes(Real value, float* dest) { _mm512_storeu_ps(dest, value); }
+
+    // colorizing, counts and rgba pixels as 32 bit integer lanes;
+    // masked forms because the plain ones merge into an undefined vector gcc warns about
+    static const Mask kAllLanes = 0xFFFF;
+
+    static Count LoadCounts(const uint32_t* src)          { return _mm512_loadu_si512(src); }
+    static Count CountSet1(uint32_t value)                { return _mm512_set1_epi32((int)value); }
+    static Count CountAdd(Count a, Count b)               { return _mm512_add_epi32(a, b); }
+    static Count CountMul(Count count, uint32_t value)    { return _mm512_mullo_epi32(count, _mm512_set1_epi32((int)value)); }
+    static Count CountAnd(Count count, uint32_t value)    { return _mm512_and_si512(count, _mm512_set1_epi32((int)value)); }
+    static Count CountOr(Count count, uint32_t value)     { return _mm512_or_si512(count, _mm512_set1_epi32((int)value)); }
+    static Count CountShiftRight(Count count, int shift)  { return _mm512_maskz_srl_epi32(kAllLanes, count, _mm_cvtsi32_si128(shift)); }
+
+    static Mask CountAbove(Count count, uint32_t value) {
+        return _mm512_cmpgt_epu32_mask(count, _mm512_set1_epi32((int)value));
+    }
+
+    static Count RealBits(Real value)    { return _mm512_castps_si512(value); }
+    static Real  FromBits(Count bits)    { return _mm512_castsi512_ps(bits); }
+    static Real  CountToReal(Count count) { return _mm512_maskz_cvtepi32_ps(kAllLanes, count); }
+    static Count RealToCount(Real value) { return _mm512_maskz_cvttps_epi32(kAllLanes, value); }
+
+    static Count GatherCounts(const uint32_t* base, Count index) {
+        return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), kAllLanes, index, (const int*)base, 4);
+    }
+};
+
+struct Avx512F64 {
+    typedef double   Scalar;
+    typedef __m512d  Real;
+    typedef __mmask8 Mask;
+    typedef __m512i  Count; // 8 x int64
+    typedef __m512i  Index; // 8 x int64
+
+    static const int32_t kLanes = 8;
+
+    static Real Set1(double value)   { return _mm512_set1_pd(value); }
+    static Real Zero()               { return _mm512_setzero_pd(); }
+    static Real Load(const Scalar* src) { return _mm512_loadu_pd(src); }
+    static void Store(Real value, Scalar* dest) { _mm512_storeu_pd(dest, value); }
+    static Real LaneIndex()          { return _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0); }
+
+    static Real Add(Real a, Real b)  { return _mm512_add_pd(a, b); }
+    static Real Sub(Real a, Real b)  { return _mm512_sub_pd(a, b); }
+    static Real Mul(Real a, Real b)  { return _mm512_mul_pd(a, b); }
+    static Real MulAdd(Real a, Real b, Real c) { return _mm512_fmadd_pd(a, b, c); }
+    static Real Abs(Real a)          { return _mm512_abs_pd(a); }
+
+    static Mask Less(Real a, Real b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static Mask And(Mask a, Mask b)  { return (Mask)(a & b); }
+    static Mask Or(Mask a, Mask b)   { return (Mask)(a | b); }
+    static Mask AndNot(Mask a, Mask b) { return (Mask)(~a & b); }
+    static Mask AllLanes()           { return (Mask)0xFF; }
+    static bool Any(Mask mask)       { return mask != 0; }
+    static uint32_t MaskBits(Mask mask) { return mask; }
+
+    static Real Blend(Real a, Real b, Mask mask) { return _mm512_mask_blend_pd(mask, a, b); }
+    static Real ZeroWhere(Real a, Mask mask)     { return _mm512_maskz_mov_pd((Mask)~mask, a); }
+
+    static Count CountZero() { return _mm512_setzero_si512(); }
+
+    static Count CountActive(Count count, Mask mask) {
+        return _mm512_mask_add_epi64(count, mask, count, _mm512_set1_epi64(1));
+    }
+
+    static Count CountWhere(Count count, Mask mask, uint32_t value) {
+        return _mm512_mask_mov_epi64(count, mask, _mm512_set1_epi64(value));
+    }
+
+    static void StoreCounts(Count count, uint32_t* dest) {
+        _mm512_mask_cvtepi64_storeu_epi32(dest, 0xFF, count);
+    }
+
+    static void StoreMagnitudes(Real value, float* dest) {
+        _mm256_storeu_ps(dest, _mm512_mask_cvtpd_ps(_mm256_setzero_ps(), 0xFF, value));
+    }
+
+    static Index IndexZero()           { return _mm512_setzero_si512(); }
+    static Index IndexInc(Index index) { return _mm512_add_epi64(index, _mm512_set1_epi64(1)); }
+
+    static Mask IndexEqual(Index index, size_t value) {
+        return _mm512_cmpeq_epi64_mask(index, _mm512_set1_epi64((long long)value));
+    }
+
+    static Index IndexZeroWhere(Index index, Mask mask) { return _mm512_maskz_mov_epi64((Mask)~mask, index); }
+
+    // masked forms with explicit sources, the plain ones start from an undefined register
+    static Real Gather(const double* base, Index index) {
+        return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, index, base, 8);
+    }
+};
+
+} // namespace
+
+#endif // SIMD_AVX512_H_
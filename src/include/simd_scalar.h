@@ -0,0 +1,90 @@
+#ifndef SIMD_SCALAR_H_
+#define SIMD_SCALAR_H_
+
+// one lane vector for kernel_impl.h, the reference every wider simd_<isa>.h follows
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+template <typename T>
+struct ScalarLanes {
+    typedef T        Scalar;
+    typedef T        Real;
+    typedef bool     Mask;
+    typedef uint32_t Count;
+    typedef size_t   Index;
+
+    static const int32_t kLanes = 1;
+
+    static Real Set1(double value)         { return (Real)value; }
+    static Real Zero()                     { return 0; }
+    static Real Load(const Scalar* src)    { return src[0]; }
+    static void Store(Real value, Scalar* dest) { dest[0] = value; }
+    static Real LaneIndex()                { return 0; }
+
+    static Real Add(Real a, Real b)        { return a + b; }
+    static Real Sub(Real a, Real b)        { return a - b; }
+    static Real Mul(Real a, Real b)        { return a * b; }
+    static Real MulAdd(Real a, Real b, Real c) { return a * b + c; }
+    static Real Abs(Real a)                { return (a < 0) ? -a : a; }
+
+    static Mask Less(Real a, Real b)       { return a < b; }
+    static Mask And(Mask a, Mask b)        { return a && b; }
+    static Mask Or(Mask a, Mask b)         { return a || b; }
+    static Mask AndNot(Mask a, Mask b)     { return !a && b; }
+    static Mask AllLanes()                 { return true; }
+    static bool Any(Mask mask)             { return mask; }
+    static uint32_t MaskBits(Mask mask)    { return mask ? 1 : 0; }
+
+    static Real Blend(Real a, Real b, Mask mask) { return mask ? b : a; }
+    static Real ZeroWhere(Real a, Mask mask)     { return mask ? 0 : a; }
+
+    static Count CountZero()                       { return 0; }
+    static Count CountActive(Count count, Mask mask) { return count + (mask ? 1 : 0); }
+    static Count CountWhere(Count count, Mask mask, uint32_t value) { return mask ? value : count; }
+    static void  StoreCounts(Count count, uint32_t* dest) { dest[0] = count; }
+    static void  StoreMagnitudes(Real value, float* dest)  { dest[0] = (float)value; }
+
+    // colorizing, only ScalarF32 has 32 bit reals to match the counts
+    static Count LoadCounts(const uint32_t* src)          { return src[0]; }
+    static Count CountSet1(uint32_t value)                { return value; }
+    static Count CountAdd(Count a, Count b)               { return a + b; }
+    static Count CountMul(Count count, uint32_t value)    { return count * value; }
+    static Count CountAnd(Count count, uint32_t value)    { return count & value; }
+    static Count CountOr(Count count, uint32_t value)     { return count | value; }
+    static Count CountShiftRight(Count count, int shift)  { return count >> shift; }
+    static Mask  CountAbove(Count count, uint32_t value)  { return count > value; }
+
+    static Count RealBits(Real value) {
+        static_assert(sizeof(Real) == sizeof(Count), "bits of a real have to fit in a count");
+        Count bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static Real FromBits(Count bits) {
+        Real value = 0;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static Real  CountToReal(Count count) { return (Real)(int32_t)count; }
+    static Count RealToCount(Real value) { return (Count)(int32_t)value; }
+    static Count GatherCounts(const uint32_t* base, Count index) { return base[index]; }
+
+    static Index IndexZero()                            { return 0; }
+    static Index IndexInc(Index index)                  { return index + 1; }
+    static Mask  IndexEqual(Index index, size_t value)  { return index == value; }
+    static Index IndexZeroWhere(Index index, Mask mask) { return mask ? 0 : index; }
+    static Real  Gather(const double* base, Index index) { return base[index]; }
+};
+
+typedef ScalarLanes<float>  ScalarF32;
+typedef ScalarLanes<double> ScalarF64;
+
+} // namespace
+
+#endif // SIMD_SCALAR_H_
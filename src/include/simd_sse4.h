@@ -0,0 +1,143 @@
+#ifndef SIMD_SSE4_H_
+#define SIMD_SSE4_H_
+
+// 128 bit vectors for kernel_impl.h, include only after #pragma GCC target("sse4.1")
+
+#include <immintrin.h>
+
+namespace {
+
+struct Sse4F32 {
+    typedef float   Scalar;
+    typedef __m128  Real;
+    typedef __m128  Mask;  // all ones in active lanes
+    typedef __m128i Count; // 4 x int32
+
+    static const int32_t kLanes = 4;
+
+    static Real Set1(double value)   { return _mm_set1_ps((float)value); }
+    static Real Zero()               { return _mm_setzero_ps(); }
+    static Real Load(const Scalar* src) { return _mm_loadu_ps(src); }
+    static void Store(Real value, Scalar* dest) { _mm_storeu_ps(dest, value); }
+    static Real LaneIndex()          { return _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f); }
+
+    static Real Add(Real a, Real b)  { return _mm_add_ps(a, b); }
+    static Real Sub(Real a, Real b)  { return _mm_sub_ps(a, b); }
+    static Real Mul(Real a, Real b)  { return _mm_mul_ps(a, b); }
+    static Real MulAdd(Real a, Real b, Real c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static Real Abs(Real a)          { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+    static Mask Less(Real a, Real b)   { return _mm_cmplt_ps(a, b); }
+    static Mask And(Mask a, Mask b)    { return _mm_and_ps(a, b); }
+    static Mask Or(Mask a, Mask b)     { return _mm_or_ps(a, b); }
+    static Mask AndNot(Mask a, Mask b) { return _mm_andnot_ps(a, b); }
+    static Mask AllLanes()             { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+    static bool Any(Mask mask)         { return _mm_movemask_ps(mask) != 0; }
+    static uint32_t MaskBits(Mask mask) { return (uint32_t)_mm_movemask_ps(mask); }
+
+    static Real Blend(Real a, Real b, Mask mask) { return _mm_blendv_ps(a, b, mask); }
+    static Real ZeroWhere(Real a, Mask mask)     { return _mm_andnot_ps(mask, a); }
+
+    // active lanes of mask are -1, subtracting it counts them
+    static Count CountZero()                         { return _mm_setzero_si128(); }
+    static Count CountActive(Count count, Mask mask) { return _mm_sub_epi32(count, _mm_castps_si128(mask)); }
+
+    static Count CountWhere(Count count, Mask mask, uint32_t value) {
+        return _mm_blendv_epi8(count, _mm_set1_epi32((int)value), _mm_castps_si128(mask));
+    }
+
+    static void  StoreCounts(Count count, uint32_t* dest) { _mm_storeu_si128((__m128i*)dest, count); }
+    static void  StoreMagnitudes(Real value, float* dest)  { _mm_storeu_ps(dest, value); }
+
+    // colorizing, counts and rgba pixels as 32 bit integer lanes
+    static Count LoadCounts(const uint32_t* src)          { return _mm_loadu_si128((const __m128i*)src); }
+    static Count CountSet1(uint32_t value)                { return _mm_set1_epi32((int)value); }
+    static Count CountAdd(Count a, Count b)               { return _mm_add_epi32(a, b); }
+    static Count CountMul(Count count, uint32_t value)    { return _mm_mullo_epi32(count, _mm_set1_epi32((int)value)); }
+    static Count CountAnd(Count count, uint32_t value)    { return _mm_and_si128(count, _mm_set1_epi32((int)value)); }
+    static Count CountOr(Count count, uint32_t value)     { return _mm_or_si128(count, _mm_set1_epi32((int)value)); }
+    static Count CountShiftRight(Count count, int shift)  { return _mm_srl_epi32(count, _mm_cvtsi32_si128(shift)); }
+
+    // counts stay far below 2^31, so the signed compare will do
+    static Mask CountAbove(Count count, uint32_t value) {
+        return _mm_castsi128_ps(_mm_cmpgt_epi32(count, _mm_set1_epi32((int)value)));
+    }
+
+    static Count RealBits(Real value)    { return _mm_castps_si128(value); }
+    static Real  FromBits(Count bits)    { return _mm_castsi128_ps(bits); }
+    static Real  CountToReal(Count count) { return _mm_cvtepi32_ps(count); }
+    static Count RealToCount(Real value) { return _mm_cvttps_epi32(value); }
+
+    // no gather before avx2
+    static Count GatherCounts(const uint32_t* base, Count index) {
+        return _mm_set_epi32((int)base[_mm_extract_epi32(index, 3)], (int)base[_mm_extract_epi32(index, 2)],
+                             (int)base[_mm_extract_epi32(index, 1)], (int)base[_mm_cvtsi128_si32(index)]);
+    }
+};
+
+struct Sse4F64 {
+    typedef double  Scalar;
+    typedef __m128d Real;
+    typedef __m128d Mask;
+    typedef __m128i Count; // 2 x int64
+    typedef __m128i Index; // 2 x int64
+
+    static const int32_t kLanes = 2;
+
+    static Real Set1(double value)   { return _mm_set1_pd(value); }
+    static Real Zero()               { return _mm_setzero_pd(); }
+    static Real Load(const Scalar* src) { return _mm_loadu_pd(src); }
+    static void Store(Real value, Scalar* dest) { _mm_storeu_pd(dest, value); }
+    static Real LaneIndex()          { return _mm_set_pd(1.0, 0.0); }
+
+    static Real Add(Real a, Real b)  { return _mm_add_pd(a, b); }
+    static Real Sub(Real a, Real b)  { return _mm_sub_pd(a, b); }
+    static Real Mul(Real a, Real b)  { return _mm_mul_pd(a, b); }
+    static Real MulAdd(Real a, Real b, Real c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static Real Abs(Real a)          { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+
+    static Mask Less(Real a, Real b) { return _mm_cmplt_pd(a, b); }
+    static Mask And(Mask a, Mask b)  { return _mm_and_pd(a, b); }
+    static Mask Or(Mask a, Mask b)   { return _mm_or_pd(a, b); }
+    static Mask AndNot(Mask a, Mask b) { return _mm_andnot_pd(a, b); }
+    static Mask AllLanes()           { return _mm_castsi128_pd(_mm_set1_epi64x(-1)); }
+    static bool Any(Mask mask)       { return _mm_movemask_pd(mask) != 0; }
+    static uint32_t MaskBits(Mask mask) { return (uint32_t)_mm_movemask_pd(mask); }
+
+    static Real Blend(Real a, Real b, Mask mask) { return _mm_blendv_pd(a, b, mask); }
+    static Real ZeroWhere(Real a, Mask mask)     { return _mm_andnot_pd(mask, a); }
+
+    static Count CountZero()                         { return _mm_setzero_si128(); }
+    static Count CountActive(Count count, Mask mask) { return _mm_sub_epi64(count, _mm_castpd_si128(mask)); }
+
+    static Count CountWhere(Count count, Mask mask, uint32_t value) {
+        return _mm_blendv_epi8(count, _mm_set1_epi64x(value), _mm_castpd_si128(mask));
+    }
+
+    static void StoreCounts(Count count, uint32_t* dest) {
+        dest[0] = (uint32_t)_mm_cvtsi128_si64(count);
+        dest[1] = (uint32_t)_mm_extract_epi64(count, 1);
+    }
+
+    static void StoreMagnitudes(Real value, float* dest) { _mm_storel_pi((__m64*)dest, _mm_cvtpd_ps(value)); }
+
+    static Index IndexZero()                { return _mm_setzero_si128(); }
+    static Index IndexInc(Index index)      { return _mm_add_epi64(index, _mm_set1_epi64x(1)); }
+
+    static Mask IndexEqual(Index index, size_t value) {
+        return _mm_castsi128_pd(_mm_cmpeq_epi64(index, _mm_set1_epi64x((long long)value)));
+    }
+
+    static Index IndexZeroWhere(Index index, Mask mask) {
+        return _mm_andnot_si128(_mm_castpd_si128(mask), index);
+    }
+
+    // no gather before avx2
+    static Real Gather(const double* base, Index index) {
+        return _mm_set_pd(base[_mm_extract_epi64(index, 1)], base[_mm_cvtsi128_si64(index)]);
+    }
+};
+
+} // namespace
+
+#endif // SIMD_SSE4_H_
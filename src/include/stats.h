@@ -0,0 +1,33 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "mandelbrot.h"
+
+#include <mutex>
+
+namespace Mandelbrot {
+    void ResetStats(KernelStats* stats);
+
+    // sums the counters, max_tile_ticks is the max of both
+    void AddStats(KernelStats* total, const KernelStats& part);
+
+    // one line of totals and utilization, one of tile ticks and one of the nonzero histogram bins
+    void PrintStats(FILE* stream, const KernelStats& stats);
+
+    // the rest is only called with KERNEL_STATS
+
+    // one vector of CheckPixel: iterations each lane was active in and the counts it stored,
+    // lanes stay done once they are, so the vector ran as many trips as its slowest lane
+    void RecordVector(const uint32_t* active, const uint32_t* counts, size_t n_lanes, size_t max_iter);
+
+    // same for lane refill kernels, which have no fixed vectors: one pixel as it is done
+    // and all trips of a tile, partial ones are those after the tile ran out of pixels
+    void RecordPixel(uint32_t active, uint32_t count, size_t max_iter);
+    void RecordTrips(uint64_t n_trips, uint64_t partial_trips, size_t n_lanes);
+
+    // around one tile task, vectors recorded between them by this thread go to stats under lock
+    void BeginTileStats();
+    void EndTileStats(KernelStats* stats, std::mutex* lock);
+}
+
+#endif // STATS_H_
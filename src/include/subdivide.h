@@ -0,0 +1,13 @@
+#ifndef SUBDIVIDE_H_
+#define SUBDIVIDE_H_
+
+#include "kernels.h"
+
+namespace Mandelbrot {
+    // Mariani-Silver inside one tile: iterates rectangle borders, fills a rectangle when
+    // its whole border has one count, splits it in two otherwise;
+    // returns how many pixels were actually iterated
+    size_t ComputeSubdivided(const Frame& frame, Tile tile);
+}
+
+#endif // SUBDIVIDE_H_
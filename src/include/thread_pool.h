@@ -0,0 +1,22 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <stddef.h>
+
+namespace Mandelbrot {
+    // task is called as func(context, task_id) for every task_id in [0, n_tasks)
+    typedef void (*TaskFunc)(void* context, size_t task_id);
+
+    struct ThreadPool;
+
+    // n_threads includes the calling thread, 0 means one per hardware thread
+    ThreadPool* CreateThreadPool(size_t n_threads);
+    void DestroyThreadPool(ThreadPool* pool);
+
+    size_t ThreadCount(const ThreadPool* pool);
+
+    // blocks until every task is done, caller thread works as worker 0
+    void RunTasks(ThreadPool* pool, size_t n_tasks, TaskFunc func, void* context);
+}
+
+#endif // THREAD_POOL_H_
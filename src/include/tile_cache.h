@@ -0,0 +1,51 @@
+#ifndef TILE_CACHE_H_
+#define TILE_CACHE_H_
+
+#include "kernels.h"
+
+namespace Mandelbrot {
+    // everything the counts and |z|^2 of a tile depend on; tile origin and pixel step are quantized,
+    // so views which differ by less than kTileCacheQuant of a pixel share tiles
+    struct TileKey {
+        int64_t x;              // tile origin in pixel steps / kTileCacheQuant
+        int64_t y;
+        uint64_t step;          // bits of the pixel step without the lowest kTileCacheStepBits
+        uint64_t max_iter;
+        uint64_t escape_radius; // bits
+        uint64_t julia_x;       // bits, 0 for the other formulas
+        uint64_t julia_y;
+        uint64_t kernels;       // FNV-1a of the kernel table name, pointers change between runs
+        uint32_t width;
+        uint32_t height;
+        uint32_t precision;
+        uint32_t flags;         // interior checks, keep magnitudes, formula from bit 2 on
+    };
+
+    // counts and |z|^2 of computed tiles: kTileCacheTiles in memory, least recently used goes first,
+    // and optionally a file of kTileCacheSlots slots mapped with mmap, which outlives the program;
+    // a tile goes to slot hash % n_slots there and replaces whatever was in it
+    struct TileCache;
+
+    // disk_path = nullptr keeps tiles in memory only, a file of another layout is cleared
+    TileCache* CreateTileCache(const char* disk_path);
+    void DestroyTileCache(TileCache* cache);
+
+    // float and double tiles only, perturbation counts depend on the reference orbit too;
+    // tile is in frame pixels and may reach out of the frame
+    TileKey MakeTileKey(const Frame& frame, Tile tile);
+
+    // pixels from the first cache tile of the frame to its pixel 0: cache tiles are kTileWidth x kTileHight
+    // blocks of whole pixel steps counted from 0 of the plane, not from the frame, so overlapping views
+    // share every tile they both cover
+    void TileLead(const Viewport& view, int32_t* lead_x, int32_t* lead_y);
+
+    // copies the cached counts and |z|^2 into the part of the tile inside the frame of m_set,
+    // false if the tile is not cached; only tiles inside the frame are stored
+    bool LoadTile(TileCache* cache, const TileKey& key, MSet* m_set, Tile tile);
+    void StoreTile(TileCache* cache, const TileKey& key, const MSet* m_set, Tile tile);
+
+    // hits in memory and on disk and misses since CreateTileCache
+    void PrintTileCache(FILE* stream, TileCache* cache);
+}
+
+#endif // TILE_CACHE_H_
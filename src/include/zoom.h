@@ -0,0 +1,25 @@
+#ifndef ZOOM_H_
+#define ZOOM_H_
+
+#include <stddef.h>
+
+#include "headless.h"
+
+// zoom video from the default view (scale 1) into the center of the job, the pixel step
+// shrinks by the same factor every frame and the last frame has the scale of the job (at most 1);
+// in the job output a run of '#' is replaced by the zero padded frame number,
+// "-" writes raw rgba frames to stdout one after another (a pipe into a video encoder)
+struct ZoomJob {
+    RenderJob end;
+    size_t n_frames;
+};
+
+// "re,im,scale,WxH,max_iter,frames,output"
+bool ParseZoom(const char* spec, ZoomJob* zoom);
+
+// frames are resampled from one exponential map of the zoom path (expmap.h), which is computed
+// row chunk by row chunk as the frames go deeper and kept only as far as the next frame needs it;
+// only the center of every frame, where map cells are much finer than pixels, is computed directly
+Mandelbrot::Error RenderZoom(Mandelbrot::MSet* m_set, const ZoomJob* zoom);
+
+#endif // ZOOM_H_
@@ -0,0 +1,174 @@
+#include "antialias.h"
+
+#include <algorithm>
+
+// static ---------------------------------------------------------------------
+
+static const size_t kBatchSize = 128;
+static const size_t kSamples   = kAntialiasGrid * kAntialiasGrid;
+
+// edge pixels waiting for their samples, a batch goes through the point kernel once per sample
+struct EdgeBatch {
+    const Mandelbrot::Frame* frame;
+    Mandelbrot::PointKernel kernel;
+
+    Mandelbrot::Point points[kBatchSize];
+    uint32_t sums[kBatchSize][4]; // rgba bytes of all samples so far
+    size_t n_points;
+
+    size_t n_samples;
+};
+
+static bool IsEdge(const Mandelbrot::MSet* m_set, int32_t x, int32_t y);
+static void SampleOffset(size_t sample, double* sample_x, double* sample_y);
+static void FlushBatch(EdgeBatch* batch);
+
+// global ---------------------------------------------------------------------
+
+size_t Mandelbrot::ComputeAntialiased(const Frame& frame, Tile tile) {
+    assert(frame.m_set != nullptr);
+    assert(frame.m_set->antialias != Antialias::kOff);
+
+    EdgeBatch batch = {};
+    batch.frame  = &frame;
+    batch.kernel = ChoosePointKernel(frame);
+
+    bool every_pixel = frame.m_set->antialias == Antialias::kFull;
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+            if (!every_pixel && !IsEdge(frame.m_set, x, y)) {
+                continue;
+            }
+
+            batch.points[batch.n_points++] = {x, y};
+            if (batch.n_points == kBatchSize) {
+                FlushBatch(&batch);
+            }
+        }
+    }
+
+    FlushBatch(&batch);
+
+    return batch.n_samples;
+}
+
+void Mandelbrot::PrintAntialias(FILE* stream, const MSet* m_set) {
+    assert(stream != nullptr);
+    assert(m_set != nullptr);
+
+    size_t n_pixels = m_set->width * m_set->height;
+    double resampled = (n_pixels > 0) ? 100.0 * (double)(m_set->n_samples / kSamples) / (double)n_pixels : 0.0;
+    double per_pixel = (n_pixels > 0) ? (double)m_set->n_samples / (double)n_pixels : 0.0;
+
+    fprintf(stream, "# antialias: %.1f%% pixels resampled, %zu extra samples, %.2f per pixel\n",
+            resampled, m_set->n_samples, per_pixel);
+}
+
+// static ---------------------------------------------------------------------
+
+// with smoothing neighbour bands blend into each other, only a jump of more than one count is an edge;
+// a pixel on the frame border is compared with the neighbours it has
+static bool IsEdge(const Mandelbrot::MSet* m_set, int32_t x, int32_t y) {
+    assert(m_set != nullptr);
+
+    int32_t width  = (int32_t)m_set->width;
+    int32_t height = (int32_t)m_set->height;
+
+    uint32_t tolerance = (m_set->palette.smooth && m_set->keep_magnitudes) ? 1 : 0;
+    uint32_t interior  = (uint32_t)m_set->max_iter + 1;
+
+    const uint32_t* counts = m_set->iter_counts;
+    uint32_t count = counts[(size_t)y * m_set->width + (size_t)x];
+
+    const Mandelbrot::Point neighbours[] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+    for (const Mandelbrot::Point& neighbour : neighbours) {
+        if (neighbour.x < 0 || neighbour.x >= width || neighbour.y < 0 || neighbour.y >= height) {
+            continue;
+        }
+
+        uint32_t other = counts[(size_t)neighbour.y * m_set->width + (size_t)neighbour.x];
+        if ((count == interior) != (other == interior)) {
+            return true;
+        }
+
+        uint32_t difference = (count > other) ? count - other : other - count;
+        if (difference > tolerance) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// one point in every cell of the grid over the pixel [-0.5, 0.5)^2, the pixel itself is at 0;
+// the jitter is a fixed hash of the sample number, so all pixels and frames share the pattern
+static void SampleOffset(size_t sample, double* sample_x, double* sample_y) {
+    assert(sample < kSamples);
+    assert(sample_x != nullptr);
+    assert(sample_y != nullptr);
+
+    uint32_t hash = (uint32_t)(sample + 1) * 0x9E3779B9u;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+
+    double jitter_x = (double)(hash & 0xFFFF) / 65536.0;
+    double jitter_y = (double)(hash >> 16) / 65536.0;
+
+    *sample_x = ((double)(sample % kAntialiasGrid) + jitter_x) / (double)kAntialiasGrid - 0.5;
+    *sample_y = ((double)(sample / kAntialiasGrid) + jitter_y) / (double)kAntialiasGrid - 0.5;
+}
+
+// every sample is a frame of its own with the same view and the point moved inside the pixel
+static void FlushBatch(EdgeBatch* batch) {
+    assert(batch != nullptr);
+
+    if (batch->n_points == 0) {
+        return;
+    }
+
+    const Mandelbrot::Frame& frame = *batch->frame;
+    Mandelbrot::MSet* m_set = frame.m_set;
+
+    Mandelbrot::Frame sample = {};
+    sample.m_set     = m_set;
+    sample.view      = frame.view;
+    sample.precision = frame.precision;
+    sample.orbit_x   = frame.orbit_x;
+    sample.orbit_y   = frame.orbit_y;
+    sample.orbit_len = frame.orbit_len;
+
+    uint32_t iter_count[kBatchSize] = {};
+    float magnitude[kBatchSize] = {};
+    uint32_t colors[kBatchSize] = {};
+
+    for (size_t i = 0; i < kSamples; i++) {
+        SampleOffset(i, &sample.sample_x, &sample.sample_y);
+
+        batch->kernel(sample, batch->points, batch->n_points, iter_count, magnitude);
+        m_set->kernels->colorize_points(m_set, iter_count, magnitude, batch->n_points, colors);
+
+        for (size_t j = 0; j < batch->n_points; j++) {
+            const uint8_t* rgba = (const uint8_t*)&colors[j];
+            for (size_t c = 0; c < 4; c++) {
+                batch->sums[j][c] += rgba[c];
+            }
+        }
+    }
+
+    uint32_t* pixels = (uint32_t*)(void*)m_set->pixels;
+    for (size_t j = 0; j < batch->n_points; j++) {
+        uint8_t rgba[4] = {};
+        for (size_t c = 0; c < 4; c++) {
+            rgba[c] = (uint8_t)((batch->sums[j][c] + kSamples / 2) / kSamples);
+            batch->sums[j][c] = 0;
+        }
+
+        const Mandelbrot::Point& point = batch->points[j];
+        memcpy(&pixels[(size_t)point.y * m_set->width + (size_t)point.x], rgba, sizeof(rgba));
+    }
+
+    batch->n_samples += batch->n_points * kSamples;
+    batch->n_points = 0;
+}
@@ -1,6 +1,362 @@
 #include "bench.h"
 #include <x86intrin.h>
 
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+
+// static ---------------------------------------------------------------------
+
+static const size_t kScalingRuns = 7;
+static const double kPanPixels = 10.0;
+
+static uint64_t MeasureFrame(Mandelbrot::MSet* m_set);
+static uint64_t MeasureRecolor(Mandelbrot::MSet* m_set);
+static size_t CountDifferentPixels(const sf::Uint8* a, const sf::Uint8* b, size_t n_bytes);
+static double MeanDifference(const sf::Uint8* a, const sf::Uint8* b, size_t n_bytes);
+
+// global ---------------------------------------------------------------------
+
 uint64_t GetTime() {
     return __rdtsc();
-}
\ No newline at end of file
+}
+
+void ReportThreadScaling(Mandelbrot::MSet* m_set, size_t max_threads) {
+    assert(m_set != nullptr);
+
+    if (max_threads == 0) {
+        max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    fprintf(stdout, "%8s %16s %8s %10s\n", "threads", "ticks", "speedup", "efficiency");
+
+    uint64_t base_time = 0;
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads++) {
+        if (Mandelbrot::SetThreadCount(m_set, n_threads) != Mandelbrot::Error::kOk) {
+            fprintf(stderr, "# Error: bad alloc\n");
+            return;
+        }
+
+        uint64_t time = MeasureFrame(m_set);
+        if (n_threads == 1) {
+            base_time = time;
+        }
+
+        double speedup = (double)base_time / (double)time;
+        fprintf(stdout, "%8zu %16lu %8.2f %9.0f%%\n", 
+                n_threads, time, speedup, 100.0 * speedup / (double)n_threads);
+    }
+}
+
+void ReportPrecisionThroughput(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    using Mandelbrot::Precision;
+
+    Precision requested = m_set->precision;
+    const Precision paths[] = {Precision::kFloat, Precision::kDouble, Precision::kPerturbation};
+
+    size_t n_pixels = m_set->width * m_set->height;
+
+    m_set->precision = Precision::kAuto;
+    Mandelbrot::Viewport view = Mandelbrot::GetViewport(m_set);
+    fprintf(stdout, "auto precision picks %s at step %g\n",
+            Mandelbrot::PrecisionName(Mandelbrot::ChoosePrecision(m_set, view)), view.step);
+
+    fprintf(stdout, "%14s %16s %14s\n", "path", "ticks", "ticks/pixel");
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        m_set->precision = paths[i];
+        uint64_t time = MeasureFrame(m_set);
+
+        fprintf(stdout, "%14s %16lu %14.2f\n", 
+                Mandelbrot::PrecisionName(paths[i]), time, (double)time / (double)n_pixels);
+    }
+
+    m_set->precision = requested;
+}
+
+void ReportInteriorChecks(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    bool requested = m_set->interior_checks;
+
+    sf::Uint8* reference = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+    if (reference == nullptr) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        return;
+    }
+
+    m_set->interior_checks = false;
+    uint64_t plain_time = MeasureFrame(m_set);
+    memcpy(reference, m_set->pixels, m_set->n_pixels);
+
+    m_set->interior_checks = true;
+    uint64_t checked_time = MeasureFrame(m_set);
+
+    size_t n_different = CountDifferentPixels(reference, m_set->pixels, m_set->n_pixels);
+
+    fprintf(stdout, "%16s %16s %8s %10s\n", "plain ticks", "checked ticks", "speedup", "different");
+    fprintf(stdout, "%16lu %16lu %8.2f %10zu\n", plain_time, checked_time,
+            (double)plain_time / (double)checked_time, n_different);
+
+    free(reference);
+    m_set->interior_checks = requested;
+}
+
+void ReportSubdivision(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    bool requested = m_set->subdivide;
+
+    sf::Uint8* reference = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+    if (reference == nullptr) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        return;
+    }
+
+    m_set->subdivide = false;
+    uint64_t full_time = MeasureFrame(m_set);
+    memcpy(reference, m_set->pixels, m_set->n_pixels);
+
+    m_set->subdivide = true;
+    uint64_t subdivided_time = MeasureFrame(m_set);
+
+    size_t n_different = CountDifferentPixels(reference, m_set->pixels, m_set->n_pixels);
+    double iterated = (double)m_set->n_iterated / (double)(m_set->width * m_set->height);
+
+    fprintf(stdout, "%16s %16s %8s %9s %10s\n", "full ticks", "subdivided ticks", "speedup", "iterated", "different");
+    fprintf(stdout, "%16lu %16lu %8.2f %8.1f%% %10zu\n", full_time, subdivided_time,
+            (double)full_time / (double)subdivided_time, 100.0 * iterated, n_different);
+
+    free(reference);
+    m_set->subdivide = requested;
+}
+
+void ReportPanLatency(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    sf::Uint8* panned = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+    if (panned == nullptr) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        return;
+    }
+
+    double start_x = m_set->move_x;
+    uint64_t full_time = MeasureFrame(m_set);
+
+    // back and forth, so every pan after the first shifts a frame made by a pan
+    uint64_t times[kScalingRuns] = {};
+    for (size_t i = 0; i < kScalingRuns; i++) {
+        m_set->move_x += ((i % 2 == 0) ? kPanPixels : -kPanPixels) * m_set->scale;
+
+        uint64_t start_time = GetTime();
+        Mandelbrot::Compute(m_set);
+        times[i] = GetTime() - start_time;
+    }
+
+    std::sort(times, times + kScalingRuns);
+    uint64_t pan_time = times[kScalingRuns / 2];
+
+    double iterated = (double)m_set->n_iterated / (double)(m_set->width * m_set->height);
+    memcpy(panned, m_set->pixels, m_set->n_pixels);
+
+    Mandelbrot::Invalidate(m_set);
+    Mandelbrot::Compute(m_set);
+    size_t n_different = CountDifferentPixels(panned, m_set->pixels, m_set->n_pixels);
+
+    fprintf(stdout, "%16s %16s %8s %9s %10s\n", "full ticks", "pan ticks", "speedup", "iterated", "different");
+    fprintf(stdout, "%16lu %16lu %8.2f %8.1f%% %10zu\n", full_time, pan_time,
+            (double)full_time / (double)pan_time, 100.0 * iterated, n_different);
+
+    free(panned);
+    m_set->move_x = start_x;
+}
+
+void ReportProgressive(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    bool requested = m_set->progressive;
+
+    sf::Uint8* reference = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+    if (reference == nullptr) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        return;
+    }
+
+    m_set->progressive = false;
+    uint64_t full_time = MeasureFrame(m_set);
+    memcpy(reference, m_set->pixels, m_set->n_pixels);
+
+    m_set->progressive = true;
+    uint64_t first_time = MeasureFrame(m_set);
+
+    uint64_t slowest_time = 0;
+    uint64_t total_time = first_time;
+    size_t n_calls = 1;
+
+    while (m_set->pass_step > 1) {
+        uint64_t start_time = GetTime();
+        Mandelbrot::Compute(m_set);
+        uint64_t time = GetTime() - start_time;
+
+        slowest_time = std::max(slowest_time, time);
+        total_time += time;
+        n_calls++;
+    }
+
+    size_t n_different = CountDifferentPixels(reference, m_set->pixels, m_set->n_pixels);
+
+    fprintf(stdout, "%16s %16s %16s %6s %16s %10s\n", 
+            "full ticks", "first call", "slowest call", "calls", "total ticks", "different");
+    fprintf(stdout, "%16lu %16lu %16lu %6zu %16lu %10zu\n", 
+            full_time, first_time, slowest_time, n_calls, total_time, n_different);
+
+    free(reference);
+    m_set->progressive = requested;
+}
+
+void ReportColorize(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    bool requested_keep   = m_set->keep_magnitudes;
+    bool requested_smooth = m_set->palette.smooth;
+
+    double n_pixels = (double)(m_set->width * m_set->height);
+
+    // smoothing needs |z|^2 of the frame
+    m_set->keep_magnitudes = true;
+    m_set->palette.smooth  = false;
+    uint64_t frame_time = MeasureFrame(m_set);
+
+    uint64_t counts_time = MeasureRecolor(m_set);
+
+    m_set->palette.smooth = true;
+    uint64_t smooth_time = MeasureRecolor(m_set);
+
+    fprintf(stdout, "%14s %16s %14s\n", "pass", "ticks", "ticks/pixel");
+    fprintf(stdout, "%14s %16lu %14.2f\n", "frame", frame_time, (double)frame_time / n_pixels);
+    fprintf(stdout, "%14s %16lu %14.2f\n", "recolor", counts_time, (double)counts_time / n_pixels);
+    fprintf(stdout, "%14s %16lu %14.2f\n", "recolor smooth", smooth_time, (double)smooth_time / n_pixels);
+
+    m_set->keep_magnitudes = requested_keep;
+    m_set->palette.smooth  = requested_smooth;
+    Mandelbrot::Invalidate(m_set);
+}
+
+void ReportAntialias(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    using Mandelbrot::Antialias;
+
+    Antialias requested = m_set->antialias;
+    double n_pixels = (double)(m_set->width * m_set->height);
+
+    sf::Uint8* plain = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+    sf::Uint8* edges = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+    if (plain == nullptr || edges == nullptr) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        free(plain);
+        free(edges);
+        return;
+    }
+
+    m_set->antialias = Antialias::kOff;
+    uint64_t plain_time = MeasureFrame(m_set);
+    memcpy(plain, m_set->pixels, m_set->n_pixels);
+
+    m_set->antialias = Antialias::kEdges;
+    uint64_t edges_time = MeasureFrame(m_set);
+    size_t edges_samples = m_set->n_samples;
+    memcpy(edges, m_set->pixels, m_set->n_pixels);
+
+    // full supersampling is the reference, pixels stay in m_set->pixels
+    m_set->antialias = Antialias::kFull;
+    uint64_t full_time = MeasureFrame(m_set);
+    size_t full_samples = m_set->n_samples;
+
+    fprintf(stdout, "%8s %16s %8s %14s %12s %10s\n", "mode", "ticks", "cost", "samples/pixel", "error", "different");
+    fprintf(stdout, "%8s %16lu %7.2fx %14.2f %12.3f %10zu\n", "off", plain_time, 1.0, 1.0,
+            MeanDifference(plain, m_set->pixels, m_set->n_pixels),
+            CountDifferentPixels(plain, m_set->pixels, m_set->n_pixels));
+    fprintf(stdout, "%8s %16lu %7.2fx %14.2f %12.3f %10zu\n", "edges", edges_time,
+            (double)edges_time / (double)plain_time, 1.0 + (double)edges_samples / n_pixels,
+            MeanDifference(edges, m_set->pixels, m_set->n_pixels),
+            CountDifferentPixels(edges, m_set->pixels, m_set->n_pixels));
+    fprintf(stdout, "%8s %16lu %7.2fx %14.2f %12.3f %10d\n", "full", full_time,
+            (double)full_time / (double)plain_time, 1.0 + (double)full_samples / n_pixels, 0.0, 0);
+
+    free(plain);
+    free(edges);
+
+    m_set->antialias = requested;
+    Mandelbrot::Invalidate(m_set);
+}
+
+// static ---------------------------------------------------------------------
+
+// median of several runs, first run warms up caches and wakes the workers,
+// every run draws the whole frame instead of reusing the previous one
+static uint64_t MeasureFrame(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    uint64_t times[kScalingRuns] = {};
+
+    Mandelbrot::Invalidate(m_set);
+    Mandelbrot::Compute(m_set);
+    for (size_t i = 0; i < kScalingRuns; i++) {
+        Mandelbrot::Invalidate(m_set);
+
+        uint64_t start_time = GetTime();
+        Mandelbrot::Compute(m_set);
+        times[i] = GetTime() - start_time;
+    }
+
+    std::sort(times, times + kScalingRuns);
+
+    return times[kScalingRuns / 2];
+}
+
+// same for coloring the counts of the last frame again
+static uint64_t MeasureRecolor(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
+
+    uint64_t times[kScalingRuns] = {};
+
+    Mandelbrot::Recolor(m_set);
+    for (size_t i = 0; i < kScalingRuns; i++) {
+        uint64_t start_time = GetTime();
+        Mandelbrot::Recolor(m_set);
+        times[i] = GetTime() - start_time;
+    }
+
+    std::sort(times, times + kScalingRuns);
+
+    return times[kScalingRuns / 2];
+}
+
+static size_t CountDifferentPixels(const sf::Uint8* a, const sf::Uint8* b, size_t n_bytes) {
+    assert(a != nullptr);
+    assert(b != nullptr);
+
+    size_t n_different = 0;
+    for (size_t i = 0; i < n_bytes; i += 4) {
+        n_different += (memcmp(a + i, b + i, 4) != 0);
+    }
+
+    return n_different;
+}
+
+// mean over all rgb bytes of |a - b|, alpha is always opaque
+static double MeanDifference(const sf::Uint8* a, const sf::Uint8* b, size_t n_bytes) {
+    assert(a != nullptr);
+    assert(b != nullptr);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < n_bytes; i += 4) {
+        for (size_t c = 0; c < 3; c++) {
+            total += (uint64_t)abs((int)a[i + c] - (int)b[i + c]);
+        }
+    }
+
+    return (n_bytes > 0) ? (double)total / (double)(n_bytes / 4 * 3) : 0.0;
+}
@@ -0,0 +1,963 @@
+#include "cluster.h"
+#include "kernels.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// static ---------------------------------------------------------------------
+
+static_assert(kClusterTileWidth % 16 == 0, "cluster tile width has to be a multiple of the widest simd group (16)");
+
+static const char   kUnixPrefix[] = "unix:";
+static const size_t kMaxHostLen   = 256;
+static const size_t kMaxWorkers   = 64;
+
+static const uint32_t kHelloMagic      = 0x4B57534Du; // "MSWK"
+static const uint32_t kRequestMagic    = 0x5152534Du; // "MSRQ"
+static const uint32_t kResultMagic     = 0x5352534Du; // "MSRS"
+static const uint32_t kRefusedMagic    = 0x4652534Du; // "MSRF"
+static const uint32_t kProtocolVersion = 3;
+
+// a count is at most a 5 byte varint of the run and one of the delta, |z|^2 is 4 bytes
+static const size_t kMaxBytesPerPixel = 14;
+
+static const unsigned int kConnectRetryMs = 100;
+static const int          kPollMs         = 1000;
+
+// messages are plain structs in host byte order, so workers have to be the same build on the same
+// kind of machine; the hello carries the sizes, which catches most mismatches
+struct HelloMessage {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t request_size;
+    uint32_t result_size;
+    char kernels[16]; // widest table of the worker, the coordinator only reports it
+};
+
+// everything that changes the pixels of the tile, the same fields a local Compute reads from MSet;
+// fma and plain tables round differently, so every worker computes with the table of the coordinator
+struct TileRequest {
+    uint32_t magic;
+    uint32_t frame; // serial number of the ComputeOnCluster call
+    uint32_t tile;
+    uint32_t precision;
+
+    HpReal deep_x;
+    HpReal deep_y;
+    double move_x;
+    double move_y;
+    double scale;
+    double escape_radius;
+    double julia_x;
+    double julia_y;
+
+    uint64_t width;
+    uint64_t height;
+    uint64_t max_iter;
+    uint32_t interior_checks;
+    uint32_t keep_magnitudes;
+    uint32_t formula;
+    char kernels[16]; // KernelTable::name, a worker whose cpu lacks it refuses the tile
+
+    int32_t x_begin;
+    int32_t y_begin;
+    int32_t x_end;
+    int32_t y_end;
+};
+
+// followed by count_bytes of runs of counts: varint run length, varint zigzag difference to the count
+// before, then magnitude_bytes of |z|^2 of escaped pixels in order (interior ones are 0), none without keep_magnitudes;
+// kRefusedMagic and nothing after it for a request the worker can not compute, every worker would refuse it too
+struct TileResult {
+    uint32_t magic;
+    uint32_t frame;
+    uint32_t tile;
+    uint32_t count_bytes;
+    uint32_t magnitude_bytes;
+};
+
+enum class TileState : uint8_t {
+    kPending = 0,
+    kRunning = 1,
+    kDone    = 2,
+};
+
+struct WorkerLink {
+    int fd;
+    long tile; // running on it, -1 when idle
+    std::chrono::steady_clock::time_point deadline; // of the tile, or of the hello until it came
+    size_t n_tiles;
+    size_t id;
+
+    // the hello is read as it arrives, a link gets tiles only once all of it came and matched
+    bool greeted;
+    size_t hello_bytes;
+    HelloMessage hello;
+};
+
+struct Cluster {
+    int listen_fd;
+    char unix_path[sizeof(sockaddr_un::sun_path)]; // unlinked again by DestroyCluster, empty for tcp
+
+    WorkerLink workers[kMaxWorkers];
+    size_t n_workers;
+
+    uint32_t frame;
+    uint8_t* buffer; // payload of the result being received
+    size_t buffer_size;
+
+    size_t n_tiles;
+    size_t n_joined;
+    size_t n_lost;
+    size_t n_retries;
+    uint64_t raw_bytes;  // counts and |z|^2 as they are in memory
+    uint64_t wire_bytes; // what came over the links for them
+};
+
+// tiles of one frame and what happened to them
+struct TileBoard {
+    TileState* states;
+    uint8_t* failures;
+    size_t n_tiles;
+    size_t tiles_x;
+    size_t first_pending; // no pending tile before it
+    size_t n_done;
+    bool gave_up; // a tile lost kClusterRetries workers or one refused it
+};
+
+static int OpenSocket(const char* address, bool listening);
+static int ConnectWorker(const char* address);
+static void SetTimeout(int fd, unsigned int timeout_ms);
+static bool SendAll(int fd, const void* data, size_t size);
+static bool ReceiveAll(int fd, void* data, size_t size);
+static bool GrowBuffer(uint8_t** buffer, size_t* size, size_t needed);
+
+static void AcceptWorker(Cluster* cluster);
+static bool ReceiveHello(Cluster* cluster, WorkerLink* worker);
+static void DropWorker(Cluster* cluster, TileBoard* board, WorkerLink* worker, const char* reason);
+static void ForgetDropped(Cluster* cluster);
+static bool SendTile(Cluster* cluster, const Mandelbrot::MSet* m_set, TileBoard* board, WorkerLink* worker);
+static bool ReceiveTile(Cluster* cluster, Mandelbrot::MSet* m_set, TileBoard* board, WorkerLink* worker);
+static Mandelbrot::Tile BoardTile(const TileBoard& board, const Mandelbrot::MSet* m_set, size_t tile);
+
+static size_t EncodeTile(const Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, uint8_t* out, size_t* count_bytes);
+static bool DecodeTile(Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, const uint8_t* data,
+                       size_t count_bytes, size_t magnitude_bytes);
+static size_t PutVarint(uint8_t* out, uint32_t value);
+static bool GetVarint(const uint8_t** data, const uint8_t* end, uint32_t* value);
+
+// global ---------------------------------------------------------------------
+
+Cluster* CreateCluster(const char* address) {
+    assert(address != nullptr);
+
+    Cluster* cluster = (Cluster*)calloc(1, sizeof(Cluster));
+    if (cluster == nullptr) {
+        return nullptr;
+    }
+
+    cluster->listen_fd = OpenSocket(address, true);
+    if (cluster->listen_fd < 0) {
+        free(cluster);
+        return nullptr;
+    }
+
+    if (strncmp(address, kUnixPrefix, sizeof(kUnixPrefix) - 1) == 0) {
+        strncpy(cluster->unix_path, address + sizeof(kUnixPrefix) - 1, sizeof(cluster->unix_path) - 1);
+    }
+
+    fprintf(stderr, "# cluster: waiting for workers on %s\n", address);
+
+    return cluster;
+}
+
+void DestroyCluster(Cluster* cluster) {
+    if (cluster == nullptr) {
+        return;
+    }
+
+    for (size_t i = 0; i < cluster->n_workers; i++) {
+        close(cluster->workers[i].fd);
+    }
+
+    close(cluster->listen_fd);
+    if (cluster->unix_path[0] != '\0') {
+        unlink(cluster->unix_path);
+    }
+
+    free(cluster->buffer);
+    free(cluster);
+}
+
+Mandelbrot::Error ComputeOnCluster(Cluster* cluster, Mandelbrot::MSet* m_set) {
+    assert(cluster != nullptr);
+    assert(m_set != nullptr);
+
+    using Clock = std::chrono::steady_clock;
+    using Mandelbrot::Error;
+
+    TileBoard board = {};
+    board.tiles_x  = (m_set->width  + kClusterTileWidth - 1) / kClusterTileWidth;
+    board.n_tiles  = board.tiles_x * ((m_set->height + kClusterTileHight - 1) / kClusterTileHight);
+    board.states   = (TileState*)calloc(board.n_tiles, sizeof(TileState));
+    board.failures = (uint8_t*)calloc(board.n_tiles, sizeof(uint8_t));
+
+    if (board.states == nullptr || board.failures == nullptr) {
+        free(board.states);
+        free(board.failures);
+        return Error::kBadAlloc;
+    }
+
+    cluster->frame++;
+
+    Error error = Error::kOk;
+    Clock::time_point alone_since = Clock::now();
+
+    while (board.n_done < board.n_tiles && !board.gave_up) {
+        bool any_worker = false;
+        for (size_t i = 0; i < cluster->n_workers; i++) {
+            WorkerLink* worker = &cluster->workers[i];
+            bool idle = worker->fd >= 0 && worker->greeted && worker->tile < 0;
+            if (idle && board.first_pending < board.n_tiles && !SendTile(cluster, m_set, &board, worker)) {
+                DropWorker(cluster, &board, worker, "send failed");
+            }
+
+            any_worker = any_worker || (worker->fd >= 0 && worker->greeted);
+        }
+
+        ForgetDropped(cluster);
+
+        // links still owing their hello do not count, they may never send one
+        if (any_worker) {
+            alone_since = Clock::now();
+        } else if (Clock::now() - alone_since > std::chrono::milliseconds(kClusterWaitMs)) {
+            fprintf(stderr, "# Error: cluster: no workers for %u ms\n", kClusterWaitMs);
+            error = Error::kBadLink;
+            break;
+        }
+
+        pollfd fds[kMaxWorkers + 1] = {};
+        fds[0] = {cluster->listen_fd, POLLIN, 0};
+        for (size_t i = 0; i < cluster->n_workers; i++) {
+            fds[i + 1] = {cluster->workers[i].fd, POLLIN, 0};
+        }
+
+        if (poll(fds, cluster->n_workers + 1, kPollMs) < 0 && errno != EINTR) {
+            error = Error::kBadLink;
+            break;
+        }
+
+        for (size_t i = 0; i < cluster->n_workers; i++) {
+            WorkerLink* worker = &cluster->workers[i];
+            bool ready = (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+
+            // checked even when bytes keep coming, a link can send its hello one byte a second
+            if (!worker->greeted) {
+                if (ready && !ReceiveHello(cluster, worker)) {
+                    DropWorker(cluster, &board, worker, "not a worker of this build");
+                } else if (!worker->greeted && Clock::now() > worker->deadline) {
+                    DropWorker(cluster, &board, worker, "no hello in time");
+                }
+            } else if (ready) {
+                if (!ReceiveTile(cluster, m_set, &board, worker)) {
+                    DropWorker(cluster, &board, worker, "link lost");
+                }
+            } else if (worker->tile >= 0 && Clock::now() > worker->deadline) {
+                DropWorker(cluster, &board, worker, "tile timed out");
+            }
+        }
+
+        if ((fds[0].revents & POLLIN) != 0 && cluster->n_workers < kMaxWorkers) {
+            AcceptWorker(cluster);
+        }
+    }
+
+    ForgetDropped(cluster);
+
+    free(board.states);
+    free(board.failures);
+
+    if (board.gave_up) {
+        error = Error::kBadLink;
+    }
+    if (error != Error::kOk) {
+        return error;
+    }
+
+    // counts came from outside Compute, the palette pass is the same
+    Mandelbrot::Invalidate(m_set);
+    Mandelbrot::Recolor(m_set);
+
+    m_set->used_precision = Mandelbrot::ChoosePrecision(m_set, Mandelbrot::GetViewport(m_set));
+    m_set->n_iterated = m_set->width * m_set->height;
+    m_set->n_samples  = 0;
+    m_set->stats      = {};
+
+    return Error::kOk;
+}
+
+void PrintCluster(FILE* stream, const Cluster* cluster) {
+    assert(stream != nullptr);
+    assert(cluster != nullptr);
+
+    double ratio = (cluster->wire_bytes > 0) ? (double)cluster->raw_bytes / (double)cluster->wire_bytes : 0.0;
+
+    fprintf(stream, "# cluster: %zu tiles from %zu workers, %zu lost, %zu tiles retried, "
+                    "%.1f MiB of counts sent as %.1f MiB (%.1fx)\n",
+            cluster->n_tiles, cluster->n_joined, cluster->n_lost, cluster->n_retries,
+            (double)cluster->raw_bytes / (1 << 20), (double)cluster->wire_bytes / (1 << 20), ratio);
+}
+
+Mandelbrot::Error RunWorker(Mandelbrot::MSet* m_set, const char* address) {
+    assert(m_set != nullptr);
+    assert(address != nullptr);
+
+    using Mandelbrot::Error;
+
+    int fd = ConnectWorker(address);
+    if (fd < 0) {
+        fprintf(stderr, "# Error: worker: can not connect to %s\n", address);
+        return Error::kBadLink;
+    }
+
+    HelloMessage hello = {kHelloMagic, kProtocolVersion, sizeof(TileRequest), sizeof(TileResult), {}};
+    strncpy(hello.kernels, m_set->kernels->name, sizeof(hello.kernels) - 1);
+
+    uint8_t* buffer = nullptr;
+    size_t buffer_size = 0;
+    size_t n_tiles = 0;
+
+    Error error = SendAll(fd, &hello, sizeof(hello)) ? Error::kOk : Error::kBadLink;
+
+    // the coordinator closing the link is the normal end
+    TileRequest request = {};
+    while (error == Error::kOk && ReceiveAll(fd, &request, sizeof(request))) {
+        if (request.magic != kRequestMagic) {
+            fprintf(stderr, "# Error: worker: bad request\n");
+            error = Error::kBadLink;
+            break;
+        }
+
+        Mandelbrot::Tile tile = {request.x_begin, request.y_begin, request.x_end, request.y_end};
+
+        request.kernels[sizeof(request.kernels) - 1] = '\0';
+        const Mandelbrot::KernelTable* kernels = Mandelbrot::FindKernels(request.kernels);
+
+        // the same limits as ParseJob, the refusal fails the job instead of sending the tile to the next worker
+        bool valid = request.width <= INT32_MAX && request.height <= INT32_MAX
+                     && request.max_iter <= Mandelbrot::kMaxIterLimit
+                     && request.precision <= (uint32_t)Mandelbrot::Precision::kPerturbation
+                     && request.formula <= (uint32_t)Mandelbrot::Formula::kBurningShip
+                     && tile.x_begin >= 0 && tile.x_begin % 16 == 0 && tile.y_begin >= 0
+                     && tile.x_begin < tile.x_end && tile.y_begin < tile.y_end
+                     && (uint64_t)tile.x_end <= request.width && (uint64_t)tile.y_end <= request.height;
+        if (!valid) {
+            fprintf(stderr, "# Error: worker: refused tile %u of a request out of range\n", request.tile);
+        } else if (kernels == nullptr) {
+            fprintf(stderr, "# Error: worker: refused tile %u, this cpu can not run %s kernels\n",
+                    request.tile, request.kernels);
+        }
+
+        if (!valid || kernels == nullptr) {
+            TileResult refused = {kRefusedMagic, request.frame, request.tile, 0, 0};
+            error = SendAll(fd, &refused, sizeof(refused)) ? Error::kOk : Error::kBadLink;
+            continue;
+        }
+
+        if (m_set->width != request.width || m_set->height != request.height) {
+            error = Mandelbrot::Resize(m_set, request.width, request.height);
+            if (error != Error::kOk) {
+                break;
+            }
+        }
+
+        m_set->deep_x          = request.deep_x;
+        m_set->deep_y          = request.deep_y;
+        m_set->move_x          = request.move_x;
+        m_set->move_y          = request.move_y;
+        m_set->scale           = request.scale;
+        m_set->escape_radius   = request.escape_radius;
+        m_set->formula         = (Mandelbrot::Formula)request.formula;
+        m_set->julia_x         = request.julia_x;
+        m_set->julia_y         = request.julia_y;
+        m_set->max_iter        = request.max_iter;
+        m_set->precision       = (Mandelbrot::Precision)request.precision;
+        m_set->interior_checks = request.interior_checks != 0;
+        m_set->keep_magnitudes = request.keep_magnitudes != 0;
+        m_set->kernels         = kernels;
+
+        size_t width  = (size_t)(tile.x_end - tile.x_begin);
+        size_t height = (size_t)(tile.y_end - tile.y_begin);
+        Mandelbrot::ComputeRect(m_set, (size_t)tile.x_begin, (size_t)tile.y_begin, width, height);
+
+        if (!GrowBuffer(&buffer, &buffer_size, width * height * kMaxBytesPerPixel)) {
+            error = Error::kBadAlloc;
+            break;
+        }
+
+        size_t count_bytes = 0;
+        size_t n_bytes = EncodeTile(m_set, tile, buffer, &count_bytes);
+
+        TileResult result = {kResultMagic, request.frame, request.tile, (uint32_t)count_bytes,
+                             (uint32_t)(n_bytes - count_bytes)};
+        if (!SendAll(fd, &result, sizeof(result)) || !SendAll(fd, buffer, n_bytes)) {
+            error = Error::kBadLink;
+        }
+
+        n_tiles++;
+    }
+
+    fprintf(stderr, "# worker: %zu tiles\n", n_tiles);
+
+    free(buffer);
+    close(fd);
+
+    return error;
+}
+
+// static ---------------------------------------------------------------------
+
+// "unix:/path" or "host:port", an empty host is every interface to listen on and localhost to connect to
+static int OpenSocket(const char* address, bool listening) {
+    assert(address != nullptr);
+
+    if (strncmp(address, kUnixPrefix, sizeof(kUnixPrefix) - 1) == 0) {
+        const char* path = address + sizeof(kUnixPrefix) - 1;
+
+        sockaddr_un unix_address = {};
+        unix_address.sun_family = AF_UNIX;
+        if (path[0] == '\0' || strlen(path) >= sizeof(unix_address.sun_path)) {
+            return -1;
+        }
+        strcpy(unix_address.sun_path, path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+
+        int status = 0;
+        if (listening) {
+            // a socket file left by a coordinator which did not exit cleanly
+            unlink(path);
+            status = bind(fd, (const sockaddr*)&unix_address, sizeof(unix_address));
+            status = (status == 0) ? listen(fd, (int)kMaxWorkers) : status;
+        } else {
+            status = connect(fd, (const sockaddr*)&unix_address, sizeof(unix_address));
+        }
+
+        if (status != 0) {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    const char* colon = strrchr(address, ':');
+    if (colon == nullptr || (size_t)(colon - address) >= kMaxHostLen) {
+        return -1;
+    }
+
+    char host[kMaxHostLen] = {};
+    memcpy(host, address, (size_t)(colon - address));
+
+    addrinfo hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = listening ? AI_PASSIVE : 0;
+
+    addrinfo* infos = nullptr;
+    if (getaddrinfo((host[0] != '\0') ? host : nullptr, colon + 1, &hints, &infos) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* info = infos; info != nullptr && fd < 0; info = info->ai_next) {
+        fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        int one = 1;
+        int status = 0;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            status = bind(fd, info->ai_addr, info->ai_addrlen);
+            status = (status == 0) ? listen(fd, (int)kMaxWorkers) : status;
+        } else {
+            // requests are small, waiting to batch them only delays the tile
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            status = connect(fd, info->ai_addr, info->ai_addrlen);
+        }
+
+        if (status != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(infos);
+
+    return fd;
+}
+
+static int ConnectWorker(const char* address) {
+    assert(address != nullptr);
+
+    for (unsigned int waited = 0; waited < kClusterConnectMs; waited += kConnectRetryMs) {
+        int fd = OpenSocket(address, false);
+        if (fd >= 0) {
+            return fd;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(kConnectRetryMs));
+    }
+
+    return -1;
+}
+
+static void SetTimeout(int fd, unsigned int timeout_ms) {
+    timeval timeout = {};
+    timeout.tv_sec  = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// MSG_NOSIGNAL: a dead peer is an error to handle, not SIGPIPE
+static bool SendAll(int fd, const void* data, size_t size) {
+    assert(data != nullptr || size == 0);
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+
+        bytes += sent;
+        size  -= (size_t)sent;
+    }
+
+    return true;
+}
+
+static bool ReceiveAll(int fd, void* data, size_t size) {
+    assert(data != nullptr || size == 0);
+
+    uint8_t* bytes = (uint8_t*)data;
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+
+        bytes += received;
+        size  -= (size_t)received;
+    }
+
+    return true;
+}
+
+static bool GrowBuffer(uint8_t** buffer, size_t* size, size_t needed) {
+    assert(buffer != nullptr);
+    assert(size != nullptr);
+
+    if (needed <= *size) {
+        return true;
+    }
+
+    uint8_t* grown = (uint8_t*)realloc(*buffer, needed);
+    if (grown == nullptr) {
+        return false;
+    }
+
+    *buffer = grown;
+    *size   = needed;
+
+    return true;
+}
+
+// does not wait for the hello, the link goes to the poll set and has kClusterHelloMs to send it
+static void AcceptWorker(Cluster* cluster) {
+    assert(cluster != nullptr);
+
+    int fd = accept4(cluster->listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    // results are read blocking once they start coming
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    SetTimeout(fd, kClusterTimeoutMs);
+
+    WorkerLink* worker = &cluster->workers[cluster->n_workers++];
+    *worker = {};
+    worker->fd       = fd;
+    worker->tile     = -1;
+    worker->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kClusterHelloMs);
+}
+
+// takes what came of the hello without blocking, false if the link closed or the hello does not match
+static bool ReceiveHello(Cluster* cluster, WorkerLink* worker) {
+    assert(cluster != nullptr);
+    assert(worker != nullptr);
+    assert(!worker->greeted);
+
+    uint8_t* hello_end = (uint8_t*)&worker->hello + worker->hello_bytes;
+    ssize_t received = recv(worker->fd, hello_end, sizeof(HelloMessage) - worker->hello_bytes, MSG_DONTWAIT);
+    if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    if (received <= 0) {
+        return false;
+    }
+
+    worker->hello_bytes += (size_t)received;
+    if (worker->hello_bytes < sizeof(HelloMessage)) {
+        return true;
+    }
+
+    HelloMessage* hello = &worker->hello;
+    if (hello->magic != kHelloMagic || hello->version != kProtocolVersion
+        || hello->request_size != sizeof(TileRequest) || hello->result_size != sizeof(TileResult)) {
+        return false;
+    }
+
+    hello->kernels[sizeof(hello->kernels) - 1] = '\0';
+
+    worker->greeted = true;
+    worker->id      = cluster->n_joined++;
+
+    fprintf(stderr, "# cluster: worker %zu joined, %s kernels\n", worker->id, hello->kernels);
+
+    return true;
+}
+
+// its tile goes back to the board, the link is removed from the list by the loop of ComputeOnCluster
+static void DropWorker(Cluster* cluster, TileBoard* board, WorkerLink* worker, const char* reason) {
+    assert(cluster != nullptr);
+    assert(board != nullptr);
+    assert(worker != nullptr);
+    assert(reason != nullptr);
+
+    if (worker->fd < 0) {
+        return;
+    }
+
+    // a link without its hello never was a worker
+    if (!worker->greeted) {
+        fprintf(stderr, "# cluster: refused a link: %s\n", reason);
+        close(worker->fd);
+        worker->fd = -1;
+        return;
+    }
+
+    fprintf(stderr, "# cluster: worker %zu dropped after %zu tiles: %s\n", worker->id, worker->n_tiles, reason);
+
+    if (worker->tile >= 0) {
+        size_t tile = (size_t)worker->tile;
+        board->states[tile] = TileState::kPending;
+        board->first_pending = std::min(board->first_pending, tile);
+        cluster->n_retries++;
+
+        // a tile which keeps losing its workers is the problem, not them
+        if (++board->failures[tile] >= kClusterRetries) {
+            fprintf(stderr, "# Error: cluster: tile %zu lost %u workers\n", tile, kClusterRetries);
+            board->gave_up = true;
+        }
+    }
+
+    close(worker->fd);
+    worker->fd   = -1;
+    worker->tile = -1;
+    cluster->n_lost++;
+}
+
+// links DropWorker closed leave the list, the order of the rest stays
+static void ForgetDropped(Cluster* cluster) {
+    assert(cluster != nullptr);
+
+    size_t n_links = 0;
+    for (size_t i = 0; i < cluster->n_workers; i++) {
+        if (cluster->workers[i].fd >= 0) {
+            cluster->workers[n_links++] = cluster->workers[i];
+        }
+    }
+
+    cluster->n_workers = n_links;
+}
+
+static bool SendTile(Cluster* cluster, const Mandelbrot::MSet* m_set, TileBoard* board, WorkerLink* worker) {
+    assert(cluster != nullptr);
+    assert(m_set != nullptr);
+    assert(board != nullptr);
+    assert(worker != nullptr);
+
+    while (board->first_pending < board->n_tiles && board->states[board->first_pending] != TileState::kPending) {
+        board->first_pending++;
+    }
+    if (board->first_pending == board->n_tiles) {
+        return true;
+    }
+
+    size_t index = board->first_pending;
+    Mandelbrot::Tile tile = BoardTile(*board, m_set, index);
+
+    TileRequest request = {};
+    request.magic           = kRequestMagic;
+    request.frame           = cluster->frame;
+    request.tile            = (uint32_t)index;
+    request.precision       = (uint32_t)m_set->precision;
+    request.deep_x          = m_set->deep_x;
+    request.deep_y          = m_set->deep_y;
+    request.move_x          = m_set->move_x;
+    request.move_y          = m_set->move_y;
+    request.scale           = m_set->scale;
+    request.escape_radius   = m_set->escape_radius;
+    request.julia_x         = m_set->julia_x;
+    request.julia_y         = m_set->julia_y;
+    request.width           = m_set->width;
+    request.height          = m_set->height;
+    request.max_iter        = m_set->max_iter;
+    request.interior_checks = m_set->interior_checks;
+    request.keep_magnitudes = m_set->keep_magnitudes;
+    request.formula         = (uint32_t)m_set->formula;
+    strncpy(request.kernels, m_set->kernels->name, sizeof(request.kernels) - 1);
+    request.x_begin         = tile.x_begin;
+    request.y_begin         = tile.y_begin;
+    request.x_end           = tile.x_end;
+    request.y_end           = tile.y_end;
+
+    // the tile is taken even when the send fails, DropWorker puts it back
+    board->states[index] = TileState::kRunning;
+    worker->tile     = (long)index;
+    worker->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kClusterTimeoutMs);
+
+    return SendAll(worker->fd, &request, sizeof(request));
+}
+
+// false drops the worker: it died, sent something else than its tile or the tile does not decode
+static bool ReceiveTile(Cluster* cluster, Mandelbrot::MSet* m_set, TileBoard* board, WorkerLink* worker) {
+    assert(cluster != nullptr);
+    assert(m_set != nullptr);
+    assert(board != nullptr);
+    assert(worker != nullptr);
+
+    TileResult result = {};
+    if (worker->tile < 0 || !ReceiveAll(worker->fd, &result, sizeof(result))) {
+        return false;
+    }
+
+    size_t index = (size_t)worker->tile;
+
+    // the tile stays taken, the job is over
+    if (result.magic == kRefusedMagic && result.frame == cluster->frame && result.tile == index) {
+        fprintf(stderr, "# Error: cluster: worker %zu refused tile %zu\n", worker->id, index);
+        board->gave_up = true;
+        worker->tile = -1;
+        return true;
+    }
+
+    Mandelbrot::Tile tile = BoardTile(*board, m_set, index);
+    size_t n_pixels = (size_t)(tile.x_end - tile.x_begin) * (size_t)(tile.y_end - tile.y_begin);
+
+    size_t n_bytes = (size_t)result.count_bytes + result.magnitude_bytes;
+    bool valid = result.magic == kResultMagic && result.frame == cluster->frame && result.tile == index
+                 && n_bytes <= n_pixels * kMaxBytesPerPixel;
+    if (!valid || !GrowBuffer(&cluster->buffer, &cluster->buffer_size, n_bytes)
+        || !ReceiveAll(worker->fd, cluster->buffer, n_bytes)
+        || !DecodeTile(m_set, tile, cluster->buffer, result.count_bytes, result.magnitude_bytes)) {
+        return false;
+    }
+
+    board->states[index] = TileState::kDone;
+    board->n_done++;
+
+    worker->tile = -1;
+    worker->n_tiles++;
+
+    cluster->n_tiles++;
+    cluster->raw_bytes  += n_pixels * (sizeof(uint32_t) + (m_set->keep_magnitudes ? sizeof(float) : 0));
+    cluster->wire_bytes += sizeof(result) + n_bytes;
+
+    return true;
+}
+
+static Mandelbrot::Tile BoardTile(const TileBoard& board, const Mandelbrot::MSet* m_set, size_t tile) {
+    assert(m_set != nullptr);
+    assert(tile < board.n_tiles);
+
+    Mandelbrot::Tile rect = {};
+    rect.x_begin = (int32_t)((tile % board.tiles_x) * kClusterTileWidth);
+    rect.y_begin = (int32_t)((tile / board.tiles_x) * kClusterTileHight);
+    rect.x_end   = (int32_t)std::min((size_t)rect.x_begin + kClusterTileWidth, m_set->width);
+    rect.y_end   = (int32_t)std::min((size_t)rect.y_begin + kClusterTileHight, m_set->height);
+
+    return rect;
+}
+
+// bands of one count and the interior make long runs, neighbour bands small differences
+static size_t EncodeTile(const Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, uint8_t* out, size_t* count_bytes) {
+    assert(m_set != nullptr);
+    assert(out != nullptr);
+    assert(count_bytes != nullptr);
+
+    uint8_t* next = out;
+    uint32_t previous = 0;
+    uint32_t run = 0;
+    uint32_t run_count = 0;
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        const uint32_t* counts = m_set->iter_counts + (size_t)y * m_set->width;
+
+        for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+            if (run > 0 && counts[x] == run_count) {
+                run++;
+                continue;
+            }
+
+            if (run > 0) {
+                uint32_t delta = run_count - previous;
+                next += PutVarint(next, run);
+                next += PutVarint(next, (delta << 1) ^ (uint32_t)((int32_t)delta >> 31));
+                previous = run_count;
+            }
+
+            run = 1;
+            run_count = counts[x];
+        }
+    }
+
+    uint32_t delta = run_count - previous;
+    next += PutVarint(next, run);
+    next += PutVarint(next, (delta << 1) ^ (uint32_t)((int32_t)delta >> 31));
+
+    *count_bytes = (size_t)(next - out);
+
+    if (!m_set->keep_magnitudes) {
+        return *count_bytes;
+    }
+
+    uint32_t interior = (uint32_t)m_set->max_iter + 1;
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        size_t row = (size_t)y * m_set->width;
+
+        for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+            if (m_set->iter_counts[row + (size_t)x] != interior) {
+                memcpy(next, &m_set->magnitudes[row + (size_t)x], sizeof(float));
+                next += sizeof(float);
+            }
+        }
+    }
+
+    return (size_t)(next - out);
+}
+
+static bool DecodeTile(Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, const uint8_t* data,
+                       size_t count_bytes, size_t magnitude_bytes) {
+    assert(m_set != nullptr);
+    assert(data != nullptr);
+
+    const uint8_t* next = data;
+    const uint8_t* end  = data + count_bytes;
+
+    uint32_t previous = 0;
+    uint32_t run = 0;
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        uint32_t* counts = m_set->iter_counts + (size_t)y * m_set->width;
+
+        for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+            if (run == 0) {
+                uint32_t zigzag = 0;
+                if (!GetVarint(&next, end, &run) || !GetVarint(&next, end, &zigzag) || run == 0) {
+                    return false;
+                }
+
+                previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+            }
+
+            counts[x] = previous;
+            run--;
+        }
+    }
+
+    if (run != 0 || next != end) {
+        return false;
+    }
+
+    uint32_t interior = (uint32_t)m_set->max_iter + 1;
+    const uint8_t* magnitudes = end;
+    const uint8_t* magnitudes_end = end + magnitude_bytes;
+
+    for (int32_t y = tile.y_begin; y < tile.y_end && m_set->keep_magnitudes; y++) {
+        size_t row = (size_t)y * m_set->width;
+
+        for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+            float magnitude = 0.0f;
+            if (m_set->iter_counts[row + (size_t)x] != interior) {
+                if (magnitudes + sizeof(float) > magnitudes_end) {
+                    return false;
+                }
+
+                memcpy(&magnitude, magnitudes, sizeof(float));
+                magnitudes += sizeof(float);
+            }
+
+            m_set->magnitudes[row + (size_t)x] = magnitude;
+        }
+    }
+
+    return magnitudes == magnitudes_end;
+}
+
+// 7 bits a byte, low first, the high bit says another byte follows
+static size_t PutVarint(uint8_t* out, uint32_t value) {
+    assert(out != nullptr);
+
+    size_t n_bytes = 0;
+    while (value >= 0x80) {
+        out[n_bytes++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n_bytes++] = (uint8_t)value;
+
+    return n_bytes;
+}
+
+static bool GetVarint(const uint8_t** data, const uint8_t* end, uint32_t* value) {
+    assert(data != nullptr);
+    assert(value != nullptr);
+
+    *value = 0;
+    for (unsigned int shift = 0; shift < 35 && *data < end; shift += 7) {
+        uint8_t byte = *(*data)++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -1,6 +1,6 @@
 #include "debug_simd.h"
 
-void PrintYValueFloat(__m256 value) {
+DEBUG_SIMD_TARGET void PrintYValueFloat(__m256 value) {
     float buffer[8] __attribute__((aligned(32)));
     _mm256_store_ps(buffer, value);
 
@@ -13,7 +13,7 @@ void PrintYValueFloat(__m256 value) {
     fprintf(stderr, "\n");
 }
 
-void PrintYValueDouble(__m256d value) {
+DEBUG_SIMD_TARGET void PrintYValueDouble(__m256d value) {
     double buffer[4] __attribute__((aligned(32)));
     _mm256_store_pd(buffer, value);
 
@@ -25,7 +25,7 @@ void PrintYValueDouble(__m256d value) {
 
     fprintf(stderr, "\n");
 }
-void PrintYValueInt(__m256i value) {
+DEBUG_SIMD_TARGET void PrintYValueInt(__m256i value) {
     int* ptr = (int*)&value;
     _mm256_storeu_si256((__m256i*)ptr, value);
 
@@ -0,0 +1,224 @@
+#include "engine.h"
+#include "palette.h"
+#include "stats.h"
+#include "antialias.h"
+
+#include <stdlib.h>
+
+// static ---------------------------------------------------------------------
+
+static void EngineLoop(Engine* engine);
+static bool ApplyRequest(Mandelbrot::MSet* m_set, const ViewRequest& request);
+static bool PushFrame(Engine* engine);
+
+// global ---------------------------------------------------------------------
+
+ViewRequest EmptyRequest() {
+    ViewRequest request = {};
+    request.zoom = 1.0;
+
+    return request;
+}
+
+void MergeRequest(ViewRequest* request, const ViewRequest& next) {
+    assert(request != nullptr);
+
+    if (next.reset) {
+        request->reset = true;
+        request->pan_x = 0.0;
+        request->pan_y = 0.0;
+        request->zoom  = 1.0;
+    }
+
+    // a pan is applied before the zoom of the same request, so later pans are in zoomed pixels
+    request->pan_x += next.pan_x * request->zoom;
+    request->pan_y += next.pan_y * request->zoom;
+    request->zoom  *= next.zoom;
+
+    request->palette_shift += next.palette_shift;
+    request->toggle_smooth ^= next.toggle_smooth;
+}
+
+Mandelbrot::Error StartEngine(Engine* engine, Mandelbrot::MSet* m_set) {
+    assert(engine != nullptr);
+    assert(m_set != nullptr);
+
+    engine->m_set = m_set;
+    engine->request = EmptyRequest();
+    engine->n_requests = 0;
+    engine->quit.store(false);
+    engine->queue.head.store(0);
+    engine->queue.tail.store(0);
+
+    for (size_t i = 0; i < kFrameQueueSlots; i++) {
+        engine->queue.slots[i].pixels = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
+        if (engine->queue.slots[i].pixels == nullptr) {
+            for (size_t j = 0; j < i; j++) {
+                free(engine->queue.slots[j].pixels);
+                engine->queue.slots[j].pixels = nullptr;
+            }
+            return Mandelbrot::Error::kBadAlloc;
+        }
+    }
+
+    engine->thread = std::thread(EngineLoop, engine);
+
+    return Mandelbrot::Error::kOk;
+}
+
+void StopEngine(Engine* engine) {
+    assert(engine != nullptr);
+
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        engine->quit.store(true);
+        engine->changed.notify_all();
+    }
+
+    engine->thread.join();
+
+    for (size_t i = 0; i < kFrameQueueSlots; i++) {
+        free(engine->queue.slots[i].pixels);
+        engine->queue.slots[i].pixels = nullptr;
+    }
+}
+
+void PostRequest(Engine* engine, const ViewRequest& request) {
+    assert(engine != nullptr);
+
+    std::lock_guard<std::mutex> guard(engine->lock);
+
+    MergeRequest(&engine->request, request);
+
+    engine->n_requests++;
+    engine->changed.notify_all();
+}
+
+const FrameSlot* AcquireFrame(Engine* engine) {
+    assert(engine != nullptr);
+
+    FrameQueue* queue = &engine->queue;
+
+    size_t head = queue->head.load(std::memory_order_acquire);
+    size_t tail = queue->tail.load(std::memory_order_relaxed);
+    if (head == tail) {
+        return nullptr;
+    }
+
+    // frames behind the newest one are already stale, their slots go back to the engine
+    if (head - tail > 1) {
+        queue->tail.store(head - 1, std::memory_order_release);
+    }
+
+    return &queue->slots[(head - 1) % kFrameQueueSlots];
+}
+
+void ReleaseFrame(Engine* engine) {
+    assert(engine != nullptr);
+
+    FrameQueue* queue = &engine->queue;
+    queue->tail.store(queue->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// static ---------------------------------------------------------------------
+
+static void EngineLoop(Engine* engine) {
+    assert(engine != nullptr);
+
+    Mandelbrot::MSet* m_set = engine->m_set;
+
+    size_t n_taken = 0;
+    bool idle = false;
+
+    std::unique_lock<std::mutex> guard(engine->lock);
+    while (true) {
+        // a progressive frame goes on refining until it is complete
+        engine->changed.wait(guard, [&] { return engine->quit.load() || engine->n_requests != n_taken || !idle; });
+        if (engine->quit.load()) {
+            return;
+        }
+
+        ViewRequest request = engine->request;
+        engine->request = EmptyRequest();
+        n_taken = engine->n_requests;
+
+        guard.unlock();
+
+        size_t frame_id = m_set->frame_id;
+
+        // pixels of the old view are colored again first, Compute colors only what it computes
+        if (ApplyRequest(m_set, request)) {
+            Mandelbrot::Recolor(m_set);
+        }
+        Mandelbrot::Compute(m_set);
+
+        idle = (m_set->frame_id == frame_id);
+
+#if defined(KERNEL_STATS)
+        if (m_set->n_iterated > 0) {
+            Mandelbrot::PrintStats(stderr, m_set->stats);
+        }
+#endif
+        if (m_set->n_samples > 0) {
+            Mandelbrot::PrintAntialias(stderr, m_set);
+        }
+        if (!idle && !PushFrame(engine)) {
+            return;
+        }
+
+        guard.lock();
+    }
+}
+
+// returns whether the palette changed
+static bool ApplyRequest(Mandelbrot::MSet* m_set, const ViewRequest& request) {
+    assert(m_set != nullptr);
+
+    if (request.reset) {
+        m_set->move_x = 0.0;
+        m_set->move_y = 0.0;
+        m_set->deep_x = {};
+        m_set->deep_y = {};
+        m_set->scale  = 1.0;
+    }
+
+    m_set->move_x += request.pan_x * m_set->scale;
+    m_set->move_y += request.pan_y * m_set->scale;
+    m_set->scale  *= request.zoom;
+
+    Mandelbrot::CyclePalette(&m_set->palette, (double)request.palette_shift);
+
+    // turning smoothing on the first time changes keep_magnitudes, Compute redraws then
+    if (request.toggle_smooth) {
+        m_set->palette.smooth = !m_set->palette.smooth;
+        m_set->keep_magnitudes |= m_set->palette.smooth;
+    }
+
+    return request.toggle_smooth || request.palette_shift != 0;
+}
+
+// waits for a free slot while the window draws, gives up only when the engine stops
+static bool PushFrame(Engine* engine) {
+    assert(engine != nullptr);
+
+    FrameQueue* queue = &engine->queue;
+    Mandelbrot::MSet* m_set = engine->m_set;
+
+    size_t head = queue->head.load(std::memory_order_relaxed);
+    while (head - queue->tail.load(std::memory_order_acquire) == kFrameQueueSlots) {
+        if (engine->quit.load()) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    FrameSlot* slot = &queue->slots[head % kFrameQueueSlots];
+    memcpy(slot->pixels, m_set->pixels, m_set->n_pixels);
+    slot->width    = m_set->width;
+    slot->height   = m_set->height;
+    slot->frame_id = m_set->frame_id;
+
+    queue->head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
@@ -0,0 +1,75 @@
+#include "expmap.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+// static ---------------------------------------------------------------------
+
+static const size_t kBatchSize = 128;
+
+// global ---------------------------------------------------------------------
+
+Mandelbrot::Error Mandelbrot::SetUpExpMap(ExpMap* map, double radius, size_t n_angles) {
+    assert(map != nullptr);
+    assert(radius > 0.0);
+    assert(n_angles > 0);
+
+    map->radius    = radius;
+    map->n_angles  = n_angles;
+    map->cos_table = (double*)calloc(n_angles, sizeof(double));
+    map->sin_table = (double*)calloc(n_angles, sizeof(double));
+
+    if (map->cos_table == nullptr || map->sin_table == nullptr) {
+        TearDownExpMap(map);
+        return Error::kBadAlloc;
+    }
+
+    for (size_t j = 0; j < n_angles; j++) {
+        double angle = 2.0 * M_PI * (double)j / (double)n_angles;
+
+        map->cos_table[j] = cos(angle);
+        map->sin_table[j] = sin(angle);
+    }
+
+    return Error::kOk;
+}
+
+void Mandelbrot::TearDownExpMap(ExpMap* map) {
+    assert(map != nullptr);
+
+    free(map->cos_table);
+    free(map->sin_table);
+    map->cos_table = nullptr;
+    map->sin_table = nullptr;
+    map->n_angles  = 0;
+}
+
+double Mandelbrot::ExpMapRadius(const ExpMap& map, double row) {
+    return map.radius * exp(-2.0 * M_PI * row / (double)map.n_angles);
+}
+
+void Mandelbrot::ComputeExpRow(const Frame& frame, const ExpMap& map, size_t row, uint32_t* pixels) {
+    assert(frame.m_set != nullptr);
+    assert(pixels != nullptr);
+
+    OffsetKernel kernel = ChooseOffsetKernel(frame);
+    double radius = ExpMapRadius(map, (double)row);
+
+    double offset_x[kBatchSize] = {};
+    double offset_y[kBatchSize] = {};
+    uint32_t iter_count[kBatchSize] = {};
+    float magnitude[kBatchSize] = {};
+
+    for (size_t first = 0; first < map.n_angles; first += kBatchSize) {
+        size_t n_points = std::min(kBatchSize, map.n_angles - first);
+
+        for (size_t i = 0; i < n_points; i++) {
+            offset_x[i] = radius * map.cos_table[first + i];
+            offset_y[i] = radius * map.sin_table[first + i];
+        }
+
+        kernel(frame, offset_x, offset_y, n_points, iter_count, magnitude);
+        frame.m_set->kernels->colorize_points(frame.m_set, iter_count, magnitude, n_points, pixels + first);
+    }
+}
@@ -1,49 +1,84 @@
 #include "graphics.h"
 #include "config.h"
 #include "mandelbrot.h"
+#include "bench.h"
 
-void Render(sf::RenderWindow& window, const Mandelbrot::MSet& m_set) {
-    sf::Image image;
-    image.create(kWindowWidth, kWindowHight, m_set.pixels);
+void Render(sf::RenderWindow& window, Screen* screen, const FrameSlot* frame) {
+    assert(screen != nullptr);
 
-    sf::Texture texture;
-    texture.loadFromImage(image);
+    [[maybe_unused]] uint64_t start_time = GetTime();
 
-    sf::Sprite sprite;
-    sprite.setTexture(texture);
+    if (frame != nullptr) {
+        size_t back = screen->valid ? (screen->front + 1) % kScreenTextures : screen->front;
+        sf::Texture& texture = screen->textures[back];
+
+        unsigned int width  = (unsigned int)frame->width;
+        unsigned int height = (unsigned int)frame->height;
+        if (texture.getSize().x != width || texture.getSize().y != height) {
+            texture.create(width, height);
+        }
+
+        // straight from the frame buffer, no sf::Image copy in between
+        texture.update(frame->pixels);
+        screen->sprite.setTexture(texture, true);
+
+        screen->front = back;
+        screen->valid = true;
+    }
+
+    [[maybe_unused]] uint64_t upload_time = GetTime();
 
     window.clear();
-    window.draw(sprite);
+    window.draw(screen->sprite);
     window.display();
+
+    [[maybe_unused]] uint64_t end_time = GetTime();
+#if defined (LOG_TIME)
+    fprintf(stdout, "render %lu upload %lu\n", end_time - start_time, upload_time - start_time);
+#endif
 }
 
-void CheckWindowEvents(sf::RenderWindow& window, Mandelbrot::MSet* m_set) {
-    assert(m_set != nullptr);
-    
+bool CheckWindowEvents(sf::RenderWindow& window, ViewRequest* request) {
+    assert(request != nullptr);
+
+    bool requested = false;
+
     sf::Event event;
     while (window.pollEvent(event)) {
         if (event.type == sf::Event::Closed) {
             window.close();
         } else if (event.type == sf::Event::KeyPressed) {
+            ViewRequest next = EmptyRequest();
+
             if (sf::Keyboard::isKeyPressed(kButtonMoveLeft)) {
-                m_set->move_x -= 10.0f * m_set->scale;
+                next.pan_x = -10.0;
             } else if (sf::Keyboard::isKeyPressed(kButtonMoveRight)) {
-                m_set->move_x += 10.0f * m_set->scale;
+                next.pan_x = 10.0;
             } else if (sf::Keyboard::isKeyPressed(kButtonMoveUp)) {
-                m_set->move_y -= 10.0f * m_set->scale;
+                next.pan_y = -10.0;
             } else if (sf::Keyboard::isKeyPressed(kButtonMoveDown)) {
-                m_set->move_y += 10.0f * m_set->scale;
+                next.pan_y = 10.0;
             } else if (sf::Keyboard::isKeyPressed(kButtonDefaultView)) {
-                m_set->move_y = 0.0f;
-                m_set->move_x = 0.0f;
-                m_set->scale  = 1.0f;
+                next.reset = true;
             } else if (sf::Keyboard::isKeyPressed(kButtonZoomIn)) {
-                m_set->scale /= 1.01f;
+                next.zoom = 1.0 / 1.01;
             } else if (sf::Keyboard::isKeyPressed(kButtonZoomOut)) {
-                m_set->scale *= 1.01f;
+                next.zoom = 1.01;
+            } else if (sf::Keyboard::isKeyPressed(kButtonCycleColors)) {
+                next.palette_shift = 1;
+            } else if (sf::Keyboard::isKeyPressed(kButtonSmoothColors)) {
+                next.toggle_smooth = true;
             } else if (sf::Keyboard::isKeyPressed(kButtonQuit)) { 
                 window.close();
+                continue;
+            } else {
+                continue;
             }
+
+            MergeRequest(request, next);
+            requested = true;
         }
     }
-}
\ No newline at end of file
+
+    return requested;
+}
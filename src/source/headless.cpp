@@ -0,0 +1,608 @@
+#include "headless.h"
+#include "image.h"
+#include "stats.h"
+#include "antialias.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// static ---------------------------------------------------------------------
+
+// where an interrupted job stopped, kept in <output>.progress next to the output
+struct JobProgress {
+    size_t rows_done;
+    long offset;    // bytes of the output up to the end of those rows
+    uint32_t adler; // PngAdler after them, png only
+};
+
+// strip of a job handed over to the writer thread, compute continues in the other buffer
+struct StripTask {
+    const sf::Uint8* pixels;
+    size_t row;    // first image row of the strip
+    size_t n_rows;
+    const RenderJob* job;
+    uint64_t hash;     // JobHash, progress files of the job carry it
+    JobProgress start; // where the output of the job continues, its first strip opens it there
+};
+
+struct FrameWriter {
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable changed;
+
+    sf::Uint8* pixels;
+    StripTask task;
+
+    // output of the current job, open from its first strip to its last, writer thread only
+    FILE* file;
+    ImageWriter image;
+
+    bool busy;
+    bool failed;
+    bool quit;
+};
+
+static const size_t kMaxJobLine = 512;
+static const size_t kJobFields  = 6;
+
+static const char   kProgressSuffix[] = ".progress";
+static const size_t kMaxProgressPath  = kMaxPathLen + sizeof(kProgressSuffix);
+
+static size_t StripRows(const RenderJob* job);
+static void SetStripView(Mandelbrot::MSet* m_set, const RenderJob* job, size_t row, size_t n_rows);
+static Mandelbrot::Precision JobPrecision(const Mandelbrot::MSet* m_set, const RenderJob* job);
+
+static bool ResumeJob(const RenderJob* job, uint64_t hash, JobProgress* start);
+static void ProgressPath(const RenderJob* job, char* path);
+static uint64_t JobHash(const Mandelbrot::MSet* m_set, const RenderJob* job);
+static bool ReadProgress(const RenderJob* job, uint64_t hash, JobProgress* progress);
+static bool WriteProgress(const RenderJob* job, uint64_t hash, const JobProgress& progress);
+
+static void WriterLoop(FrameWriter* writer);
+static bool WriteStrip(FrameWriter* writer, const StripTask& task);
+static bool OpenOutput(FrameWriter* writer, const StripTask& task);
+static bool CloseOutput(FrameWriter* writer, const RenderJob* job);
+static void WaitWriter(FrameWriter* writer);
+
+// global ---------------------------------------------------------------------
+
+bool ParseJob(const char* spec, RenderJob* job) {
+    assert(spec != nullptr);
+    assert(job != nullptr);
+
+    *job = {};
+
+    // centers go to HpParse, so they are cut out of the spec by hand instead of %lf
+    const char* fields[kJobFields] = {};
+    char buffer[kMaxJobLine] = {};
+    if (strlen(spec) >= sizeof(buffer)) {
+        return false;
+    }
+    strcpy(buffer, spec);
+
+    char* cur = buffer;
+    for (size_t i = 0; i < kJobFields; i++) {
+        cur += strspn(cur, " \t");
+        fields[i] = cur;
+
+        char* end = (i + 1 < kJobFields) ? strchr(cur, ',') : cur + strcspn(cur, " \t\r\n");
+        if (end == nullptr) {
+            return false;
+        }
+
+        bool last = (*end == '\0');
+        *end = '\0';
+        cur = last ? end : end + 1;
+    }
+
+    if (!HpParse(fields[0], &job->center_x) || !HpParse(fields[1], &job->center_y)) {
+        return false;
+    }
+
+    if (sscanf(fields[2], "%lf", &job->scale) != 1 || job->scale <= 0.0
+        || sscanf(fields[3], "%zux%zu", &job->width, &job->height) != 2
+        || sscanf(fields[4], "%zu", &job->max_iter) != 1 || job->max_iter > Mandelbrot::kMaxIterLimit) {
+        return false;
+    }
+
+    size_t len = strlen(fields[5]);
+    if (len == 0 || len >= kMaxPathLen) {
+        return false;
+    }
+
+    memcpy(job->output, fields[5], len + 1);
+
+    return true;
+}
+
+bool AppendJob(RenderJob** jobs, size_t* n_jobs, const RenderJob* job) {
+    assert(jobs != nullptr);
+    assert(n_jobs != nullptr);
+    assert(job != nullptr);
+
+    RenderJob* grown = (RenderJob*)realloc(*jobs, (*n_jobs + 1) * sizeof(RenderJob));
+    if (grown == nullptr) {
+        return false;
+    }
+
+    grown[*n_jobs] = *job;
+    *jobs = grown;
+    (*n_jobs)++;
+
+    return true;
+}
+
+bool ReadJobFile(const char* path, RenderJob** jobs, size_t* n_jobs) {
+    assert(path != nullptr);
+    assert(jobs != nullptr);
+    assert(n_jobs != nullptr);
+
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char line[kMaxJobLine] = {};
+    size_t line_number = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file) != nullptr) {
+        line_number++;
+
+        const char* start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') {
+            continue;
+        }
+
+        RenderJob job = {};
+        if (!ParseJob(start, &job)) {
+            fprintf(stderr, "# Error: %s:%zu: bad job\n", path, line_number);
+            ok = false;
+        } else {
+            ok = AppendJob(jobs, n_jobs, &job);
+        }
+    }
+
+    fclose(file);
+
+    return ok;
+}
+
+Mandelbrot::Error RenderJobs(Mandelbrot::MSet* m_set, const RenderJob* jobs, size_t n_jobs, bool resume,
+                             Cluster* cluster) {
+    assert(m_set != nullptr);
+    assert(jobs != nullptr || n_jobs == 0);
+
+    using Mandelbrot::Error;
+
+    // both buffers are sized for the biggest strip once, Resize never reallocates after that
+    size_t biggest = 0;
+    for (size_t i = 0; i < n_jobs; i++) {
+        if (jobs[i].width * StripRows(&jobs[i]) > jobs[biggest].width * StripRows(&jobs[biggest])) {
+            biggest = i;
+        }
+    }
+
+    if (n_jobs > 0) {
+        Error error = Mandelbrot::Resize(m_set, jobs[biggest].width, StripRows(&jobs[biggest]));
+        if (error != Error::kOk) {
+            return error;
+        }
+    }
+
+    FrameWriter writer = {};
+    writer.pixels = (sf::Uint8*)calloc(m_set->capacity, sizeof(sf::Uint8));
+    if (writer.pixels == nullptr) {
+        return Error::kBadAlloc;
+    }
+
+    writer.thread = std::thread(WriterLoop, &writer);
+
+    Mandelbrot::Precision precision = m_set->precision;
+
+    Error error = Error::kOk;
+    for (size_t i = 0; i < n_jobs && error == Error::kOk; i++) {
+        const RenderJob* job = &jobs[i];
+
+        m_set->precision = precision;
+        uint64_t hash = JobHash(m_set, job);
+
+        JobProgress start = {};
+        if (resume && !ResumeJob(job, hash, &start)) {
+            fprintf(stderr, "# job %zu: %s is already written\n", i, job->output);
+            continue;
+        }
+
+        size_t strip_rows = StripRows(job);
+
+        if (strip_rows < job->height) {
+            m_set->precision = JobPrecision(m_set, job);
+        }
+
+        for (size_t row = start.rows_done; row < job->height; row += strip_rows) {
+            size_t n_rows = std::min(strip_rows, job->height - row);
+
+            error = Mandelbrot::Resize(m_set, job->width, n_rows);
+            if (error != Error::kOk) {
+                fprintf(stderr, "# Error: job %zu: bad size %zux%zu\n", i, job->width, job->height);
+                break;
+            }
+
+            SetStripView(m_set, job, row, n_rows);
+            if (cluster != nullptr) {
+                error = ComputeOnCluster(cluster, m_set);
+                if (error != Error::kOk) {
+                    fprintf(stderr, "# Error: job %zu: %s rows %zu-%zu were not computed\n", i, job->output, row, row + n_rows);
+                    break;
+                }
+            } else {
+                Mandelbrot::Compute(m_set);
+            }
+
+            bool antialiased = m_set->antialias != Mandelbrot::Antialias::kOff;
+#if defined(KERNEL_STATS)
+            fprintf(stderr, "# job %zu: %s rows %zu-%zu\n", i, job->output, row, row + n_rows);
+            Mandelbrot::PrintStats(stderr, m_set->stats);
+#else
+            if (antialiased) {
+                fprintf(stderr, "# job %zu: %s rows %zu-%zu\n", i, job->output, row, row + n_rows);
+            }
+#endif
+            if (antialiased) {
+                Mandelbrot::PrintAntialias(stderr, m_set);
+            }
+
+            WaitWriter(&writer);
+
+            std::lock_guard<std::mutex> guard(writer.lock);
+            if (writer.failed) {
+                error = Error::kBadFile;
+                break;
+            }
+
+            sf::Uint8* computed = m_set->pixels;
+            m_set->pixels = writer.pixels;
+            Mandelbrot::Invalidate(m_set);
+
+            writer.pixels = computed;
+            writer.task   = {computed, row, n_rows, job, hash, start};
+            writer.busy   = true;
+            writer.changed.notify_all();
+        }
+    }
+
+    m_set->precision = precision;
+
+    WaitWriter(&writer);
+    {
+        std::lock_guard<std::mutex> guard(writer.lock);
+        if (writer.failed) {
+            error = Error::kBadFile;
+        }
+
+        writer.quit = true;
+        writer.changed.notify_all();
+    }
+
+    writer.thread.join();
+    free(writer.pixels);
+
+    // a failed job keeps its progress file, --resume continues it
+    if (writer.file != nullptr && writer.file != stdout) {
+        fclose(writer.file);
+    }
+
+    return error;
+}
+
+void SetJobView(Mandelbrot::MSet* m_set, const RenderJob* job) {
+    assert(m_set != nullptr);
+    assert(job != nullptr);
+
+    m_set->deep_x   = job->center_x;
+    m_set->deep_y   = job->center_y;
+    m_set->move_x   = 0.0;
+    m_set->move_y   = 0.0;
+    m_set->scale    = job->scale;
+    m_set->max_iter = job->max_iter;
+}
+
+// static ---------------------------------------------------------------------
+
+// full rows of about kStripBytes of rgba, whole tile rows when there are more than one
+static size_t StripRows(const RenderJob* job) {
+    assert(job != nullptr);
+
+    size_t row_bytes = 4 * job->width;
+    if (row_bytes == 0 || kStripBytes / row_bytes >= job->height) {
+        return job->height;
+    }
+
+    size_t n_rows = kStripBytes / row_bytes;
+    if (n_rows > kTileHight) {
+        n_rows -= n_rows % kTileHight;
+    }
+
+    return std::max(n_rows, (size_t)1);
+}
+
+// m_set is n_rows high, its view is those rows of the job: the same pixel step and
+// the same left and top edges as a job sized frame would have
+static void SetStripView(Mandelbrot::MSet* m_set, const RenderJob* job, size_t row, size_t n_rows) {
+    assert(m_set != nullptr);
+    assert(job != nullptr);
+
+    SetJobView(m_set, job);
+    if (n_rows == job->height) {
+        return;
+    }
+
+    double job_side   = (double)(job->width + job->height) / 2.0;
+    double strip_side = (double)(job->width + n_rows) / 2.0;
+    double step = job->scale * 4.0 / job_side;
+
+    // see GetViewport: step = scale * 4 / avg_side, y0 = center + (move_y - scale * height / 2) * 4 / avg_side
+    m_set->scale  = step * strip_side / 4.0;
+    m_set->move_y = ((double)row + (double)n_rows / 2.0 - (double)job->height / 2.0) * step * strip_side / 4.0;
+}
+
+// auto precision of the whole job, strips on their own could pick different kernels
+static Mandelbrot::Precision JobPrecision(const Mandelbrot::MSet* m_set, const RenderJob* job) {
+    assert(m_set != nullptr);
+    assert(job != nullptr);
+
+    if (m_set->precision != Mandelbrot::Precision::kAuto) {
+        return m_set->precision;
+    }
+
+    // ChoosePrecision only looks at the view and the size, no buffer is touched
+    Mandelbrot::MSet job_frame = *m_set;
+    job_frame.width  = job->width;
+    job_frame.height = job->height;
+    SetJobView(&job_frame, job);
+
+    return Mandelbrot::ChoosePrecision(&job_frame, Mandelbrot::GetViewport(&job_frame));
+}
+
+// a job with a progress file of its own goes on from it, one whose output exists without it
+// was finished by the interrupted run (OpenOutput writes the progress file before the output);
+// false means there is nothing left to do
+static bool ResumeJob(const RenderJob* job, uint64_t hash, JobProgress* start) {
+    assert(job != nullptr);
+    assert(start != nullptr);
+
+    *start = {};
+
+    if (strcmp(job->output, "-") == 0 || ReadProgress(job, hash, start)) {
+        return true;
+    }
+
+    FILE* file = fopen(job->output, "rb");
+    if (file == nullptr) {
+        return true;
+    }
+
+    fclose(file);
+    return false;
+}
+
+static void ProgressPath(const RenderJob* job, char* path) {
+    assert(job != nullptr);
+    assert(path != nullptr);
+
+    snprintf(path, kMaxProgressPath, "%s%s", job->output, kProgressSuffix);
+}
+
+// FNV-1a of everything which changes the pixels of the job: the job itself and the settings of m_set,
+// rows of a resumed job have to come out as the interrupted run would have written them
+static uint64_t JobHash(const Mandelbrot::MSet* m_set, const RenderJob* job) {
+    assert(m_set != nullptr);
+    assert(job != nullptr);
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+        }
+    };
+
+    add(&job->center_x, sizeof(job->center_x));
+    add(&job->center_y, sizeof(job->center_y));
+    add(&job->scale,    sizeof(job->scale));
+    add(&job->width,    sizeof(job->width));
+    add(&job->height,   sizeof(job->height));
+    add(&job->max_iter, sizeof(job->max_iter));
+
+    add(&m_set->escape_radius,   sizeof(m_set->escape_radius));
+    add(&m_set->formula,         sizeof(m_set->formula));
+    add(&m_set->julia_x,         sizeof(m_set->julia_x));
+    add(&m_set->julia_y,         sizeof(m_set->julia_y));
+    add(&m_set->precision,       sizeof(m_set->precision));
+    add(&m_set->interior_checks, sizeof(m_set->interior_checks));
+    add(&m_set->keep_magnitudes, sizeof(m_set->keep_magnitudes));
+    add(&m_set->refill,          sizeof(m_set->refill));
+    add(&m_set->interleave,      sizeof(m_set->interleave));
+    add(&m_set->subdivide,       sizeof(m_set->subdivide));
+    add(&m_set->antialias,       sizeof(m_set->antialias));
+    add(m_set->kernels->name,    strlen(m_set->kernels->name)); // --serve workers take the table from the tile
+
+    const Mandelbrot::Palette& palette = m_set->palette;
+    add(palette.lut,       kPaletteLutSize * sizeof(palette.lut[0]));
+    add(&palette.step,     sizeof(palette.step));
+    add(&palette.offset,   sizeof(palette.offset));
+    add(&palette.interior, sizeof(palette.interior));
+    add(&palette.smooth,   sizeof(palette.smooth));
+
+    return hash;
+}
+
+// returns whether the progress file exists, progress stays zero unless it belongs to this job
+static bool ReadProgress(const RenderJob* job, uint64_t hash, JobProgress* progress) {
+    assert(job != nullptr);
+    assert(progress != nullptr);
+
+    char path[kMaxProgressPath] = {};
+    ProgressPath(job, path);
+
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    unsigned long long read_hash = 0;
+    JobProgress read = {};
+    if (fscanf(file, "%llx %zu %ld %x", &read_hash, &read.rows_done, &read.offset, &read.adler) == 4
+        && read_hash == hash && read.rows_done < job->height && read.offset > 0) {
+        *progress = read;
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool WriteProgress(const RenderJob* job, uint64_t hash, const JobProgress& progress) {
+    assert(job != nullptr);
+
+    char path[kMaxProgressPath] = {};
+    ProgressPath(job, path);
+
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool ok = fprintf(file, "%016llx %zu %ld %08x\n", (unsigned long long)hash, progress.rows_done,
+                      progress.offset, progress.adler) > 0;
+
+    return (fclose(file) == 0) && ok;
+}
+
+static void WriterLoop(FrameWriter* writer) {
+    assert(writer != nullptr);
+
+    std::unique_lock<std::mutex> guard(writer->lock);
+    while (true) {
+        writer->changed.wait(guard, [writer] { return writer->busy || writer->quit; });
+        if (!writer->busy) {
+            return;
+        }
+
+        StripTask task = writer->task;
+
+        guard.unlock();
+        bool ok = WriteStrip(writer, task);
+        guard.lock();
+
+        if (!ok) {
+            fprintf(stderr, "# Error: can not write %s\n", task.job->output);
+            writer->failed = true;
+        }
+
+        writer->busy = false;
+        writer->changed.notify_all();
+    }
+}
+
+// progress is saved after the rows it counts are flushed, rows of an interrupted strip are written again
+static bool WriteStrip(FrameWriter* writer, const StripTask& task) {
+    assert(writer != nullptr);
+    assert(task.pixels != nullptr);
+    assert(task.job != nullptr);
+
+    if (task.row == task.start.rows_done && !OpenOutput(writer, task)) {
+        return false;
+    }
+
+    if (!ImageWriteRows(&writer->image, task.pixels, task.n_rows)) {
+        return false;
+    }
+
+    if (writer->image.rows_written == task.job->height) {
+        return CloseOutput(writer, task.job);
+    }
+
+    if (writer->file == stdout) {
+        return true;
+    }
+
+    JobProgress progress = {};
+    progress.rows_done = writer->image.rows_written;
+    progress.adler     = PngAdler(&writer->image.png);
+
+    if (fflush(writer->file) != 0) {
+        return false;
+    }
+    progress.offset = ftell(writer->file);
+
+    return progress.offset > 0 && WriteProgress(task.job, task.hash, progress);
+}
+
+static bool OpenOutput(FrameWriter* writer, const StripTask& task) {
+    assert(writer != nullptr);
+    assert(writer->file == nullptr);
+
+    const RenderJob* job = task.job;
+
+    if (strcmp(job->output, "-") == 0) {
+        writer->file = stdout;
+        return ImageBegin(&writer->image, stdout, ImageFormat::kRaw, job->width, job->height);
+    }
+
+    ImageFormat format = FormatFromPath(job->output);
+
+    // a progress file of no rows goes first, an output cut short before its first strip
+    // is started over by --resume instead of being taken for a written one
+    if (task.start.rows_done == 0) {
+        if (!WriteProgress(job, task.hash, JobProgress{})) {
+            return false;
+        }
+
+        writer->file = fopen(job->output, "wb");
+        return writer->file != nullptr && ImageBegin(&writer->image, writer->file, format, job->width, job->height);
+    }
+
+    // whatever the interrupted run wrote after the saved offset is cut off and written again
+    writer->file = fopen(job->output, "r+b");
+    if (writer->file == nullptr || fseek(writer->file, task.start.offset, SEEK_SET) != 0
+        || ftruncate(fileno(writer->file), task.start.offset) != 0) {
+        return false;
+    }
+
+    ImageResume(&writer->image, writer->file, format, job->width, job->height, task.start.rows_done,
+                task.start.adler);
+
+    return true;
+}
+
+// the progress file of a written job is gone, so --resume skips it next time
+static bool CloseOutput(FrameWriter* writer, const RenderJob* job) {
+    assert(writer != nullptr);
+    assert(job != nullptr);
+
+    bool ok = ImageEnd(&writer->image);
+
+    if (writer->file == stdout) {
+        writer->file = nullptr;
+        return ok && fflush(stdout) == 0;
+    }
+
+    ok = (fclose(writer->file) == 0) && ok;
+    writer->file = nullptr;
+
+    char path[kMaxProgressPath] = {};
+    ProgressPath(job, path);
+    remove(path);
+
+    return ok;
+}
+
+static void WaitWriter(FrameWriter* writer) {
+    assert(writer != nullptr);
+
+    std::unique_lock<std::mutex> guard(writer->lock);
+    writer->changed.wait(guard, [writer] { return !writer->busy; });
+}
@@ -0,0 +1,162 @@
+#include "hp_real.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+
+// static ---------------------------------------------------------------------
+
+static const double kLimbBase = 4294967296.0; // 2^32
+
+static bool IsNegative(const HpReal& value);
+static HpReal Negate(const HpReal& value);
+
+// global ---------------------------------------------------------------------
+
+HpReal HpFromDouble(double value) {
+    HpReal result = {};
+
+    bool negative = (value < 0.0);
+    double magnitude = fabs(value);
+    assert(magnitude < kLimbBase / 2.0);
+
+    // peel off 32 bits at a time starting from the integer part, exact for every double in range
+    for (size_t i = kHpLimbs; i-- > 0;) {
+        double limb = floor(magnitude);
+        result.limb[i] = (uint32_t)limb;
+        magnitude = (magnitude - limb) * kLimbBase;
+    }
+
+    return negative ? Negate(result) : result;
+}
+
+double HpToDouble(const HpReal& value) {
+    bool negative = IsNegative(value);
+    HpReal magnitude = negative ? Negate(value) : value;
+
+    // 3 top limbs hold more bits than double mantissa has
+    double result = 0.0;
+    double weight = 1.0;
+    for (size_t i = kHpLimbs; i-- > 0 && i + 3 >= kHpLimbs;) {
+        result += (double)magnitude.limb[i] * weight;
+        weight /= kLimbBase;
+    }
+
+    return negative ? -result : result;
+}
+
+bool HpParse(const char* str, HpReal* value) {
+    assert(str != nullptr);
+    assert(value != nullptr);
+
+    bool negative = false;
+    if (*str == '-' || *str == '+') {
+        negative = (*str == '-');
+        str++;
+    }
+
+    if (!isdigit((unsigned char)*str) && *str != '.') {
+        return false;
+    }
+
+    uint64_t integer = 0;
+    for (; isdigit((unsigned char)*str); str++) {
+        integer = integer * 10 + (uint64_t)(*str - '0');
+        if (integer > INT32_MAX) {
+            return false;
+        }
+    }
+
+    HpReal result = {};
+
+    if (*str == '.') {
+        str++;
+
+        const char* digits = str;
+        while (isdigit((unsigned char)*str)) {
+            str++;
+        }
+
+        // frac = (digit + frac) / 10 from the last digit to the first
+        for (const char* digit = str; digit-- != digits;) {
+            result.limb[kHpLimbs - 1] = (uint32_t)(*digit - '0');
+
+            uint64_t rem = 0;
+            for (size_t i = kHpLimbs; i-- > 0;) {
+                uint64_t cur = (rem << 32) | result.limb[i];
+                result.limb[i] = (uint32_t)(cur / 10);
+                rem = cur % 10;
+            }
+        }
+    }
+
+    if (*str != '\0' && !isspace((unsigned char)*str) && *str != ',') {
+        return false;
+    }
+
+    result.limb[kHpLimbs - 1] = (uint32_t)integer;
+    *value = negative ? Negate(result) : result;
+
+    return true;
+}
+
+HpReal HpAdd(const HpReal& a, const HpReal& b) {
+    HpReal result = {};
+
+    uint64_t carry = 0;
+    for (size_t i = 0; i < kHpLimbs; i++) {
+        uint64_t sum = (uint64_t)a.limb[i] + b.limb[i] + carry;
+        result.limb[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+
+    return result;
+}
+
+HpReal HpSub(const HpReal& a, const HpReal& b) {
+    return HpAdd(a, Negate(b));
+}
+
+HpReal HpMul(const HpReal& a, const HpReal& b) {
+    bool negative = IsNegative(a) != IsNegative(b);
+    HpReal abs_a = IsNegative(a) ? Negate(a) : a;
+    HpReal abs_b = IsNegative(b) ? Negate(b) : b;
+
+    // full 2n limb product, the fixed point result is limbs [n - 1, 2n - 1)
+    uint32_t product[2 * kHpLimbs] = {};
+    for (size_t i = 0; i < kHpLimbs; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < kHpLimbs; j++) {
+            uint64_t cur = (uint64_t)abs_a.limb[i] * abs_b.limb[j] + product[i + j] + carry;
+            product[i + j] = (uint32_t)cur;
+            carry = cur >> 32;
+        }
+        product[i + kHpLimbs] = (uint32_t)carry;
+    }
+
+    HpReal result = {};
+    for (size_t i = 0; i < kHpLimbs; i++) {
+        result.limb[i] = product[i + kHpLimbs - 1];
+    }
+
+    return negative ? Negate(result) : result;
+}
+
+// static ---------------------------------------------------------------------
+
+static bool IsNegative(const HpReal& value) {
+    return (value.limb[kHpLimbs - 1] >> 31) != 0;
+}
+
+static HpReal Negate(const HpReal& value) {
+    HpReal result = {};
+
+    uint64_t carry = 1;
+    for (size_t i = 0; i < kHpLimbs; i++) {
+        uint64_t sum = (uint64_t)(uint32_t)~value.limb[i] + carry;
+        result.limb[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+
+    return result;
+}
@@ -0,0 +1,424 @@
+#include "image.h"
+
+#include <assert.h>
+#include <string.h>
+
+// static ---------------------------------------------------------------------
+
+struct CrcTable {
+    uint32_t value[256];
+};
+
+static const size_t kMaxStoredBlock = 65535;
+static const uint32_t kAdlerMod = 65521;
+static const size_t kAdlerChunk = 5552; // max bytes before adler sums can overflow
+static const size_t kMaxIdatBytes = 1 << 24;
+
+static const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+static CrcTable MakeCrcTable();
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, size_t size);
+static void UpdateAdler(PngWriter* png, const uint8_t* data, size_t size);
+
+static void PutU32(uint8_t* out, uint32_t value);
+static size_t PngRowBytes(size_t width);
+static size_t DeflatedRowBytes(size_t width);
+
+static bool WriteChunkBegin(FILE* file, size_t length, const char* type, uint32_t* crc);
+static bool WriteChunkData(FILE* file, const uint8_t* data, size_t size, uint32_t* crc);
+static bool WriteChunkEnd(FILE* file, uint32_t crc);
+static bool WriteIdatRows(PngWriter* png, const uint8_t* rgba, size_t n_rows);
+static bool WritePngRow(PngWriter* png, const uint8_t* rgba, uint32_t* crc);
+
+static bool WritePpmRows(FILE* file, const uint8_t* rgba, size_t width, size_t n_rows);
+
+// global ---------------------------------------------------------------------
+
+ImageFormat FormatFromPath(const char* path) {
+    assert(path != nullptr);
+
+    const char* ext = strrchr(path, '.');
+    if (ext == nullptr) {
+        return ImageFormat::kRaw;
+    }
+
+    if (strcmp(ext, ".png") == 0) {
+        return ImageFormat::kPng;
+    }
+    if (strcmp(ext, ".ppm") == 0) {
+        return ImageFormat::kPpm;
+    }
+
+    return ImageFormat::kRaw;
+}
+
+bool WriteImage(FILE* file, ImageFormat format, const uint8_t* rgba, size_t width, size_t height) {
+    assert(file != nullptr);
+    assert(rgba != nullptr);
+
+    ImageWriter image = {};
+    return ImageBegin(&image, file, format, width, height)
+           && ImageWriteRows(&image, rgba, height)
+           && ImageEnd(&image);
+}
+
+bool ImageBegin(ImageWriter* image, FILE* file, ImageFormat format, size_t width, size_t height) {
+    assert(image != nullptr);
+    assert(file != nullptr);
+
+    image->file         = file;
+    image->format       = format;
+    image->width        = width;
+    image->height       = height;
+    image->rows_written = 0;
+
+    switch (format) {
+        case ImageFormat::kPng:
+            return PngBegin(&image->png, file, width, height);
+        case ImageFormat::kPpm:
+            return fprintf(file, "P6\n%zu %zu\n255\n", width, height) >= 0;
+        case ImageFormat::kRaw:
+            return true;
+        default:
+            assert(0 && "unknown image format");
+            return false;
+    }
+}
+
+bool ImageWriteRows(ImageWriter* image, const uint8_t* rgba, size_t n_rows) {
+    assert(image != nullptr);
+    assert(rgba != nullptr);
+    assert(image->rows_written + n_rows <= image->height);
+
+    bool ok = false;
+    switch (image->format) {
+        case ImageFormat::kPng:
+            ok = PngWriteRows(&image->png, rgba, n_rows);
+            break;
+        case ImageFormat::kPpm:
+            ok = WritePpmRows(image->file, rgba, image->width, n_rows);
+            break;
+        case ImageFormat::kRaw:
+            ok = fwrite(rgba, 4 * image->width, n_rows, image->file) == n_rows;
+            break;
+        default:
+            assert(0 && "unknown image format");
+            break;
+    }
+
+    image->rows_written += n_rows;
+
+    return ok;
+}
+
+bool ImageEnd(ImageWriter* image) {
+    assert(image != nullptr);
+    assert(image->rows_written == image->height);
+
+    return (image->format == ImageFormat::kPng) ? PngEnd(&image->png) : true;
+}
+
+void ImageResume(ImageWriter* image, FILE* file, ImageFormat format, size_t width, size_t height,
+                 size_t rows_written, uint32_t adler) {
+    assert(image != nullptr);
+    assert(file != nullptr);
+    assert(rows_written <= height);
+
+    image->file         = file;
+    image->format       = format;
+    image->width        = width;
+    image->height       = height;
+    image->rows_written = rows_written;
+
+    if (format == ImageFormat::kPng) {
+        PngResume(&image->png, file, width, height, rows_written, adler);
+    }
+}
+
+bool PngBegin(PngWriter* png, FILE* file, size_t width, size_t height) {
+    assert(png != nullptr);
+    assert(file != nullptr);
+
+    png->file         = file;
+    png->width        = width;
+    png->height       = height;
+    png->rows_written = 0;
+    png->adler_a      = 1;
+    png->adler_b      = 0;
+
+    if (fwrite(kPngSignature, sizeof(kPngSignature), 1, file) != 1) {
+        return false;
+    }
+
+    uint8_t header[13] = {};
+    PutU32(header, (uint32_t)width);
+    PutU32(header + 4, (uint32_t)height);
+    header[8] = 8; // bit depth
+    header[9] = 6; // rgba
+    // compression, filter and interlace methods are 0
+
+    uint32_t crc = 0;
+    return WriteChunkBegin(file, sizeof(header), "IHDR", &crc)
+           && WriteChunkData(file, header, sizeof(header), &crc)
+           && WriteChunkEnd(file, crc);
+}
+
+bool PngWriteRows(PngWriter* png, const uint8_t* rgba, size_t n_rows) {
+    assert(png != nullptr);
+    assert(rgba != nullptr);
+    assert(png->rows_written + n_rows <= png->height);
+
+    size_t row_size = DeflatedRowBytes(png->width);
+    size_t max_batch = (kMaxIdatBytes / row_size > 0) ? kMaxIdatBytes / row_size : 1;
+
+    while (n_rows > 0) {
+        size_t batch = (n_rows < max_batch) ? n_rows : max_batch;
+        if (!WriteIdatRows(png, rgba, batch)) {
+            return false;
+        }
+
+        rgba   += 4 * png->width * batch;
+        n_rows -= batch;
+    }
+
+    return true;
+}
+
+bool PngEnd(PngWriter* png) {
+    assert(png != nullptr);
+    assert(png->rows_written == png->height);
+
+    // empty final stored block and adler32 of the whole stream
+    uint8_t tail[9] = {0x01, 0x00, 0x00, 0xFF, 0xFF};
+    PutU32(tail + 5, PngAdler(png));
+
+    uint32_t crc = 0;
+    return WriteChunkBegin(png->file, sizeof(tail), "IDAT", &crc)
+           && WriteChunkData(png->file, tail, sizeof(tail), &crc)
+           && WriteChunkEnd(png->file, crc)
+           && WriteChunkBegin(png->file, 0, "IEND", &crc)
+           && WriteChunkEnd(png->file, crc);
+}
+
+void PngResume(PngWriter* png, FILE* file, size_t width, size_t height, size_t rows_written, uint32_t adler) {
+    assert(png != nullptr);
+    assert(file != nullptr);
+    assert(rows_written <= height);
+
+    png->file         = file;
+    png->width        = width;
+    png->height       = height;
+    png->rows_written = rows_written;
+    png->adler_a      = adler & 0xFFFF;
+    png->adler_b      = adler >> 16;
+}
+
+uint32_t PngAdler(const PngWriter* png) {
+    assert(png != nullptr);
+
+    return (png->adler_b << 16) | png->adler_a;
+}
+
+// static ---------------------------------------------------------------------
+
+static CrcTable MakeCrcTable() {
+    CrcTable table = {};
+
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table.value[n] = c;
+    }
+
+    return table;
+}
+
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+    assert(data != nullptr);
+
+    static const CrcTable table = MakeCrcTable();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.value[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static void UpdateAdler(PngWriter* png, const uint8_t* data, size_t size) {
+    assert(png != nullptr);
+    assert(data != nullptr);
+
+    uint32_t a = png->adler_a;
+    uint32_t b = png->adler_b;
+
+    while (size > 0) {
+        size_t chunk = (size < kAdlerChunk) ? size : kAdlerChunk;
+        for (size_t i = 0; i < chunk; i++) {
+            a += data[i];
+            b += a;
+        }
+
+        a %= kAdlerMod;
+        b %= kAdlerMod;
+
+        data += chunk;
+        size -= chunk;
+    }
+
+    png->adler_a = a;
+    png->adler_b = b;
+}
+
+static void PutU32(uint8_t* out, uint32_t value) {
+    assert(out != nullptr);
+
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)(value);
+}
+
+// filter byte + pixels
+static size_t PngRowBytes(size_t width) {
+    return 1 + 4 * width;
+}
+
+// every row is split in stored blocks with 5 byte headers
+static size_t DeflatedRowBytes(size_t width) {
+    size_t row_bytes = PngRowBytes(width);
+    size_t n_blocks = (row_bytes + kMaxStoredBlock - 1) / kMaxStoredBlock;
+
+    return row_bytes + 5 * n_blocks;
+}
+
+static bool WriteChunkBegin(FILE* file, size_t length, const char* type, uint32_t* crc) {
+    assert(file != nullptr);
+    assert(type != nullptr);
+    assert(crc != nullptr);
+
+    uint8_t header[8] = {};
+    PutU32(header, (uint32_t)length);
+    memcpy(header + 4, type, 4);
+
+    *crc = UpdateCrc(0, header + 4, 4);
+
+    return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+static bool WriteChunkData(FILE* file, const uint8_t* data, size_t size, uint32_t* crc) {
+    assert(file != nullptr);
+    assert(data != nullptr);
+    assert(crc != nullptr);
+
+    *crc = UpdateCrc(*crc, data, size);
+
+    return fwrite(data, 1, size, file) == size;
+}
+
+static bool WriteChunkEnd(FILE* file, uint32_t crc) {
+    assert(file != nullptr);
+
+    uint8_t tail[4] = {};
+    PutU32(tail, crc);
+
+    return fwrite(tail, sizeof(tail), 1, file) == 1;
+}
+
+static bool WriteIdatRows(PngWriter* png, const uint8_t* rgba, size_t n_rows) {
+    assert(png != nullptr);
+    assert(rgba != nullptr);
+
+    bool first = (png->rows_written == 0);
+    size_t length = n_rows * DeflatedRowBytes(png->width) + (first ? 2 : 0);
+
+    uint32_t crc = 0;
+    if (!WriteChunkBegin(png->file, length, "IDAT", &crc)) {
+        return false;
+    }
+
+    if (first) {
+        const uint8_t zlib_header[2] = {0x78, 0x01};
+        if (!WriteChunkData(png->file, zlib_header, sizeof(zlib_header), &crc)) {
+            return false;
+        }
+    }
+
+    for (size_t row = 0; row < n_rows; row++) {
+        if (!WritePngRow(png, rgba + 4 * png->width * row, &crc)) {
+            return false;
+        }
+    }
+
+    png->rows_written += n_rows;
+
+    return WriteChunkEnd(png->file, crc);
+}
+
+static bool WritePngRow(PngWriter* png, const uint8_t* rgba, uint32_t* crc) {
+    assert(png != nullptr);
+    assert(rgba != nullptr);
+    assert(crc != nullptr);
+
+    const uint8_t filter = 0;
+    size_t row_bytes = PngRowBytes(png->width);
+
+    // row is [filter][rgba...], blocks are cut from it without copying
+    for (size_t offset = 0; offset < row_bytes; offset += kMaxStoredBlock) {
+        size_t size = row_bytes - offset;
+        if (size > kMaxStoredBlock) {
+            size = kMaxStoredBlock;
+        }
+
+        uint8_t header[5] = {0x00, (uint8_t)size, (uint8_t)(size >> 8),
+                             (uint8_t)~size, (uint8_t)(~size >> 8)};
+        if (!WriteChunkData(png->file, header, sizeof(header), crc)) {
+            return false;
+        }
+
+        const uint8_t* data = nullptr;
+        if (offset == 0) {
+            if (!WriteChunkData(png->file, &filter, 1, crc)) {
+                return false;
+            }
+            UpdateAdler(png, &filter, 1);
+
+            data = rgba;
+            size--;
+        } else {
+            data = rgba + offset - 1;
+        }
+
+        if (!WriteChunkData(png->file, data, size, crc)) {
+            return false;
+        }
+        UpdateAdler(png, data, size);
+    }
+
+    return true;
+}
+
+// pixels without the header, ImageBegin writes it
+static bool WritePpmRows(FILE* file, const uint8_t* rgba, size_t width, size_t n_rows) {
+    assert(file != nullptr);
+    assert(rgba != nullptr);
+
+    uint8_t rgb[3 * 256] = {};
+    size_t n_pixels = width * n_rows;
+
+    for (size_t pos = 0; pos < n_pixels; pos += 256) {
+        size_t n = (n_pixels - pos < 256) ? n_pixels - pos : 256;
+        for (size_t i = 0; i < n; i++) {
+            memcpy(rgb + 3 * i, rgba + 4 * (pos + i), 3);
+        }
+
+        if (fwrite(rgb, 3, n, file) != n) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,114 @@
+#include "kernels.h"
+
+// static ---------------------------------------------------------------------
+
+// widest first, BestKernels takes the first one the cpu supports,
+// naive and array are last so they are only used when asked for by name
+static const Mandelbrot::KernelTable* const kAllKernels[] = {
+    &Mandelbrot::kKernelsAvx512,
+    &Mandelbrot::kKernelsAvx2Fma,
+    &Mandelbrot::kKernelsAvx2,
+    &Mandelbrot::kKernelsSse4,
+    &Mandelbrot::kKernelsScalar,
+    &Mandelbrot::kKernelsArray,
+    &Mandelbrot::kKernelsNaive,
+};
+
+static const size_t kNumKernels = sizeof(kAllKernels) / sizeof(kAllKernels[0]);
+
+// global ---------------------------------------------------------------------
+
+const Mandelbrot::KernelTable* Mandelbrot::BestKernels() {
+    for (size_t i = 0; i < kNumKernels; i++) {
+        if (kAllKernels[i]->supported()) {
+            return kAllKernels[i];
+        }
+    }
+
+    return &kKernelsScalar;
+}
+
+size_t Mandelbrot::KernelCount() {
+    return kNumKernels;
+}
+
+const Mandelbrot::KernelTable* Mandelbrot::KernelAt(size_t index) {
+    assert(index < kNumKernels);
+
+    return kAllKernels[index];
+}
+
+const Mandelbrot::KernelTable* Mandelbrot::FindKernels(const char* name) {
+    assert(name != nullptr);
+
+    for (size_t i = 0; i < kNumKernels; i++) {
+        if (strcmp(kAllKernels[i]->name, name) == 0) {
+            return kAllKernels[i]->supported() ? kAllKernels[i] : nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+Mandelbrot::TileKernel Mandelbrot::ChooseTileKernel(const Frame& frame) {
+    assert(frame.m_set != nullptr);
+
+    const KernelTable* kernels = frame.m_set->kernels;
+
+    switch (frame.precision) {
+        case Precision::kPerturbation:
+            return kernels->tile_perturbation;
+        case Precision::kDouble:
+            return frame.m_set->refill ? kernels->tile_refill_f64 : kernels->tile_f64;
+        case Precision::kFloat:
+        case Precision::kAuto:
+        default:
+            return frame.m_set->refill ? kernels->tile_refill_f32 : kernels->tile_f32;
+    }
+}
+
+Mandelbrot::PointKernel Mandelbrot::ChoosePointKernel(const Frame& frame) {
+    assert(frame.m_set != nullptr);
+
+    const KernelTable* kernels = frame.m_set->kernels;
+
+    switch (frame.precision) {
+        case Precision::kPerturbation:
+            return kernels->points_perturbation;
+        case Precision::kDouble:
+            return kernels->points_f64;
+        case Precision::kFloat:
+        case Precision::kAuto:
+        default:
+            return kernels->points_f32;
+    }
+}
+
+Mandelbrot::OffsetKernel Mandelbrot::ChooseOffsetKernel(const Frame& frame) {
+    assert(frame.m_set != nullptr);
+
+    const KernelTable* kernels = frame.m_set->kernels;
+
+    switch (frame.precision) {
+        case Precision::kPerturbation:
+            return kernels->offsets_perturbation;
+        case Precision::kDouble:
+            return kernels->offsets_f64;
+        case Precision::kFloat:
+        case Precision::kAuto:
+        default:
+            return kernels->offsets_f32;
+    }
+}
+
+void Mandelbrot::PrintKernels(FILE* stream) {
+    assert(stream != nullptr);
+
+    const KernelTable* best = BestKernels();
+
+    for (size_t i = 0; i < kNumKernels; i++) {
+        fprintf(stream, "%-8s %s%s\n", kAllKernels[i]->name,
+                kAllKernels[i]->supported() ? "supported" : "not supported",
+                kAllKernels[i] == best ? ", default" : "");
+    }
+}
@@ -0,0 +1,38 @@
+#include "kernels.h"
+
+// static ---------------------------------------------------------------------
+
+// runs before we know the cpu, so it stays outside the target pragma
+static bool Supported() {
+    return __builtin_cpu_supports("avx2");
+}
+
+// everything below is compiled for avx2 only, kernels.h and the standard headers are
+// included above the pragma so their inline functions stay baseline and can be shared
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUG__)
+    #pragma GCC push_options
+    #pragma GCC target("avx2")
+#endif
+
+#include "simd_avx2.h"
+#include "kernel_impl.h"
+
+// global ---------------------------------------------------------------------
+
+// 256 bit
+const Mandelbrot::KernelTable Mandelbrot::kKernelsAvx2 = {
+    "avx2", Supported,
+    ComputeTile<Avx2F32<false>, 2>, ComputeTile<Avx2F64<false>, 2>, ComputePerturbation<Avx2F64<false>>,
+    ComputeTileRefill<Avx2F32<false>>, ComputeTileRefill<Avx2F64<false>>,
+    ComputePoints<Avx2F32<false>>, ComputePoints<Avx2F64<false>>, ComputePointsPerturbation<Avx2F64<false>>,
+    ComputeOffsets<Avx2F32<false>>, ComputeOffsets<Avx2F64<false>>, ComputeOffsetsPerturbation<Avx2F64<false>>,
+    ColorizeTile<Avx2F32<false>>, ColorizePoints<Avx2F32<false>>,
+};
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#elif defined(__GNUG__)
+    #pragma GCC pop_options
+#endif
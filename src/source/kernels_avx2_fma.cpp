@@ -0,0 +1,38 @@
+#include "kernels.h"
+
+// static ---------------------------------------------------------------------
+
+// runs before we know the cpu, so it stays outside the target pragma
+static bool Supported() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+// everything below is compiled for avx2,fma only, kernels.h and the standard headers are
+// included above the pragma so their inline functions stay baseline and can be shared
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUG__)
+    #pragma GCC push_options
+    #pragma GCC target("avx2,fma")
+#endif
+
+#include "simd_avx2.h"
+#include "kernel_impl.h"
+
+// global ---------------------------------------------------------------------
+
+// 256 bit with fused multiply add, results differ from avx2 in the last bits
+const Mandelbrot::KernelTable Mandelbrot::kKernelsAvx2Fma = {
+    "avx2fma", Supported,
+    ComputeTile<Avx2F32<true>, 2>, ComputeTile<Avx2F64<true>, 2>, ComputePerturbation<Avx2F64<true>>,
+    ComputeTileRefill<Avx2F32<true>>, ComputeTileRefill<Avx2F64<true>>,
+    ComputePoints<Avx2F32<true>>, ComputePoints<Avx2F64<true>>, ComputePointsPerturbation<Avx2F64<true>>,
+    ComputeOffsets<Avx2F32<true>>, ComputeOffsets<Avx2F64<true>>, ComputeOffsetsPerturbation<Avx2F64<true>>,
+    ColorizeTile<Avx2F32<true>>, ColorizePoints<Avx2F32<true>>,
+};
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#elif defined(__GNUG__)
+    #pragma GCC pop_options
+#endif
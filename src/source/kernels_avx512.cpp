@@ -0,0 +1,38 @@
+#include "kernels.h"
+
+// static ---------------------------------------------------------------------
+
+// runs before we know the cpu, so it stays outside the target pragma
+static bool Supported() {
+    return __builtin_cpu_supports("avx512f");
+}
+
+// everything below is compiled for avx512f only, kernels.h and the standard headers are
+// included above the pragma so their inline functions stay baseline and can be shared
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUG__)
+    #pragma GCC push_options
+    #pragma GCC target("avx512f")
+#endif
+
+#include "simd_avx512.h"
+#include "kernel_impl.h"
+
+// global ---------------------------------------------------------------------
+
+// 512 bit with k register masks
+const Mandelbrot::KernelTable Mandelbrot::kKernelsAvx512 = {
+    "avx512", Supported,
+    ComputeTile<Avx512F32, 2>, ComputeTile<Avx512F64, 2>, ComputePerturbation<Avx512F64>,
+    ComputeTileRefill<Avx512F32>, ComputeTileRefill<Avx512F64>,
+    ComputePoints<Avx512F32>, ComputePoints<Avx512F64>, ComputePointsPerturbation<Avx512F64>,
+    ComputeOffsets<Avx512F32>, ComputeOffsets<Avx512F64>, ComputeOffsetsPerturbation<Avx512F64>,
+    ColorizeTile<Avx512F32>, ColorizePoints<Avx512F32>,
+};
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#elif defined(__GNUG__)
+    #pragma GCC pop_options
+#endif
@@ -0,0 +1,189 @@
+#include "kernels.h"
+#include "simd_scalar.h"
+#include "kernel_impl.h"
+
+// no target pragma, this file is the baseline every x86-64 cpu runs
+
+// static ---------------------------------------------------------------------
+
+// array kernel lanes, one ymm of floats
+static const size_t kArrayGroup = 8;
+
+static bool AlwaysSupported();
+
+static void ComputeNaive(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile);
+static uint32_t CheckPixelNaive(float real, float imag, size_t max_iter, float bailout, float* escape_mag);
+
+template <size_t kGroupSize>
+static void ComputeArray(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile);
+template <size_t kGroupSize>
+static void CheckPixelArray(const float* real, const float* imag, size_t max_iter, float bailout,
+                            uint32_t* iter_count);
+
+// global ---------------------------------------------------------------------
+
+// naive and array are the step by step versions from README, they only have a float tile kernel
+// and only iterate z^2 + c from z = 0, tiles of the other formulas go to the scalar lanes;
+// single lane points compute every pixel from its own coordinate just like they do;
+// array does not keep |z|^2, its lanes go on iterating after they escape;
+// a single lane never waits for another one, so no scalar table needs lane refill;
+// interleaved scalar tiles lost to the plain ones in mandelbrot_bench, they keep a factor of 1
+const Mandelbrot::KernelTable Mandelbrot::kKernelsNaive = {
+    "naive", AlwaysSupported,
+    ComputeNaive, ComputeTile<ScalarF64>, ComputePerturbation<ScalarF64>,
+    ComputeNaive, ComputeTile<ScalarF64>,
+    ComputePoints<ScalarF32>, ComputePoints<ScalarF64>, ComputePointsPerturbation<ScalarF64>,
+    ComputeOffsets<ScalarF32>, ComputeOffsets<ScalarF64>, ComputeOffsetsPerturbation<ScalarF64>,
+    ColorizeTile<ScalarF32>, ColorizePoints<ScalarF32>,
+};
+
+const Mandelbrot::KernelTable Mandelbrot::kKernelsArray = {
+    "array", AlwaysSupported,
+    ComputeArray<kArrayGroup>, ComputeTile<ScalarF64>, ComputePerturbation<ScalarF64>,
+    ComputeArray<kArrayGroup>, ComputeTile<ScalarF64>,
+    ComputePoints<ScalarF32>, ComputePoints<ScalarF64>, ComputePointsPerturbation<ScalarF64>,
+    ComputeOffsets<ScalarF32>, ComputeOffsets<ScalarF64>, ComputeOffsetsPerturbation<ScalarF64>,
+    ColorizeTile<ScalarF32>, ColorizePoints<ScalarF32>,
+};
+
+const Mandelbrot::KernelTable Mandelbrot::kKernelsScalar = {
+    "scalar", AlwaysSupported,
+    ComputeTile<ScalarF32>, ComputeTile<ScalarF64>, ComputePerturbation<ScalarF64>,
+    ComputeTile<ScalarF32>, ComputeTile<ScalarF64>,
+    ComputePoints<ScalarF32>, ComputePoints<ScalarF64>, ComputePointsPerturbation<ScalarF64>,
+    ComputeOffsets<ScalarF32>, ComputeOffsets<ScalarF64>, ComputeOffsetsPerturbation<ScalarF64>,
+    ColorizeTile<ScalarF32>, ColorizePoints<ScalarF32>,
+};
+
+// static ---------------------------------------------------------------------
+
+static bool AlwaysSupported() {
+    return true;
+}
+
+static void ComputeNaive(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    Mandelbrot::MSet* m_set = frame.m_set;
+    const Mandelbrot::Viewport& view = frame.view;
+
+    if (m_set->formula != Mandelbrot::Formula::kMandelbrot) {
+        ComputeTile<ScalarF32>(frame, tile);
+        return;
+    }
+
+    float bailout = (float)(m_set->escape_radius * m_set->escape_radius);
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        float imag = (float)PixelImag(view, y, 0.0);
+        for (int32_t x = tile.x_begin; x < tile.x_end; x++) {
+            float real = (float)PixelReal(view, x, 0.0);
+
+            size_t pos = (size_t)y * m_set->width + (size_t)x;
+            m_set->iter_counts[pos] = CheckPixelNaive(real, imag, m_set->max_iter, bailout, &m_set->magnitudes[pos]);
+        }
+    }
+}
+
+static uint32_t CheckPixelNaive(float real, float imag, size_t max_iter, float bailout, float* escape_mag) {
+    float x = 0.0f;
+    float y = 0.0f;
+
+    uint32_t iter = 0;
+
+    float x_mul = 0;
+    float y_mul = 0;
+
+    while (x_mul + y_mul < bailout && iter <= max_iter) {
+        float x_temp = x_mul - y_mul + real;
+        y = 2.0f * x * y + imag;
+        x = x_temp;
+
+        x_mul = x * x;
+        y_mul = y * y;
+        iter++;
+    }
+
+    *escape_mag = (iter > max_iter) ? 0.0f : x_mul + y_mul;
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::RecordVector(&iter, &iter, 1, max_iter);
+#endif
+
+    return iter;
+}
+
+template <size_t kGroupSize>
+static void ComputeArray(const Mandelbrot::Frame& frame, Mandelbrot::Tile tile) {
+    Mandelbrot::MSet* m_set = frame.m_set;
+    const Mandelbrot::Viewport& view = frame.view;
+
+    if (m_set->formula != Mandelbrot::Formula::kMandelbrot) {
+        ComputeTile<ScalarF32>(frame, tile);
+        return;
+    }
+
+    float bailout = (float)(m_set->escape_radius * m_set->escape_radius);
+
+    alignas(32) float real[kGroupSize] = {};
+    alignas(32) float imag[kGroupSize] = {};
+    alignas(32) uint32_t iter_count[kGroupSize] = {};
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        float tmp_y = (float)PixelImag(view, y, 0.0);
+        for (int32_t x = tile.x_begin; x < tile.x_end; x += (int32_t)kGroupSize) {
+            for (size_t i = 0; i < kGroupSize; i++) {
+                real[i] = (float)PixelReal(view, x + (int32_t)i, 0.0);
+                imag[i] = tmp_y;
+            }
+
+            CheckPixelArray<kGroupSize>(real, imag, m_set->max_iter, bailout, iter_count);
+
+            size_t n_lanes = std::min((size_t)(tile.x_end - x), kGroupSize);
+            for (size_t i = 0; i < n_lanes; i++) {
+                size_t pos = (size_t)y * m_set->width + (size_t)x + i;
+
+                m_set->iter_counts[pos] = iter_count[i];
+                m_set->magnitudes[pos]  = 0.0f;
+            }
+        }
+    }
+}
+
+template <size_t kGroupSize>
+static void CheckPixelArray(const float* real, const float* imag, size_t max_iter, float bailout,
+                            uint32_t* iter_count) {
+    alignas(32) float x[kGroupSize] = {};
+    alignas(32) float y[kGroupSize] = {};
+
+    uint32_t iter = 0;
+    std::fill_n(iter_count, kGroupSize, 0u);
+
+    alignas(32) float x_temp[kGroupSize] = {};
+    alignas(32) float x_mul[kGroupSize] = {};
+    alignas(32) float y_mul[kGroupSize] = {};
+
+#if defined(__clang__)
+    #pragma nounroll
+#elif defined(__GNUG__)
+    #pragma GCC unroll 0
+#endif
+    while (iter <= max_iter) {
+        for (size_t i = 0; i < kGroupSize; i++) x_mul[i] = x[i] * x[i];
+        for (size_t i = 0; i < kGroupSize; i++) y_mul[i] = y[i] * y[i];
+
+        int check_rad = 0;
+        for (size_t i = 0; i < kGroupSize; i++) check_rad += (x_mul[i] + y_mul[i] < bailout);
+        if (check_rad == 0) { break; }
+
+        for (size_t i = 0; i < kGroupSize; i++) iter_count[i] += (x_mul[i] + y_mul[i] < bailout);
+
+        for (size_t i = 0; i < kGroupSize; i++) x_temp[i] = x_mul[i] - y_mul[i] + real[i];
+        for (size_t i = 0; i < kGroupSize; i++) y[i] = 2.0f * x[i] * y[i] + imag[i];
+        for (size_t i = 0; i < kGroupSize; i++) x[i] = x_temp[i];
+
+        iter++;
+    }
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::RecordVector(iter_count, iter_count, kGroupSize, max_iter);
+#endif
+}
@@ -0,0 +1,38 @@
+#include "kernels.h"
+
+// static ---------------------------------------------------------------------
+
+// runs before we know the cpu, so it stays outside the target pragma
+static bool Supported() {
+    return __builtin_cpu_supports("sse4.1");
+}
+
+// everything below is compiled for sse4.1 only, kernels.h and the standard headers are
+// included above the pragma so their inline functions stay baseline and can be shared
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUG__)
+    #pragma GCC push_options
+    #pragma GCC target("sse4.1")
+#endif
+
+#include "simd_sse4.h"
+#include "kernel_impl.h"
+
+// global ---------------------------------------------------------------------
+
+// 128 bit, no gather, no fma
+const Mandelbrot::KernelTable Mandelbrot::kKernelsSse4 = {
+    "sse4", Supported,
+    ComputeTile<Sse4F32, 2>, ComputeTile<Sse4F64, 2>, ComputePerturbation<Sse4F64>,
+    ComputeTileRefill<Sse4F32>, ComputeTileRefill<Sse4F64>,
+    ComputePoints<Sse4F32>, ComputePoints<Sse4F64>, ComputePointsPerturbation<Sse4F64>,
+    ComputeOffsets<Sse4F32>, ComputeOffsets<Sse4F64>, ComputeOffsetsPerturbation<Sse4F64>,
+    ColorizeTile<Sse4F32>, ColorizePoints<Sse4F32>,
+};
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#elif defined(__GNUG__)
+    #pragma GCC pop_options
+#endif
@@ -1,31 +1,518 @@
 #include "mandelbrot.h"
+#include "kernels.h"
 #include "graphics.h"
+#include "bench.h"
+#include "headless.h"
+#include "zoom.h"
+#include "palette.h"
+#include "engine.h"
+#include "tile_cache.h"
+#include "cluster.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+struct Options {
+    size_t n_threads;
+    bool report_scaling;
+    bool report_throughput;
+    bool report_interior;
+    bool report_subdivision;
+    bool report_pan;
+    bool report_progressive;
+    bool report_colors;
+    bool report_antialias;
+    bool subdivide;
+    bool refill;
+    size_t interleave; // 0 keeps the factor of the kernel table
+    bool progressive;
+    bool antialias;
+    long frame_budget_ms; // -1 keeps the default
+    Mandelbrot::Precision precision;
+
+    // 0 keeps kMaxIteration, kWindowWidth x kWindowHight and kEscapeRadius,
+    // headless jobs have a size and max_iter of their own
+    size_t max_iter;
+    size_t width;
+    size_t height;
+    double escape_radius;
+
+    // mandelbrot unless set, julia_x + i julia_y is c of a julia set
+    Mandelbrot::Formula formula;
+    double julia_x;
+    double julia_y;
+
+    const char* palette; // nullptr keeps mcolor.h
+    bool smooth;
+
+    // tiles of earlier frames are reused, tile_cache_file keeps them for later runs too
+    bool tile_cache;
+    const char* tile_cache_file;
+
+    const char* kernel; // nullptr means the widest the cpu supports
+    bool list_kernels;
+
+    bool headless;
+    bool resume;
+    RenderJob* jobs;
+    size_t n_jobs;
+
+    bool has_zoom;
+    ZoomJob zoom;
+
+    // headless jobs go to the workers connected to serve, worker computes the tiles of one
+    const char* serve;
+    const char* worker;
+};
+
+static bool ParseOptions(int argc, char** argv, Options* options);
+static bool ParsePrecision(const char* name, Mandelbrot::Precision* precision);
+static bool ParseFormula(const char* name, Options* options);
+static bool ParseSize(const char* size, size_t* width, size_t* height);
+
+int main(int argc, char** argv) {
+    Options options = {};
+    options.frame_budget_ms = -1;
+
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr, "usage: %s [--threads N] [--precision auto|float|double|perturbation] [--kernel name] "
+                        "[--subdivide] [--refill] [--interleave 1|2|4] [--progressive] [--budget ms] "
+                        "[--palette name|file] [--smooth] [--max-iter N] [--bailout R] [--size WxH] "
+                        "[--formula name] [--antialias] [--tile-cache] [--tile-cache-file path]\n"
+                        "       %s [--threads N] [--precision ...] [--kernel name] [--budget ms] "
+                        "[--scaling] [--throughput] [--interior] [--subdivision] [--pan] [--refine] [--colors] [--aliasing]\n"
+                        "       %s --headless [--threads N] [--precision auto|float|double|perturbation] "
+                        "[--kernel name] [--subdivide] [--refill] [--interleave 1|2|4] [--palette name|file] [--smooth] "
+                        "[--bailout R] [--formula name] [--antialias] [--tile-cache] [--tile-cache-file path] [--resume] "
+                        "[--job re,im,scale,WxH,max_iter,output]... [--jobs file]\n"
+                        "       %s --zoom re,im,scale,WxH,max_iter,frames,output [--threads N] [--precision ...] "
+                        "[--kernel name] [--palette name|file] [--smooth] [--bailout R] [--formula name] [--antialias] [--tile-cache]\n"
+                        "       %s --headless --serve unix:/path|host:port [--precision ...] [--kernel name] [--palette name|file] "
+                        "[--smooth] [--bailout R] [--formula name] [--resume] [--job ...]... [--jobs file]\n"
+                        "       %s --worker unix:/path|host:port [--threads N] [--refill] [--interleave 1|2|4]\n"
+                        "       %s --kernels\n"
+                        "formulas: mandelbrot, julia:re,im, multibrot3, multibrot4, burning-ship\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        free(options.jobs);
+        return 1;
+    }
+
+    if (options.list_kernels) {
+        Mandelbrot::PrintKernels(stdout);
+        free(options.jobs);
+
+        return 0;
+    }
 
-int main() {
     using MError = Mandelbrot::Error;
     MError m_error = MError::kOk;
     
+    // headless buffers grow to the biggest job in RenderJobs, zoom ones to the center of its frames
+    bool windowless = options.headless || options.has_zoom || options.worker != nullptr;
+    size_t width  = windowless ? 1 : kWindowWidth;
+    size_t height = windowless ? 1 : kWindowHight;
+    if (options.width > 0) {
+        width  = options.width;
+        height = options.height;
+    }
+
     Mandelbrot::MSet m_set = {};
-    m_error = Mandelbrot::SetUp(&m_set);
+    m_error = Mandelbrot::SetUp(&m_set, width, height, options.n_threads);
 
     if (m_error != MError::kOk) {
         fprintf(stderr, "# Error: bad alloc\n");
         Mandelbrot::TearDown(&m_set);
+        free(options.jobs);
 
         return 1;
     }
 
-    sf::RenderWindow window(sf::VideoMode(kWindowWidth, 
-                                          kWindowHight), 
+    m_set.precision = options.precision;
+    m_set.subdivide = options.subdivide;
+    m_set.refill = options.refill;
+    m_set.interleave = options.interleave;
+    m_set.progressive = options.progressive;
+    m_set.antialias = options.antialias ? Mandelbrot::Antialias::kEdges : Mandelbrot::Antialias::kOff;
+
+    if (options.max_iter > 0) {
+        m_set.max_iter = options.max_iter;
+    }
+    if (options.escape_radius > 0.0) {
+        m_set.escape_radius = options.escape_radius;
+    }
+
+    m_set.formula = options.formula;
+    m_set.julia_x = options.julia_x;
+    m_set.julia_y = options.julia_y;
+
+    // smoothing needs |z|^2 of every pixel
+    m_set.palette.smooth = options.smooth;
+    m_set.keep_magnitudes = options.smooth;
+
+    if (options.palette != nullptr) {
+        m_error = Mandelbrot::LoadPalette(&m_set.palette, options.palette);
+        if (m_error != MError::kOk) {
+            fprintf(stderr, "# Error: can not load palette \"%s\"\n", options.palette);
+            Mandelbrot::TearDown(&m_set);
+            free(options.jobs);
+
+            return 1;
+        }
+    }
+
+    if (options.tile_cache) {
+        m_set.tile_cache = Mandelbrot::CreateTileCache(options.tile_cache_file);
+        if (m_set.tile_cache == nullptr) {
+            fprintf(stderr, "# Error: can not set up tile cache%s%s\n", (options.tile_cache_file != nullptr) ? " in " : "",
+                    (options.tile_cache_file != nullptr) ? options.tile_cache_file : "");
+            Mandelbrot::TearDown(&m_set);
+            free(options.jobs);
+
+            return 1;
+        }
+    }
+
+    if (options.frame_budget_ms >= 0) {
+        m_set.frame_budget_ms = (size_t)options.frame_budget_ms;
+    }
+
+    if (options.kernel != nullptr) {
+        m_set.kernels = Mandelbrot::FindKernels(options.kernel);
+        if (m_set.kernels == nullptr) {
+            fprintf(stderr, "# Error: kernel \"%s\" is unknown or not supported by this cpu\n", options.kernel);
+            Mandelbrot::PrintKernels(stderr);
+            Mandelbrot::TearDown(&m_set);
+            free(options.jobs);
+
+            return 1;
+        }
+    }
+
+    if (options.report_throughput) {
+        ReportPrecisionThroughput(&m_set);
+    }
+
+    if (options.report_scaling) {
+        ReportThreadScaling(&m_set, options.n_threads);
+    }
+
+    if (options.report_interior) {
+        ReportInteriorChecks(&m_set);
+    }
+
+    if (options.report_subdivision) {
+        ReportSubdivision(&m_set);
+    }
+
+    if (options.report_pan) {
+        ReportPanLatency(&m_set);
+    }
+
+    if (options.report_progressive) {
+        ReportProgressive(&m_set);
+    }
+
+    if (options.report_colors) {
+        ReportColorize(&m_set);
+    }
+
+    if (options.report_antialias) {
+        ReportAntialias(&m_set);
+    }
+
+    if (options.report_scaling || options.report_throughput || options.report_interior
+        || options.report_subdivision || options.report_pan || options.report_progressive
+        || options.report_colors || options.report_antialias) {
+        Mandelbrot::TearDown(&m_set);
+        free(options.jobs);
+
+        return 0;
+    }
+
+    if (options.worker != nullptr) {
+        m_error = RunWorker(&m_set, options.worker);
+        Mandelbrot::TearDown(&m_set);
+        free(options.jobs);
+
+        return (m_error == MError::kOk) ? 0 : 1;
+    }
+
+    if (options.headless) {
+        Cluster* cluster = nullptr;
+        if (options.serve != nullptr) {
+            cluster = CreateCluster(options.serve);
+            if (cluster == nullptr) {
+                fprintf(stderr, "# Error: can not listen on %s\n", options.serve);
+                Mandelbrot::TearDown(&m_set);
+                free(options.jobs);
+
+                return 1;
+            }
+        }
+
+        m_error = RenderJobs(&m_set, options.jobs, options.n_jobs, options.resume, cluster);
+        if (m_set.tile_cache != nullptr) {
+            Mandelbrot::PrintTileCache(stderr, m_set.tile_cache);
+        }
+        if (cluster != nullptr) {
+            PrintCluster(stderr, cluster);
+            DestroyCluster(cluster);
+        }
+        Mandelbrot::TearDown(&m_set);
+        free(options.jobs);
+
+        return (m_error == MError::kOk) ? 0 : 1;
+    }
+
+    if (options.has_zoom) {
+        m_error = RenderZoom(&m_set, &options.zoom);
+        Mandelbrot::TearDown(&m_set);
+        free(options.jobs);
+
+        return (m_error == MError::kOk) ? 0 : 1;
+    }
+
+    // a frame of its own size gets a window of that size instead of the whole screen
+    sf::RenderWindow window(sf::VideoMode((unsigned int)m_set.width, 
+                                          (unsigned int)m_set.height), 
                             kWindowTitle,
-                            sf::Style::Fullscreen);
+                            (options.width > 0) ? sf::Style::Default : sf::Style::Fullscreen);
+    window.setFramerateLimit(kFrameRateLimit);
+
+    // the engine thread owns m_set from here on, the window only sends requests and draws frames
+    Engine engine = {};
+    m_error = StartEngine(&engine, &m_set);
+    if (m_error != MError::kOk) {
+        fprintf(stderr, "# Error: bad alloc\n");
+        Mandelbrot::TearDown(&m_set);
+        free(options.jobs);
+
+        return 1;
+    }
+
+    Screen screen = {};
     while (window.isOpen()) {
-        CheckWindowEvents(window, &m_set);
-        Mandelbrot::Compute(&m_set);
-        Render(window, m_set);
+        ViewRequest request = EmptyRequest();
+        if (CheckWindowEvents(window, &request)) {
+            PostRequest(&engine, request);
+        }
+
+        const FrameSlot* frame = AcquireFrame(&engine);
+        Render(window, &screen, frame);
+        if (frame != nullptr) {
+            ReleaseFrame(&engine);
+        }
     }
 
+    StopEngine(&engine);
     Mandelbrot::TearDown(&m_set);
+    free(options.jobs);
 
     return 0;
-}
\ No newline at end of file
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options) {
+    assert(argv != nullptr);
+    assert(options != nullptr);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->n_threads = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            options->report_scaling = true;
+        } else if (strcmp(argv[i], "--throughput") == 0) {
+            options->report_throughput = true;
+        } else if (strcmp(argv[i], "--interior") == 0) {
+            options->report_interior = true;
+        } else if (strcmp(argv[i], "--subdivision") == 0) {
+            options->report_subdivision = true;
+        } else if (strcmp(argv[i], "--pan") == 0) {
+            options->report_pan = true;
+        } else if (strcmp(argv[i], "--refine") == 0) {
+            options->report_progressive = true;
+        } else if (strcmp(argv[i], "--colors") == 0) {
+            options->report_colors = true;
+        } else if (strcmp(argv[i], "--aliasing") == 0) {
+            options->report_antialias = true;
+        } else if (strcmp(argv[i], "--antialias") == 0) {
+            options->antialias = true;
+        } else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc) {
+            options->palette = argv[++i];
+        } else if (strcmp(argv[i], "--smooth") == 0) {
+            options->smooth = true;
+        } else if (strcmp(argv[i], "--progressive") == 0) {
+            options->progressive = true;
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            options->frame_budget_ms = strtol(argv[++i], nullptr, 10);
+            if (options->frame_budget_ms < 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--subdivide") == 0) {
+            options->subdivide = true;
+        } else if (strcmp(argv[i], "--refill") == 0) {
+            options->refill = true;
+        } else if (strcmp(argv[i], "--interleave") == 0 && i + 1 < argc) {
+            options->interleave = strtoul(argv[++i], nullptr, 10);
+            if (options->interleave != 1 && options->interleave != 2 && options->interleave != 4) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc) {
+            options->max_iter = strtoul(argv[++i], nullptr, 10);
+            if (options->max_iter == 0 || options->max_iter > Mandelbrot::kMaxIterLimit) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--bailout") == 0 && i + 1 < argc) {
+            // below 2 points of the set would escape
+            options->escape_radius = strtod(argv[++i], nullptr);
+            if (!(options->escape_radius >= 2.0 && options->escape_radius <= kMaxEscapeRadius)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--formula") == 0 && i + 1 < argc) {
+            if (!ParseFormula(argv[++i], options)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (!ParseSize(argv[++i], &options->width, &options->height)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--tile-cache") == 0) {
+            options->tile_cache = true;
+        } else if (strcmp(argv[i], "--tile-cache-file") == 0 && i + 1 < argc) {
+            options->tile_cache = true;
+            options->tile_cache_file = argv[++i];
+        } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            if (!ParsePrecision(argv[++i], &options->precision)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            options->kernel = argv[++i];
+        } else if (strcmp(argv[i], "--kernels") == 0) {
+            options->list_kernels = true;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            options->headless = true;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            options->serve = argv[++i];
+        } else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc) {
+            options->worker = argv[++i];
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            options->resume = true;
+        } else if (strcmp(argv[i], "--job") == 0 && i + 1 < argc) {
+            RenderJob job = {};
+            if (!ParseJob(argv[++i], &job)) {
+                fprintf(stderr, "# Error: bad job \"%s\"\n", argv[i]);
+                return false;
+            }
+            if (!AppendJob(&options->jobs, &options->n_jobs, &job)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--zoom") == 0 && i + 1 < argc) {
+            if (options->has_zoom || !ParseZoom(argv[++i], &options->zoom)) {
+                fprintf(stderr, "# Error: bad zoom \"%s\"\n", argv[i]);
+                return false;
+            }
+            options->has_zoom = true;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            if (!ReadJobFile(argv[++i], &options->jobs, &options->n_jobs)) {
+                fprintf(stderr, "# Error: can not read jobs from %s\n", argv[i]);
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    // reference orbits of perturbation are z^2 + c from z = 0
+    if (options->formula != Mandelbrot::Formula::kMandelbrot
+        && options->precision == Mandelbrot::Precision::kPerturbation) {
+        return false;
+    }
+
+    // a headless job is computed once, progressive would write its coarse pass;
+    // its size and max_iter are part of the job
+    if (options->headless && (options->progressive || options->max_iter > 0 || options->width > 0)) {
+        return false;
+    }
+    if (options->resume && !options->headless) {
+        return false;
+    }
+
+    // workers compute plain tiles, the view and the kernel table come with the tile, the threads are their own;
+    // passes over the whole frame would see only one tile there
+    if (options->serve != nullptr && (!options->headless || options->subdivide || options->antialias
+                                      || options->tile_cache)) {
+        return false;
+    }
+    if (options->worker != nullptr && (options->headless || options->has_zoom || options->progressive
+                                       || options->subdivide || options->antialias || options->tile_cache
+                                       || options->kernel != nullptr || options->max_iter > 0 || options->width > 0 || options->palette != nullptr
+                                       || options->formula != Mandelbrot::Formula::kMandelbrot)) {
+        return false;
+    }
+
+    // a zoom is its own batch mode: frame size, max_iter and every frame view come from its spec
+    if (options->has_zoom && (options->headless || options->progressive || options->max_iter > 0
+                              || options->width > 0)) {
+        return false;
+    }
+
+    // jobs without --headless would silently open a window instead
+    return options->headless == (options->n_jobs > 0);
+}
+
+static bool ParsePrecision(const char* name, Mandelbrot::Precision* precision) {
+    assert(name != nullptr);
+    assert(precision != nullptr);
+
+    if (strcmp(name, "auto") == 0) {
+        *precision = Mandelbrot::Precision::kAuto;
+    } else if (strcmp(name, "float") == 0) {
+        *precision = Mandelbrot::Precision::kFloat;
+    } else if (strcmp(name, "double") == 0) {
+        *precision = Mandelbrot::Precision::kDouble;
+    } else if (strcmp(name, "perturbation") == 0) {
+        *precision = Mandelbrot::Precision::kPerturbation;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// julia takes its c right after the name, "julia:-0.8,0.156"
+static bool ParseFormula(const char* name, Options* options) {
+    assert(name != nullptr);
+    assert(options != nullptr);
+
+    if (strcmp(name, "mandelbrot") == 0) {
+        options->formula = Mandelbrot::Formula::kMandelbrot;
+    } else if (strcmp(name, "multibrot3") == 0) {
+        options->formula = Mandelbrot::Formula::kMultibrot3;
+    } else if (strcmp(name, "multibrot4") == 0) {
+        options->formula = Mandelbrot::Formula::kMultibrot4;
+    } else if (strcmp(name, "burning-ship") == 0) {
+        options->formula = Mandelbrot::Formula::kBurningShip;
+    } else if (strncmp(name, "julia:", 6) == 0) {
+        char end = 0;
+        if (sscanf(name + 6, "%lf,%lf%c", &options->julia_x, &options->julia_y, &end) != 2
+            || !isfinite(options->julia_x) || !isfinite(options->julia_y)) {
+            return false;
+        }
+        options->formula = Mandelbrot::Formula::kJulia;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static bool ParseSize(const char* size, size_t* width, size_t* height) {
+    assert(size != nullptr);
+    assert(width != nullptr);
+    assert(height != nullptr);
+
+    if (sscanf(size, "%zux%zu", width, height) != 2) {
+        return false;
+    }
+
+    return *width > 0 && *height > 0 && *width <= INT32_MAX && *height <= INT32_MAX;
+}
@@ -1,40 +1,97 @@
 #include "mandelbrot.h"
-#include "bench.h"
+#include "kernels.h"
+#include "subdivide.h"
+#include "progressive.h"
+#include "palette.h"
+#include "stats.h"
+#include "tile_cache.h"
+#include "antialias.h"
+#include "expmap.h"
 #include "config.h"
-#include "debug_simd.h"
 
-// static ---------------------------------------------------------------------
-
-#define GROUP_SIZE 8
-#define ALIGNE_YMM __attribute__((aligned(32)))
-
-static const float kWindowAvgSide = (kWindowWidth + kWindowHight) / 2;
-
-static void ColorPixel(Mandelbrot::MSet* m_set, uint8_t grad, int32_t pos);
+#include <x86intrin.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
 
-[[maybe_unused]] static void ComputeNaive(Mandelbrot::MSet* m_set);
-[[maybe_unused]] static uint8_t CheckPixelNaive(float real, float imag);
-
-[[maybe_unused]] static void ComputeArray(Mandelbrot::MSet* m_set);
-[[maybe_unused]] static uint64_t CheckPixelArray(float real[GROUP_SIZE], float imag[GROUP_SIZE]);
+// static ---------------------------------------------------------------------
 
-[[maybe_unused]] static void ComputeSimd(Mandelbrot::MSet* m_set);
-[[maybe_unused]] static uint64_t CheckPixelSimd(__m256 real, __m256 imag);
+static_assert(kTileWidth % 16 == 0, "tile width has to be a multiple of the widest simd group (16)");
+static_assert(kSubdivideTileSide % 16 == 0, "subdivision tile has to be a multiple of the widest simd group (16)");
+
+static const int32_t kRegionAlign = 16;
+
+static void ComputeRegion(Mandelbrot::Frame* frame, Mandelbrot::Tile region, Mandelbrot::TaskFunc task,
+                          int32_t tile_hight);
+static Mandelbrot::Tile RegionTile(const Mandelbrot::Frame& frame, size_t task_id);
+static void ComputeTileTask(void* context, size_t task_id);
+static void ComputeCached(Mandelbrot::Frame* frame);
+static void CachedTileTask(void* context, size_t task_id);
+static void SubdivideTileTask(void* context, size_t task_id);
+static void ColorizeTileTask(void* context, size_t task_id);
+static void ExpRowTask(void* context, size_t task_id);
+static void AntialiasTileTask(void* context, size_t task_id);
+
+static size_t Refine(Mandelbrot::Frame* frame, bool restart);
+static void PassTileTask(void* context, size_t task_id);
+
+static Mandelbrot::ShownView DescribeView(const Mandelbrot::MSet* m_set, const Mandelbrot::Frame& frame);
+static bool SameSettings(const Mandelbrot::ShownView& a, const Mandelbrot::ShownView& b);
+static bool SameDouble(double a, double b);
+static void SplitOrigin(double pixels, int64_t* origin, double* fraction);
+static bool FindShift(const Mandelbrot::ShownView& old_view, const Mandelbrot::ShownView& new_view,
+                      int32_t* shift_x, int32_t* shift_y);
+static void ShiftPixels(Mandelbrot::MSet* m_set, int32_t shift_x, int32_t shift_y);
+static void ShiftRows(uint8_t* buffer, size_t elem_size, size_t width, size_t height, int32_t shift_x, int32_t shift_y);
+static size_t ComputeExposed(Mandelbrot::Frame* frame, int32_t shift_x, int32_t shift_y);
+static void AntialiasExposed(Mandelbrot::Frame* frame, int32_t shift_x, int32_t shift_y);
+
+static void* AllocBuffer(size_t size);
+
+// rows of one ComputeExpMap call, a task computes one of them
+struct ExpRows {
+    const Mandelbrot::Frame* frame;
+    const Mandelbrot::ExpMap* map;
+    size_t first_row;
+    uint32_t* pixels;
+};
+
+static Mandelbrot::Precision PrecisionForStep(const Mandelbrot::MSet* m_set, double magnitude, double step);
+
+static void FoldView(Mandelbrot::MSet* m_set);
+static bool ComputeReferenceOrbit(Mandelbrot::MSet* m_set, size_t* orbit_len);
 
 // global ---------------------------------------------------------------------
 
-Mandelbrot::Error Mandelbrot::SetUp(MSet* m_set) {
+Mandelbrot::Error Mandelbrot::SetUp(MSet* m_set, size_t width, size_t height, size_t n_threads) {
     assert(m_set != nullptr);
     
-    m_set->n_pixels = 4 * kWindowWidth * kWindowHight;
-    m_set->pixels = (sf::Uint8*)calloc(m_set->n_pixels, sizeof(sf::Uint8));
-    if (m_set->pixels == nullptr) {
+    Error error = Resize(m_set, width, height);
+    if (error != Error::kOk) {
+        return error;
+    }
+
+    m_set->pool = CreateThreadPool(n_threads);
+    if (m_set->pool == nullptr) {
         return Error::kBadAlloc;
     }
 
-    m_set->move_x = 0.0f;
-    m_set->move_y = 0.0f;
-    m_set->scale  = 1.0f;
+    error = SetUpPalette(&m_set->palette);
+    if (error != Error::kOk) {
+        return error;
+    }
+
+    m_set->kernels = BestKernels();
+    m_set->interior_checks = true;
+
+    m_set->move_x = 0.0;
+    m_set->move_y = 0.0;
+    m_set->scale  = 1.0;
+
+    m_set->max_iter = kMaxIter;
+    m_set->escape_radius = kEscapeRadius;
+
+    m_set->frame_budget_ms = kFrameBudgetMs;
 
     return Error::kOk;
 }
@@ -42,220 +99,867 @@ Mandelbrot::Error Mandelbrot::SetUp(MSet* m_set) {
 void Mandelbrot::TearDown(MSet* m_set) {
     assert(m_set != nullptr);
     
-    m_set->move_x = 0.0f;
-    m_set->move_y = 0.0f;
-    m_set->scale  = 0.0f;
+    m_set->move_x = 0.0;
+    m_set->move_y = 0.0;
+    m_set->scale  = 0.0;
     m_set->n_pixels = 0;
+    m_set->capacity = 0;
+    m_set->width    = 0;
+    m_set->height   = 0;
 
     if (m_set->pixels != nullptr) {
         free(m_set->pixels);
+        m_set->pixels = nullptr;
+    }
+
+    free(m_set->iter_counts);
+    free(m_set->magnitudes);
+    m_set->iter_counts = nullptr;
+    m_set->magnitudes  = nullptr;
+
+    DestroyThreadPool(m_set->pool);
+    m_set->pool = nullptr;
+
+    TearDownPalette(&m_set->palette);
+
+    free(m_set->orbit_x);
+    free(m_set->orbit_y);
+    m_set->orbit_x = nullptr;
+    m_set->orbit_y = nullptr;
+    m_set->orbit_capacity = 0;
+    m_set->orbit_len = 0;
+    m_set->rect_view.valid = false;
+
+    DestroyTileCache(m_set->tile_cache);
+    m_set->tile_cache = nullptr;
+}
+
+Mandelbrot::Error Mandelbrot::Resize(MSet* m_set, size_t width, size_t height) {
+    assert(m_set != nullptr);
+
+    if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX) {
+        return Error::kBadSize;
+    }
+
+    size_t n_pixels = 4 * width * height;
+    if (n_pixels > m_set->capacity) {
+        sf::Uint8* pixels = (sf::Uint8*)calloc(n_pixels, sizeof(sf::Uint8));
+        uint32_t* iter_counts = (uint32_t*)AllocBuffer(width * height * sizeof(uint32_t));
+        float* magnitudes = (float*)AllocBuffer(width * height * sizeof(float));
+        if (pixels == nullptr || iter_counts == nullptr || magnitudes == nullptr) {
+            free(pixels);
+            free(iter_counts);
+            free(magnitudes);
+            return Error::kBadAlloc;
+        }
+
+        free(m_set->pixels);
+        free(m_set->iter_counts);
+        free(m_set->magnitudes);
+        m_set->pixels      = pixels;
+        m_set->iter_counts = iter_counts;
+        m_set->magnitudes  = magnitudes;
+        m_set->capacity    = n_pixels;
+    }
+
+    m_set->n_pixels = n_pixels;
+    m_set->width    = width;
+    m_set->height   = height;
+
+    return Error::kOk;
+}
+
+Mandelbrot::Error Mandelbrot::SetThreadCount(MSet* m_set, size_t n_threads) {
+    assert(m_set != nullptr);
+
+    ThreadPool* pool = CreateThreadPool(n_threads);
+    if (pool == nullptr) {
+        return Error::kBadAlloc;
+    }
+
+    DestroyThreadPool(m_set->pool);
+    m_set->pool = pool;
+
+    return Error::kOk;
+}
+
+Mandelbrot::Viewport Mandelbrot::GetViewport(const MSet* m_set) {
+    assert(m_set != nullptr);
+
+    // keeps the old mapping: re = (scale * (x - width / 2) + move_x) * 4 / avg_side,
+    // that is move_x / scale - width / 2 steps from the deep center to pixel 0
+    double avg_side = (double)(m_set->width + m_set->height) / 2.0;
+
+    double fraction_x = 0.0;
+    double fraction_y = 0.0;
+
+    Viewport view = {};
+    view.step = m_set->scale * 4.0 / avg_side;
+    SplitOrigin(m_set->move_x / m_set->scale - (double)m_set->width  / 2.0, &view.origin_x, &fraction_x);
+    SplitOrigin(m_set->move_y / m_set->scale - (double)m_set->height / 2.0, &view.origin_y, &fraction_y);
+    view.x0   = HpToDouble(m_set->deep_x) + fraction_x * view.step;
+    view.y0   = HpToDouble(m_set->deep_y) + fraction_y * view.step;
+
+    return view;
+}
+
+Mandelbrot::Precision Mandelbrot::ChoosePrecision(const MSet* m_set, const Viewport& view) {
+    assert(m_set != nullptr);
+
+    double x_first = view.x0 + (double)view.origin_x * view.step;
+    double y_first = view.y0 + (double)view.origin_y * view.step;
+    double x_last  = x_first + (double)(m_set->width  - 1) * view.step;
+    double y_last  = y_first + (double)(m_set->height - 1) * view.step;
+    double magnitude = std::max(std::max(fabs(x_first), fabs(x_last)), 
+                                std::max(fabs(y_first), fabs(y_last)));
+
+    return PrecisionForStep(m_set, magnitude, view.step);
+}
+
+const char* Mandelbrot::PrecisionName(Precision precision) {
+    switch (precision) {
+        case Precision::kFloat:        return "f32";
+        case Precision::kDouble:       return "f64";
+        case Precision::kPerturbation: return "perturbation";
+        case Precision::kAuto:         return "auto";
+        default:                       return "unknown";
+    }
+}
+
+const char* Mandelbrot::FormulaName(Formula formula) {
+    switch (formula) {
+        case Formula::kMandelbrot:  return "mandelbrot";
+        case Formula::kJulia:       return "julia";
+        case Formula::kMultibrot3:  return "multibrot3";
+        case Formula::kMultibrot4:  return "multibrot4";
+        case Formula::kBurningShip: return "burning-ship";
+        default:                    return "unknown";
     }
 }
 
 void Mandelbrot::Compute(MSet* m_set) {
     assert(m_set != nullptr);
-    
-    [[maybe_unused]] uint64_t start_time = GetTime();
-
-#if defined(COMPUTE_NAIVE)
-    ComputeNaive(m_set);
-#elif defined(COMPUTE_ARRAY)
-    ComputeArray(m_set);
-#elif defined (COMPUTE_SIMD)
-    ComputeSimd(m_set);
+
+    Frame frame = {};
+    frame.m_set     = m_set;
+    frame.view      = GetViewport(m_set);
+    frame.precision = ChoosePrecision(m_set, frame.view);
+
+    if (frame.precision == Precision::kPerturbation) {
+        FoldView(m_set);
+        frame.view = GetViewport(m_set);
+    }
+
+    ShownView shown = DescribeView(m_set, frame);
+
+    int32_t shift_x = 0;
+    int32_t shift_y = 0;
+    bool shifted = FindShift(m_set->shown, shown, &shift_x, &shift_y);
+
+    bool same_view = shifted && shift_x == 0 && shift_y == 0;
+    bool refined = m_set->pass_step <= 1;
+
+    if (same_view && refined) {
+        m_set->n_iterated = 0;
+        m_set->n_samples  = 0;
+        return;
+    }
+
+    // blocks of a coarse frame would be shifted off the pass lattice
+    if (!refined && !same_view) {
+        shifted = false;
+    }
+
+    if (frame.precision == Precision::kPerturbation) {
+        // without an orbit buffer the frame is still drawn, just blocky
+        if (ComputeReferenceOrbit(m_set, &frame.orbit_len)) {
+            frame.orbit_x = m_set->orbit_x;
+            frame.orbit_y = m_set->orbit_y;
+            m_set->orbit_len = frame.orbit_len;
+        } else {
+            frame.precision = Precision::kDouble;
+            shown.precision = Precision::kDouble;
+        }
+    }
+
+    m_set->used_precision = frame.precision;
+    m_set->shown = shown;
+    m_set->rect_view.valid = false;
+    m_set->frame_id++;
+
+#if defined(KERNEL_STATS)
+    uint64_t start_ticks = __rdtsc();
 #endif
 
-    [[maybe_unused]] uint64_t end_time = GetTime();
-#if defined (LOG_TIME)    
-    fprintf(stdout, "%lu\n", end_time - start_time);
+    if (same_view) {
+        m_set->n_iterated = Refine(&frame, false);
+    } else if (shifted) {
+        ShiftPixels(m_set, shift_x, shift_y);
+        m_set->n_iterated = ComputeExposed(&frame, shift_x, shift_y);
+    } else if (m_set->progressive) {
+        m_set->n_iterated = Refine(&frame, true);
+    } else if (m_set->subdivide) {
+        size_t tiles_x = (m_set->width  + kSubdivideTileSide - 1) / kSubdivideTileSide;
+        size_t tiles_y = (m_set->height + kSubdivideTileSide - 1) / kSubdivideTileSide;
+
+        RunTasks(m_set->pool, tiles_x * tiles_y, SubdivideTileTask, &frame);
+        m_set->n_iterated = frame.n_iterated;
+        m_set->pass_step = 1;
+    } else if (m_set->tile_cache != nullptr && frame.precision != Precision::kPerturbation) {
+        ComputeCached(&frame);
+        m_set->n_iterated = frame.n_iterated;
+        m_set->pass_step = 1;
+    } else {
+        ComputeRegion(&frame, {0, 0, (int32_t)m_set->width, (int32_t)m_set->height}, ComputeTileTask, (int32_t)kTileHight);
+        m_set->n_iterated = m_set->width * m_set->height;
+        m_set->pass_step = 1;
+    }
+
+    // a coarse progressive frame is resampled once its last pass is done
+    if (m_set->antialias != Antialias::kOff && m_set->pass_step <= 1) {
+        if (shifted && !same_view) {
+            AntialiasExposed(&frame, shift_x, shift_y);
+        } else {
+            ComputeRegion(&frame, {0, 0, (int32_t)m_set->width, (int32_t)m_set->height}, AntialiasTileTask,
+                          (int32_t)kTileHight);
+        }
+    }
+    m_set->n_samples = frame.n_samples;
+
+#if defined(KERNEL_STATS)
+    frame.stats.frame_ticks = __rdtsc() - start_ticks;
+    m_set->stats = frame.stats;
 #endif
 }
 
-// static ---------------------------------------------------------------------
+void Mandelbrot::Invalidate(MSet* m_set) {
+    assert(m_set != nullptr);
+
+    m_set->shown.valid = false;
+}
 
-static void ColorPixel(Mandelbrot::MSet* m_set, uint8_t grad, int32_t pos) {
+void Mandelbrot::Recolor(MSet* m_set) {
     assert(m_set != nullptr);
-    
-    // uint32_t color[255] = {
-    //     #include "mcolor.h"
-    // };
 
-    // *(uint32_t*)&m_set.pixels[4 * pos] = color[grad % 256];
+    Frame frame = {};
+    frame.m_set = m_set;
+
+    ComputeRegion(&frame, {0, 0, (int32_t)m_set->width, (int32_t)m_set->height}, ColorizeTileTask,
+                  (int32_t)kTileHight);
 
-    m_set->pixels[4 * pos]     = grad;
-    m_set->pixels[4 * pos + 1] = grad;
-    m_set->pixels[4 * pos + 2] = grad;
-    m_set->pixels[4 * pos + 3] = 255;
+    // samples are not kept, they are taken again in the new colors
+    if (m_set->antialias != Antialias::kOff && m_set->pass_step <= 1 && m_set->shown.valid) {
+        frame.view      = m_set->shown.view;
+        frame.precision = m_set->shown.precision;
+        frame.orbit_x   = m_set->orbit_x;
+        frame.orbit_y   = m_set->orbit_y;
+        frame.orbit_len = m_set->orbit_len;
+
+        ComputeRegion(&frame, {0, 0, (int32_t)m_set->width, (int32_t)m_set->height}, AntialiasTileTask,
+                      (int32_t)kTileHight);
+    }
+    m_set->frame_id++;
 }
 
-static void ComputeNaive(Mandelbrot::MSet* m_set) {
+void Mandelbrot::ComputeRect(MSet* m_set, size_t x, size_t y, size_t width, size_t height) {
     assert(m_set != nullptr);
+    assert(x % kRegionAlign == 0);
+    assert(x + width <= m_set->width && y + height <= m_set->height);
 
-    for (int32_t y = 0; y < (int32_t)kWindowHight; y++) {
-        float tmp_y = m_set->scale * ((float)y - (float)kWindowHight / 2.0f) + m_set->move_y;
-        for (int32_t x = 0; x < (int32_t)kWindowWidth; x++) {  
-            float real = ((m_set->scale * ((float)x - (float)kWindowWidth / 2.0f) + m_set->move_x) * 4.0f) 
-                         / kWindowAvgSide;
-            float imag = ((tmp_y) * 4.0f) / kWindowAvgSide;
-            
-            uint8_t grad = CheckPixelNaive(real, imag);
-            ColorPixel(m_set, grad, y * (int32_t)kWindowWidth + x);
+    Frame frame = {};
+    frame.m_set     = m_set;
+    frame.view      = GetViewport(m_set);
+    frame.precision = ChoosePrecision(m_set, frame.view);
+
+    if (frame.precision == Precision::kPerturbation) {
+        FoldView(m_set);
+        frame.view = GetViewport(m_set);
+    }
+
+    ShownView shown = DescribeView(m_set, frame);
+
+    int32_t shift_x = 0;
+    int32_t shift_y = 0;
+    bool same_view = FindShift(m_set->rect_view, shown, &shift_x, &shift_y) && shift_x == 0 && shift_y == 0;
+
+    if (frame.precision == Precision::kPerturbation) {
+        if (same_view || ComputeReferenceOrbit(m_set, &m_set->orbit_len)) {
+            frame.orbit_x   = m_set->orbit_x;
+            frame.orbit_y   = m_set->orbit_y;
+            frame.orbit_len = m_set->orbit_len;
+        } else {
+            frame.precision = Precision::kDouble;
+            shown.precision = Precision::kDouble;
         }
     }
+
+    Tile rect = {(int32_t)x, (int32_t)y, (int32_t)(x + width), (int32_t)(y + height)};
+    ComputeRegion(&frame, rect, ComputeTileTask, (int32_t)kTileHight);
+
+    m_set->used_precision = frame.precision;
+    m_set->n_iterated = width * height;
+    m_set->n_samples  = 0;
+    m_set->rect_view  = shown;
+    m_set->shown.valid = false;
+    m_set->frame_id++;
+
+#if defined(KERNEL_STATS)
+    m_set->stats = frame.stats;
+#endif
+}
+
+void Mandelbrot::ComputeExpMap(MSet* m_set, const ExpMap& map, size_t first_row, size_t n_rows, uint32_t* pixels) {
+    assert(m_set != nullptr);
+    assert(pixels != nullptr);
+
+    if (n_rows == 0) {
+        return;
+    }
+
+    // the innermost row has the smallest cells, the outermost the largest coordinates
+    double outer_radius = ExpMapRadius(map, (double)first_row);
+    double inner_step   = ExpMapRadius(map, (double)(first_row + n_rows - 1)) * 2.0 * M_PI / (double)map.n_angles;
+
+    Viewport view = GetViewport(m_set);
+    double center_x = view.x0 + view.step * ((double)view.origin_x + (double)m_set->width  / 2.0);
+    double center_y = view.y0 + view.step * ((double)view.origin_y + (double)m_set->height / 2.0);
+    double magnitude = std::max(fabs(center_x), fabs(center_y)) + outer_radius;
+
+    Frame frame = {};
+    frame.m_set     = m_set;
+    frame.precision = PrecisionForStep(m_set, magnitude, inner_step);
+
+    if (frame.precision == Precision::kPerturbation) {
+        FoldView(m_set);
+        if (ComputeReferenceOrbit(m_set, &frame.orbit_len)) {
+            frame.orbit_x = m_set->orbit_x;
+            frame.orbit_y = m_set->orbit_y;
+            m_set->orbit_len = frame.orbit_len;
+        } else {
+            frame.precision = Precision::kDouble;
+        }
+
+        center_x = HpToDouble(m_set->deep_x);
+        center_y = HpToDouble(m_set->deep_y);
+    }
+
+    frame.view = {center_x, center_y, inner_step, 0, 0};
+
+    ExpRows rows = {&frame, &map, first_row, pixels};
+    RunTasks(m_set->pool, n_rows, ExpRowTask, &rows);
+
+    // reference orbit may be of another center now
+    m_set->shown.valid = false;
+    m_set->rect_view.valid = false;
+}
+
+// static ---------------------------------------------------------------------
+
+// task gets one kTileWidth x tile_hight tile of the region, see RegionTile
+static void ComputeRegion(Mandelbrot::Frame* frame, Mandelbrot::Tile region, Mandelbrot::TaskFunc task,
+                          int32_t tile_hight) {
+    assert(frame != nullptr);
+    assert(region.x_begin % kRegionAlign == 0);
+    assert(tile_hight > 0);
+
+    frame->region     = region;
+    frame->tile_hight = tile_hight;
+
+    size_t tiles_x = (size_t)(region.x_end - region.x_begin + (int32_t)kTileWidth - 1) / kTileWidth;
+    size_t tiles_y = (size_t)(region.y_end - region.y_begin + tile_hight - 1) / (size_t)tile_hight;
+
+    RunTasks(frame->m_set->pool, tiles_x * tiles_y, task, frame);
+}
+
+static Mandelbrot::Tile RegionTile(const Mandelbrot::Frame& frame, size_t task_id) {
+    Mandelbrot::Tile region = frame.region;
+    size_t tiles_x = (size_t)(region.x_end - region.x_begin + (int32_t)kTileWidth - 1) / kTileWidth;
+
+    Mandelbrot::Tile tile = {};
+    tile.x_begin = region.x_begin + (int32_t)((task_id % tiles_x) * kTileWidth);
+    tile.y_begin = region.y_begin + (int32_t)(task_id / tiles_x) * frame.tile_hight;
+    tile.x_end   = std::min(tile.x_begin + (int32_t)kTileWidth, region.x_end);
+    tile.y_end   = std::min(tile.y_begin + frame.tile_hight, region.y_end);
+
+    return tile;
+}
+
+static void ComputeTileTask(void* context, size_t task_id) {
+    assert(context != nullptr);
+
+    Mandelbrot::Frame* frame = (Mandelbrot::Frame*)context;
+    Mandelbrot::Tile tile = RegionTile(*frame, task_id);
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::BeginTileStats();
+#endif
+
+    Mandelbrot::ChooseTileKernel(*frame)(*frame, tile);
+    frame->m_set->kernels->colorize(frame->m_set, tile);
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::EndTileStats(&frame->stats, &frame->stats_lock);
+#endif
+}
+
+// same as ComputeTileTask, a tile found in the cache is only colored
+// cache tiles sit on the plane, not on the frame (see TileLead): the first ones start lead_x, lead_y pixels
+// before the frame and the frame edges cut them
+static void ComputeCached(Mandelbrot::Frame* frame) {
+    assert(frame != nullptr);
+
+    int32_t width  = (int32_t)frame->m_set->width;
+    int32_t height = (int32_t)frame->m_set->height;
+
+    int32_t lead_x = 0;
+    int32_t lead_y = 0;
+    Mandelbrot::TileLead(frame->view, &lead_x, &lead_y);
+
+    frame->region     = {-lead_x, -lead_y, width, height};
+    frame->tile_hight = (int32_t)kTileHight;
+
+    size_t tiles_x = (size_t)(lead_x + width  + (int32_t)kTileWidth - 1) / kTileWidth;
+    size_t tiles_y = (size_t)(lead_y + height + (int32_t)kTileHight - 1) / kTileHight;
+
+    RunTasks(frame->m_set->pool, tiles_x * tiles_y, CachedTileTask, frame);
 }
 
-static uint8_t CheckPixelNaive(float real, float imag) {
-    float x = 0.0f;
-    float y = 0.0f;
+// a tile the frame edge cuts is looked up whole and copied in part; on a miss only the part in view
+// is computed, and it is not stored
+static void CachedTileTask(void* context, size_t task_id) {
+    assert(context != nullptr);
 
-    uint32_t iter = 0;
+    Mandelbrot::Frame* frame = (Mandelbrot::Frame*)context;
+    Mandelbrot::MSet* m_set = frame->m_set;
 
-    float x_mul = 0;
-    float y_mul = 0;
+    Mandelbrot::Tile tile = RegionTile(*frame, task_id);
+    tile.x_end = tile.x_begin + (int32_t)kTileWidth;
+    tile.y_end = tile.y_begin + (int32_t)kTileHight;
 
-    while (x_mul + y_mul < 4.0f && iter <= Mandelbrot::kMaxIter) {
-        float x_temp = x_mul - y_mul + real;
-        y = 2.0f * x * y + imag;
-        x = x_temp;
+    Mandelbrot::Tile visible = {std::max(tile.x_begin, 0), std::max(tile.y_begin, 0),
+                                std::min(tile.x_end, (int32_t)m_set->width),
+                                std::min(tile.y_end, (int32_t)m_set->height)};
+    bool whole = visible.x_begin == tile.x_begin && visible.y_begin == tile.y_begin
+                 && visible.x_end == tile.x_end && visible.y_end == tile.y_end;
 
-        x_mul = x * x;
-        y_mul = y * y;
-        iter++;
+#if defined(KERNEL_STATS)
+    Mandelbrot::BeginTileStats();
+#endif
+
+    Mandelbrot::TileKey key = Mandelbrot::MakeTileKey(*frame, tile);
+    if (!Mandelbrot::LoadTile(m_set->tile_cache, key, m_set, tile)) {
+        Mandelbrot::ChooseTileKernel(*frame)(*frame, visible);
+        if (whole) {
+            Mandelbrot::StoreTile(m_set->tile_cache, key, m_set, tile);
+        }
+
+        size_t n_pixels = (size_t)(visible.x_end - visible.x_begin) * (size_t)(visible.y_end - visible.y_begin);
+        frame->n_iterated.fetch_add(n_pixels, std::memory_order_relaxed);
     }
+    m_set->kernels->colorize(m_set, visible);
 
-    return (uint8_t)(iter % 255);
+#if defined(KERNEL_STATS)
+    Mandelbrot::EndTileStats(&frame->stats, &frame->stats_lock);
+#endif
 }
 
-static void ComputeArray(Mandelbrot::MSet* m_set) {
-    assert(m_set != nullptr);
-    
-    float real[GROUP_SIZE] ALIGNE_YMM = {0};
-    float imag[GROUP_SIZE] ALIGNE_YMM = {0};
-    uint8_t grad[GROUP_SIZE] ALIGNE_YMM = {0};
-
-    for (int32_t y = 0; y < (int32_t)kWindowHight; y++) {
-        float tmp_y = ((m_set->scale * ((float)y - (float)kWindowHight / 2.0f) + m_set->move_y) * 4.0f) 
-                      / kWindowAvgSide;
-        for (int32_t x = 0; x < (int32_t)kWindowWidth; x += GROUP_SIZE) {
-            for (int32_t i = 0; i < GROUP_SIZE; i++) {
-                real[i] = ((m_set->scale * ((float)(x + i) - (float)kWindowWidth / 2.0f) + m_set->move_x) * 4.0f)
-                          / kWindowAvgSide;
-                imag[i] = tmp_y;
-            }
+static void SubdivideTileTask(void* context, size_t task_id) {
+    assert(context != nullptr);
+
+    Mandelbrot::Frame* frame = (Mandelbrot::Frame*)context;
+    Mandelbrot::MSet* m_set = frame->m_set;
+    size_t tiles_x = (m_set->width + kSubdivideTileSide - 1) / kSubdivideTileSide;
+
+    Mandelbrot::Tile tile = {};
+    tile.x_begin = (int32_t)((task_id % tiles_x) * kSubdivideTileSide);
+    tile.y_begin = (int32_t)((task_id / tiles_x) * kSubdivideTileSide);
+    tile.x_end   = std::min(tile.x_begin + (int32_t)kSubdivideTileSide, (int32_t)m_set->width);
+    tile.y_end   = std::min(tile.y_begin + (int32_t)kSubdivideTileSide, (int32_t)m_set->height);
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::BeginTileStats();
+#endif
+
+    size_t n_iterated = Mandelbrot::ComputeSubdivided(*frame, tile);
+    m_set->kernels->colorize(m_set, tile);
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::EndTileStats(&frame->stats, &frame->stats_lock);
+#endif
+
+    frame->n_iterated.fetch_add(n_iterated, std::memory_order_relaxed);
+}
+
+static void ColorizeTileTask(void* context, size_t task_id) {
+    assert(context != nullptr);
+
+    Mandelbrot::Frame* frame = (Mandelbrot::Frame*)context;
+    frame->m_set->kernels->colorize(frame->m_set, RegionTile(*frame, task_id));
+}
+
+static void ExpRowTask(void* context, size_t task_id) {
+    assert(context != nullptr);
+
+    ExpRows* rows = (ExpRows*)context;
+    Mandelbrot::ComputeExpRow(*rows->frame, *rows->map, rows->first_row + task_id,
+                              rows->pixels + task_id * rows->map->n_angles);
+}
+
+static void AntialiasTileTask(void* context, size_t task_id) {
+    assert(context != nullptr);
 
-            *(uint64_t*)grad = CheckPixelArray(real, imag);
-            
-            for (int32_t i = 0; i < GROUP_SIZE; i++) {
-                ColorPixel(m_set, grad[i], y * (int32_t)kWindowWidth + x + i);
+    Mandelbrot::Frame* frame = (Mandelbrot::Frame*)context;
+    size_t n_samples = Mandelbrot::ComputeAntialiased(*frame, RegionTile(*frame, task_id));
+
+    frame->n_samples.fetch_add(n_samples, std::memory_order_relaxed);
+}
+
+// coarse pass of a new view goes all at once, finer passes go tile row by tile row
+// until the budget is spent, so a frame costs about the budget however deep the view is;
+// pass tiles are only kProgressiveStep rows high, filling blocks of taller tiles
+// jumps over too many pages at once and costs more than iterating the points
+static size_t Refine(Mandelbrot::Frame* frame, bool restart) {
+    assert(frame != nullptr);
+
+    Mandelbrot::MSet* m_set = frame->m_set;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_set->frame_budget_ms);
+    bool has_budget = m_set->frame_budget_ms > 0;
+
+    int32_t width  = (int32_t)m_set->width;
+    int32_t height = (int32_t)m_set->height;
+
+    if (restart) {
+        frame->pass_step = (int32_t)kProgressiveStep;
+        ComputeRegion(frame, {0, 0, width, height}, PassTileTask, (int32_t)kProgressiveStep);
+
+        m_set->pass_step = kProgressiveStep;
+        m_set->pass_row  = 0;
+
+        if (!has_budget) {
+            return frame->n_iterated;
+        }
+    }
+
+    while (m_set->pass_step > 1) {
+        if (has_budget && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+
+        int32_t y_begin = (int32_t)(m_set->pass_row * kTileHight);
+        int32_t y_end   = std::min(y_begin + (int32_t)kTileHight, height);
+
+        frame->pass_step = (int32_t)m_set->pass_step / 2;
+        ComputeRegion(frame, {0, y_begin, width, y_end}, PassTileTask, (int32_t)kProgressiveStep);
+        m_set->pass_row++;
+
+        if (y_end == height) {
+            m_set->pass_step /= 2;
+            m_set->pass_row = 0;
+
+            if (!has_budget) {
+                break;
             }
         }
     }
+
+    return frame->n_iterated;
 }
 
-static uint64_t CheckPixelArray(float real[GROUP_SIZE], float imag[GROUP_SIZE]) {
-    float x[GROUP_SIZE] ALIGNE_YMM = {0};
-    float y[GROUP_SIZE] ALIGNE_YMM = {0};
+static void PassTileTask(void* context, size_t task_id) {
+    assert(context != nullptr);
 
-    uint32_t iter = 0;
-    uint32_t iter_count[GROUP_SIZE] ALIGNE_YMM = {0};
+    Mandelbrot::Frame* frame = (Mandelbrot::Frame*)context;
 
-    float x_temp[GROUP_SIZE] ALIGNE_YMM = {0};
-    float x_mul[GROUP_SIZE] ALIGNE_YMM = {0};
-    float y_mul[GROUP_SIZE] ALIGNE_YMM = {0};
+    Mandelbrot::Tile tile = RegionTile(*frame, task_id);
+
+#if defined(KERNEL_STATS)
+    Mandelbrot::BeginTileStats();
+#endif
 
-#define FOR_EACH_IN_GROUP for (int32_t i = 0; i < GROUP_SIZE; i++)
+    size_t n_iterated = Mandelbrot::ComputePass(*frame, tile);
+    frame->m_set->kernels->colorize(frame->m_set, tile);
 
-#if defined(__clang__)
-    #pragma nounroll
-#elif defined(__GNUG__)
-    #pragma GCC unroll 0
+#if defined(KERNEL_STATS)
+    Mandelbrot::EndTileStats(&frame->stats, &frame->stats_lock);
 #endif
-    while (iter <= Mandelbrot::kMaxIter) {
-        FOR_EACH_IN_GROUP x_mul[i] = x[i] * x[i];
-        FOR_EACH_IN_GROUP y_mul[i] = y[i] * y[i];
-        
-                          int check_rad = 0;
-        FOR_EACH_IN_GROUP check_rad += (x_mul[i] + y_mul[i] < 4.0f);
-                          if (check_rad == 0) { break; }
 
-        FOR_EACH_IN_GROUP iter_count[i] += (x_mul[i] + y_mul[i] < 4.0f);
+    frame->n_iterated.fetch_add(n_iterated, std::memory_order_relaxed);
+}
+
+// aligned_alloc wants the size to be a multiple of the alignment
+static void* AllocBuffer(size_t size) {
+    return aligned_alloc(kBufferAlign, (size + kBufferAlign - 1) / kBufferAlign * kBufferAlign);
+}
 
-        FOR_EACH_IN_GROUP x_temp[i] = x_mul[i] - y_mul[i] + real[i];
-        FOR_EACH_IN_GROUP y[i] = 2.0f * x[i] * y[i] + imag[i];
-        FOR_EACH_IN_GROUP x[i] = x_temp[i];
-        
-        iter++;
+// moves the double part of the center into deep, so panning keeps working at any zoom
+// float spacing near the coordinates is about magnitude * 2^-23, double one is 2^-52
+// perturbation only knows the mandelbrot formula, the others stay at double however deep the view is
+static Mandelbrot::Precision PrecisionForStep(const Mandelbrot::MSet* m_set, double magnitude, double step) {
+    assert(m_set != nullptr);
+
+    using Mandelbrot::Precision;
+
+    Precision precision = m_set->precision;
+    if (precision == Precision::kAuto) {
+        if (step < magnitude * kDoublePrecisionLimit) {
+            precision = Precision::kPerturbation;
+        } else {
+            precision = (step < magnitude * kFloatPrecisionLimit) ? Precision::kDouble : Precision::kFloat;
+        }
     }
 
-    uint8_t grad[GROUP_SIZE] ALIGNE_YMM = {0};
+    if (precision == Precision::kPerturbation && m_set->formula != Mandelbrot::Formula::kMandelbrot) {
+        return Precision::kDouble;
+    }
+
+    return precision;
+}
+
+static void FoldView(Mandelbrot::MSet* m_set) {
+    assert(m_set != nullptr);
 
-    FOR_EACH_IN_GROUP grad[i] = (uint8_t)(iter_count[i] % 255);
-#undef FOR_EACH_IN_GROUP
+    double avg_side = (double)(m_set->width + m_set->height) / 2.0;
 
-    return *(uint64_t*)grad;
+    m_set->deep_x = HpAdd(m_set->deep_x, HpFromDouble(m_set->move_x * 4.0 / avg_side));
+    m_set->deep_y = HpAdd(m_set->deep_y, HpFromDouble(m_set->move_y * 4.0 / avg_side));
+    m_set->move_x = 0.0;
+    m_set->move_y = 0.0;
 }
 
-static void ComputeSimd(Mandelbrot::MSet* m_set) {
+// orbit of the frame center in high precision, rounded to double for the pixel deltas
+static bool ComputeReferenceOrbit(Mandelbrot::MSet* m_set, size_t* orbit_len) {
     assert(m_set != nullptr);
-    
-    for (int32_t y = 0; y < (int32_t)kWindowHight; y++) {
-        float y_temp = ((m_set->scale * ((float)y - (float)kWindowHight / 2.0f) + m_set->move_y) * 4.0f) 
-                       / kWindowAvgSide;
-        for (int32_t x = 0; x < (int32_t)kWindowWidth; x += 8) {  
-            float x_temp = ((float)x - (float)kWindowWidth / 2.0f) + m_set->move_x / m_set->scale;
+    assert(orbit_len != nullptr);
 
-            __m256 real = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
-            real = _mm256_add_ps(real, _mm256_set1_ps(x_temp));
-            real = _mm256_mul_ps(real, _mm256_set1_ps((m_set->scale * 4.0f) / kWindowAvgSide));
+    size_t needed = m_set->max_iter + 2;
+    if (needed > m_set->orbit_capacity) {
+        free(m_set->orbit_x);
+        free(m_set->orbit_y);
 
-            __m256 imag = _mm256_set1_ps(y_temp);
+        m_set->orbit_x = (double*)calloc(needed, sizeof(double));
+        m_set->orbit_y = (double*)calloc(needed, sizeof(double));
+        m_set->orbit_capacity = needed;
 
-            uint64_t grad = CheckPixelSimd(real, imag);
-            uint8_t grad_arr[8] __attribute__((aligned(8)));
-            
-            memcpy(grad_arr, &grad, sizeof(grad));
+        if (m_set->orbit_x == nullptr || m_set->orbit_y == nullptr) {
+            free(m_set->orbit_x);
+            free(m_set->orbit_y);
+            m_set->orbit_x = nullptr;
+            m_set->orbit_y = nullptr;
+            m_set->orbit_capacity = 0;
 
-            for (int i = 0; i < 8; i++) {
-               ColorPixel(m_set, grad_arr[i], y * (int32_t)kWindowWidth + x + i); 
-            }
+            return false;
+        }
+    }
+
+    HpReal x = {};
+    HpReal y = {};
+    double bailout = m_set->escape_radius * m_set->escape_radius;
+
+    m_set->orbit_x[0] = 0.0;
+    m_set->orbit_y[0] = 0.0;
+
+    size_t iter = 1;
+    for (; iter <= m_set->max_iter + 1; iter++) {
+        HpReal x_mul = HpMul(x, x);
+        HpReal y_mul = HpMul(y, y);
+        HpReal xy    = HpMul(x, y);
+
+        x = HpAdd(HpSub(x_mul, y_mul), m_set->deep_x);
+        y = HpAdd(HpAdd(xy, xy), m_set->deep_y);
+
+        double orbit_x = HpToDouble(x);
+        double orbit_y = HpToDouble(y);
+        m_set->orbit_x[iter] = orbit_x;
+        m_set->orbit_y[iter] = orbit_y;
+
+        // escaped reference is still usable, pixels rebase when they reach its end
+        if (orbit_x * orbit_x + orbit_y * orbit_y > bailout) {
+            break;
         }
     }
+
+    *orbit_len = std::min(iter, m_set->max_iter + 1);
+
+    return true;
+}
+
+static Mandelbrot::ShownView DescribeView(const Mandelbrot::MSet* m_set, const Mandelbrot::Frame& frame) {
+    assert(m_set != nullptr);
+
+    Mandelbrot::ShownView shown = {};
+    shown.valid           = true;
+    shown.view            = frame.view;
+    shown.deep_x          = m_set->deep_x;
+    shown.deep_y          = m_set->deep_y;
+    shown.width           = m_set->width;
+    shown.height          = m_set->height;
+    shown.max_iter        = m_set->max_iter;
+    shown.escape_radius   = m_set->escape_radius;
+    shown.formula         = m_set->formula;
+    shown.julia_x         = m_set->julia_x;
+    shown.julia_y         = m_set->julia_y;
+    shown.precision       = frame.precision;
+    shown.kernels         = m_set->kernels;
+    shown.interior_checks = m_set->interior_checks;
+    shown.keep_magnitudes = m_set->keep_magnitudes;
+    shown.antialias       = m_set->antialias;
+
+    return shown;
+}
+
+// everything but the position
+static bool SameSettings(const Mandelbrot::ShownView& a, const Mandelbrot::ShownView& b) {
+    return a.valid && b.valid
+           && a.width == b.width && a.height == b.height && a.max_iter == b.max_iter
+           && SameDouble(a.escape_radius, b.escape_radius)
+           && a.formula == b.formula && SameDouble(a.julia_x, b.julia_x) && SameDouble(a.julia_y, b.julia_y)
+           && a.precision == b.precision && a.kernels == b.kernels 
+           && a.interior_checks == b.interior_checks && a.keep_magnitudes == b.keep_magnitudes
+           && a.antialias == b.antialias
+           && SameDouble(a.view.step, b.view.step);
+}
+
+static bool SameDouble(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
 }
 
-static uint64_t CheckPixelSimd(__m256 real, __m256 imag) {
-    __m256 x = _mm256_setzero_ps();
-    __m256 y = _mm256_setzero_ps();
+// pixels from the deep center to pixel 0, rounded to 1 / kViewQuant of a pixel,
+// as whole pixels and the fraction in [0, 1) left
+static void SplitOrigin(double pixels, int64_t* origin, double* fraction) {
+    assert(origin != nullptr);
+    assert(fraction != nullptr);
+
+    int64_t quants = llround(pixels * (double)kViewQuant);
+    int64_t whole  = quants / kViewQuant - ((quants % kViewQuant < 0) ? 1 : 0);
 
-    uint32_t iter = 0;
-    int check_rad = 0;
-    __m256i iter_count = _mm256_setzero_si256();
+    *origin   = whole;
+    *fraction = (double)(quants - whole * kViewQuant) / (double)kViewQuant;
+}
 
-    while (iter <= Mandelbrot::kMaxIter) {
-        __m256 x_mul = _mm256_mul_ps(x, x);
-        __m256 y_mul = _mm256_mul_ps(y, y);
-        __m256 mask = _mm256_cmp_ps(_mm256_add_ps(x_mul, y_mul), _mm256_set1_ps(4.0f), _CMP_LT_OQ);
-        
-        check_rad = _mm256_movemask_ps(mask); // wait to be 0
-        if (check_rad == 0) { break; }
+// new pixel (x, y) shows what old pixel (x + shift_x, y + shift_y) showed,
+// (0, 0) means the view did not change at all
+static bool FindShift(const Mandelbrot::ShownView& old_view, const Mandelbrot::ShownView& new_view,
+                      int32_t* shift_x, int32_t* shift_y) {
+    assert(shift_x != nullptr);
+    assert(shift_y != nullptr);
 
-        iter_count = _mm256_blendv_epi8(iter_count, 
-                                        _mm256_add_epi32(iter_count, _mm256_set1_epi32(1)), 
-                                        (__m256i)mask);
+    if (!SameSettings(old_view, new_view)) {
+        return false;
+    }
 
-        __m256  tmp_flt = _mm256_add_ps(_mm256_sub_ps(x_mul, y_mul), real);
-        y = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), _mm256_mul_ps(x, y)), imag);
-        x = tmp_flt;
+    bool same_deep = memcmp(&old_view.deep_x, &new_view.deep_x, sizeof(HpReal)) == 0
+                     && memcmp(&old_view.deep_y, &new_view.deep_y, sizeof(HpReal)) == 0;
 
-        iter++;
+    // another fraction of a step is another lattice, no pixel of the old one is on it
+    if (!same_deep || !SameDouble(old_view.view.x0, new_view.view.x0) 
+                   || !SameDouble(old_view.view.y0, new_view.view.y0)) {
+        return false;
     }
 
-    int* stored_iter ALIGNE_YMM = (int*)&iter_count;
-    _mm256_storeu_si256((__m256i*)stored_iter, iter_count);
+    int64_t moved_x = new_view.view.origin_x - old_view.view.origin_x;
+    int64_t moved_y = new_view.view.origin_y - old_view.view.origin_y;
 
-    uint8_t grad[8] ALIGNE_YMM = {0};
-    for (int i = 0; i < 8; i++) {
-        grad[i] = (uint8_t)(stored_iter[i] % 255);
+    // x0 of a perturbation frame does not resolve its own pixels
+    if ((moved_x != 0 || moved_y != 0) && new_view.precision == Mandelbrot::Precision::kPerturbation) {
+        return false;
     }
 
-    return *(uint64_t*)grad;
-}
\ No newline at end of file
+    if (llabs(moved_x) >= (int64_t)new_view.width || llabs(moved_y) >= (int64_t)new_view.height) {
+        return false;
+    }
+
+    *shift_x = (int32_t)moved_x;
+    *shift_y = (int32_t)moved_y;
+
+    return true;
+}
+
+// counts and |z|^2 move with the pixels, so Recolor still sees the whole frame
+static void ShiftPixels(Mandelbrot::MSet* m_set, int32_t shift_x, int32_t shift_y) {
+    assert(m_set != nullptr);
+
+    size_t width  = m_set->width;
+    size_t height = m_set->height;
+
+    ShiftRows(m_set->pixels, 4, width, height, shift_x, shift_y);
+    ShiftRows((uint8_t*)m_set->iter_counts, sizeof(uint32_t), width, height, shift_x, shift_y);
+    ShiftRows((uint8_t*)m_set->magnitudes, sizeof(float), width, height, shift_x, shift_y);
+}
+
+static void ShiftRows(uint8_t* buffer, size_t elem_size, size_t width, size_t height, int32_t shift_x, int32_t shift_y) {
+    assert(buffer != nullptr);
+
+    int32_t src_x = std::max(shift_x, 0);
+    int32_t dst_x = std::max(-shift_x, 0);
+    size_t row_bytes = elem_size * (width - (size_t)abs(shift_x));
+
+    // rows are walked away from the side they are copied to, so none is overwritten before it is read
+    for (int32_t i = 0; i < (int32_t)height - abs(shift_y); i++) {
+        int32_t dst_y = (shift_y >= 0) ? i : (int32_t)height - 1 - i;
+        int32_t src_y = dst_y + shift_y;
+
+        memmove(buffer + elem_size * ((size_t)dst_y * width + (size_t)dst_x),
+                buffer + elem_size * ((size_t)src_y * width + (size_t)src_x), row_bytes);
+    }
+}
+
+// strips the shift uncovered, the vertical one starts at a group boundary
+// and recomputes a few shifted pixels on the way
+static size_t ComputeExposed(Mandelbrot::Frame* frame, int32_t shift_x, int32_t shift_y) {
+    assert(frame != nullptr);
+
+    int32_t width  = (int32_t)frame->m_set->width;
+    int32_t height = (int32_t)frame->m_set->height;
+
+    size_t n_iterated = 0;
+
+    if (shift_x != 0) {
+        Mandelbrot::Tile strip = {0, 0, -shift_x, height};
+        if (shift_x > 0) {
+            strip = {(width - shift_x) / kRegionAlign * kRegionAlign, 0, width, height};
+        }
+
+        ComputeRegion(frame, strip, ComputeTileTask, (int32_t)kTileHight);
+        n_iterated += (size_t)(strip.x_end - strip.x_begin) * (size_t)height;
+    }
+
+    if (shift_y != 0) {
+        Mandelbrot::Tile strip = {0, 0, width, -shift_y};
+        if (shift_y > 0) {
+            strip = {0, height - shift_y, width, height};
+        }
+
+        ComputeRegion(frame, strip, ComputeTileTask, (int32_t)kTileHight);
+        n_iterated += (size_t)width * (size_t)(strip.y_end - strip.y_begin);
+    }
+
+    return n_iterated;
+}
+
+// shifted pixels keep their samples, only the exposed strips and the row or column next to them
+// are resampled, a pixel there may have become an edge against the new neighbours
+static void AntialiasExposed(Mandelbrot::Frame* frame, int32_t shift_x, int32_t shift_y) {
+    assert(frame != nullptr);
+
+    int32_t width  = (int32_t)frame->m_set->width;
+    int32_t height = (int32_t)frame->m_set->height;
+
+    if (shift_x != 0) {
+        Mandelbrot::Tile strip = {0, 0, std::min(-shift_x + 1, width), height};
+        if (shift_x > 0) {
+            strip = {std::max(width - shift_x - 1, 0) / kRegionAlign * kRegionAlign, 0, width, height};
+        }
+
+        ComputeRegion(frame, strip, AntialiasTileTask, (int32_t)kTileHight);
+    }
+
+    if (shift_y != 0) {
+        Mandelbrot::Tile strip = {0, 0, width, std::min(-shift_y + 1, height)};
+        if (shift_y > 0) {
+            strip = {0, std::max(height - shift_y - 1, 0), width, height};
+        }
+
+        ComputeRegion(frame, strip, AntialiasTileTask, (int32_t)kTileHight);
+    }
+}
@@ -0,0 +1,173 @@
+#include "palette.h"
+#include "config.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+// static ---------------------------------------------------------------------
+
+static_assert((kPaletteLutSize & (kPaletteLutSize - 1)) == 0, "palette lut size has to be a power of two");
+static_assert(kPaletteLutSize <= (1u << 16), "lut index has to fit in the integer part of 16.16 fixed point");
+
+static const uint32_t kMColors[] = {
+    #include "mcolor.h"
+};
+
+static const size_t kGrayColors = 255;
+static const size_t kMaxPaletteLine = 1024;
+
+static uint32_t ToPixel(uint32_t color);
+static uint32_t MixColors(uint32_t a, uint32_t b, double weight);
+static bool ReadPaletteFile(const char* path, uint32_t* colors, size_t* n_colors);
+
+// global ---------------------------------------------------------------------
+
+Mandelbrot::Error Mandelbrot::SetUpPalette(Palette* palette) {
+    assert(palette != nullptr);
+
+    palette->lut = (uint32_t*)aligned_alloc(kBufferAlign, kPaletteLutSize * sizeof(uint32_t));
+    if (palette->lut == nullptr) {
+        return Error::kBadAlloc;
+    }
+
+    palette->offset   = 0;
+    palette->interior = ToPixel(kInteriorColor);
+    palette->smooth   = false;
+
+    SetPalette(palette, kMColors, sizeof(kMColors) / sizeof(kMColors[0]));
+
+    return Error::kOk;
+}
+
+void Mandelbrot::TearDownPalette(Palette* palette) {
+    assert(palette != nullptr);
+
+    free(palette->lut);
+    palette->lut = nullptr;
+}
+
+void Mandelbrot::SetPalette(Palette* palette, const uint32_t* colors, size_t n_colors) {
+    assert(palette != nullptr);
+    assert(palette->lut != nullptr);
+    assert(colors != nullptr);
+    assert(n_colors > 0 && n_colors <= kMaxPaletteColors);
+
+    // count * step wraps at 2^32 exactly where the lut wraps, so counts never have to be taken modulo
+    palette->step = (uint32_t)(((uint64_t)kPaletteLutSize << 16) / n_colors);
+
+    for (size_t i = 0; i < kPaletteLutSize; i++) {
+        double position = (double)i * (double)n_colors / (double)kPaletteLutSize;
+        size_t first = (size_t)position;
+
+        palette->lut[i] = ToPixel(MixColors(colors[first], colors[(first + 1) % n_colors], position - (double)first));
+    }
+}
+
+Mandelbrot::Error Mandelbrot::LoadPalette(Palette* palette, const char* name) {
+    assert(palette != nullptr);
+    assert(name != nullptr);
+
+    if (strcmp(name, "mcolor") == 0) {
+        SetPalette(palette, kMColors, sizeof(kMColors) / sizeof(kMColors[0]));
+        return Error::kOk;
+    }
+
+    uint32_t* colors = (uint32_t*)calloc(kMaxPaletteColors, sizeof(uint32_t));
+    if (colors == nullptr) {
+        return Error::kBadAlloc;
+    }
+
+    size_t n_colors = 0;
+    if (strcmp(name, "gray") == 0) {
+        for (; n_colors < kGrayColors; n_colors++) {
+            colors[n_colors] = ((uint32_t)n_colors * 0x01010100u) | 0xFFu;
+        }
+    } else if (!ReadPaletteFile(name, colors, &n_colors)) {
+        free(colors);
+        return Error::kBadFile;
+    }
+
+    SetPalette(palette, colors, n_colors);
+    free(colors);
+
+    return Error::kOk;
+}
+
+void Mandelbrot::CyclePalette(Palette* palette, double n_iterations) {
+    assert(palette != nullptr);
+
+    // negative shifts wrap around like the counts do
+    palette->offset += (uint32_t)(int64_t)lround(n_iterations * (double)palette->step);
+}
+
+// static ---------------------------------------------------------------------
+
+// 0xRRGGBBAA to the byte order of MSet::pixels
+static uint32_t ToPixel(uint32_t color) {
+    return __builtin_bswap32(color);
+}
+
+static uint32_t MixColors(uint32_t a, uint32_t b, double weight) {
+    uint32_t mixed = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        double channel_a = (double)((a >> shift) & 0xFFu);
+        double channel_b = (double)((b >> shift) & 0xFFu);
+
+        mixed |= (uint32_t)lround(channel_a + (channel_b - channel_a) * weight) << shift;
+    }
+
+    return mixed;
+}
+
+static bool ReadPaletteFile(const char* path, uint32_t* colors, size_t* n_colors) {
+    assert(path != nullptr);
+    assert(colors != nullptr);
+    assert(n_colors != nullptr);
+
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "# Error: can not open palette %s\n", path);
+        return false;
+    }
+
+    char line[kMaxPaletteLine] = {};
+    size_t line_number = 0;
+    bool ok = true;
+
+    *n_colors = 0;
+    while (ok && fgets(line, sizeof(line), file) != nullptr) {
+        line_number++;
+
+        const char* token = line + strspn(line, " \t");
+        if (*token == '#') {
+            continue;
+        }
+
+        while (ok) {
+            token += strspn(token, " \t,\r\n");
+            if (*token == '\0') {
+                break;
+            }
+
+            char* end = nullptr;
+            unsigned long color = strtoul(token, &end, 16);
+            if (end == token || color > UINT32_MAX || *n_colors == kMaxPaletteColors) {
+                fprintf(stderr, "# Error: %s:%zu: bad color or more than %zu colors\n",
+                        path, line_number, kMaxPaletteColors);
+                ok = false;
+            } else {
+                colors[(*n_colors)++] = (uint32_t)color;
+                token = end;
+            }
+        }
+    }
+
+    fclose(file);
+
+    if (ok && *n_colors == 0) {
+        fprintf(stderr, "# Error: palette %s has no colors\n", path);
+        ok = false;
+    }
+
+    return ok;
+}
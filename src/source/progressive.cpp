@@ -0,0 +1,117 @@
+#include "progressive.h"
+#include "config.h"
+
+#include <algorithm>
+
+// static ---------------------------------------------------------------------
+
+static const size_t kBatchSize = 256;
+
+static_assert(kTileWidth % kProgressiveStep == 0 && kTileHight % kProgressiveStep == 0,
+              "tiles have to be made of whole coarse blocks");
+
+struct PassBatch {
+    const Mandelbrot::Frame* frame;
+    Mandelbrot::PointKernel kernel;
+    Mandelbrot::Tile tile;
+
+    Mandelbrot::Point points[kBatchSize];
+    uint32_t iter_count[kBatchSize];
+    float magnitude[kBatchSize];
+    size_t n_points;
+
+    size_t n_iterated;
+};
+
+static void AddPoint(PassBatch* batch, int32_t x, int32_t y);
+static void FlushBatch(PassBatch* batch);
+static void FillBlock(const PassBatch* batch, Mandelbrot::Point point, uint32_t count, float magnitude);
+
+// global ---------------------------------------------------------------------
+
+size_t Mandelbrot::ComputePass(const Frame& frame, Tile tile) {
+    assert(frame.m_set != nullptr);
+    assert(frame.pass_step > 0);
+
+    int32_t step = frame.pass_step;
+    bool first_pass = (step == (int32_t)kProgressiveStep);
+
+    // three pixels in four are new in the last pass, the tile kernel takes the whole tile in full
+    // vectors for less than the point kernel takes them alone; the known quarter comes out the same
+    if (step == 1 && !first_pass) {
+        ChooseTileKernel(frame)(frame, tile);
+        return (size_t)(tile.x_end - tile.x_begin) * (size_t)(tile.y_end - tile.y_begin);
+    }
+
+    PassBatch batch = {};
+    batch.frame  = &frame;
+    batch.kernel = ChoosePointKernel(frame);
+    batch.tile   = tile;
+
+    for (int32_t y = tile.y_begin; y < tile.y_end; y += step) {
+        bool lattice_row = (y % (2 * step) == 0);
+
+        for (int32_t x = tile.x_begin; x < tile.x_end; x += step) {
+            // lattice of the previous pass is already there
+            if (!first_pass && lattice_row && x % (2 * step) == 0) {
+                continue;
+            }
+
+            AddPoint(&batch, x, y);
+        }
+    }
+
+    FlushBatch(&batch);
+
+    return batch.n_iterated;
+}
+
+// static ---------------------------------------------------------------------
+
+static void AddPoint(PassBatch* batch, int32_t x, int32_t y) {
+    assert(batch != nullptr);
+
+    if (batch->n_points == kBatchSize) {
+        FlushBatch(batch);
+    }
+
+    batch->points[batch->n_points] = {x, y};
+    batch->n_points++;
+}
+
+static void FlushBatch(PassBatch* batch) {
+    assert(batch != nullptr);
+
+    if (batch->n_points == 0) {
+        return;
+    }
+
+    batch->kernel(*batch->frame, batch->points, batch->n_points, batch->iter_count, batch->magnitude);
+
+    for (size_t i = 0; i < batch->n_points; i++) {
+        FillBlock(batch, batch->points[i], batch->iter_count[i], batch->magnitude[i]);
+    }
+
+    batch->n_iterated += batch->n_points;
+    batch->n_points = 0;
+}
+
+// the point stands for the block right and down of it until a finer pass replaces it
+static void FillBlock(const PassBatch* batch, Mandelbrot::Point point, uint32_t count, float magnitude) {
+    assert(batch != nullptr);
+
+    Mandelbrot::MSet* m_set = batch->frame->m_set;
+    int32_t step = batch->frame->pass_step;
+
+    int32_t x_end = std::min(point.x + step, batch->tile.x_end);
+    int32_t y_end = std::min(point.y + step, batch->tile.y_end);
+
+    size_t pos = (size_t)point.y * m_set->width + (size_t)point.x;
+
+    for (int32_t y = point.y; y < y_end; y++) {
+        std::fill_n(m_set->iter_counts + pos, x_end - point.x, count);
+        std::fill_n(m_set->magnitudes  + pos, x_end - point.x, magnitude);
+
+        pos += m_set->width;
+    }
+}
@@ -0,0 +1,128 @@
+#include "stats.h"
+
+#include <x86intrin.h>
+#include <algorithm>
+
+// static ---------------------------------------------------------------------
+
+// vectors a pool thread recorded in its current tile, kernels have no place of their own to keep them
+static thread_local Mandelbrot::KernelStats tile_stats = {};
+static thread_local uint64_t tile_start = 0;
+
+static size_t HistogramBin(uint32_t count);
+static double Percent(uint64_t part, uint64_t total);
+
+// global ---------------------------------------------------------------------
+
+void Mandelbrot::ResetStats(KernelStats* stats) {
+    assert(stats != nullptr);
+
+    *stats = {};
+}
+
+void Mandelbrot::AddStats(KernelStats* total, const KernelStats& part) {
+    assert(total != nullptr);
+
+    total->n_vectors       += part.n_vectors;
+    total->n_trips         += part.n_trips;
+    total->lane_slots      += part.lane_slots;
+    total->lane_iterations += part.lane_iterations;
+    total->partial_trips   += part.partial_trips;
+    total->n_interior      += part.n_interior;
+
+    for (size_t i = 0; i < kStatsBins; i++) {
+        total->histogram[i] += part.histogram[i];
+    }
+
+    total->n_tiles        += part.n_tiles;
+    total->tile_ticks     += part.tile_ticks;
+    total->max_tile_ticks  = std::max(total->max_tile_ticks, part.max_tile_ticks);
+    total->frame_ticks    += part.frame_ticks;
+}
+
+void Mandelbrot::PrintStats(FILE* stream, const KernelStats& stats) {
+    assert(stream != nullptr);
+
+    fprintf(stream, "# stats: %lu vectors, %lu trips, %lu iterations, lane utilization %.1f%%, "
+                    "partial trips %.1f%%, interior lanes %lu\n",
+            stats.n_vectors, stats.n_trips, stats.lane_iterations, Percent(stats.lane_iterations, stats.lane_slots),
+            Percent(stats.partial_trips, stats.n_trips), stats.n_interior);
+
+    // max over mean is how much longer the last tile keeps its thread than an average one
+    double mean_ticks = (stats.n_tiles > 0) ? (double)stats.tile_ticks / (double)stats.n_tiles : 0.0;
+    fprintf(stream, "# stats: %lu tiles, %.0f ticks mean, %lu max (%.1fx mean), frame %lu ticks\n",
+            stats.n_tiles, mean_ticks, stats.max_tile_ticks,
+            (mean_ticks > 0.0) ? (double)stats.max_tile_ticks / mean_ticks : 0.0, stats.frame_ticks);
+
+    fprintf(stream, "# stats: escaped by count:");
+    for (size_t i = 0; i < kStatsBins; i++) {
+        if (stats.histogram[i] != 0) {
+            fprintf(stream, " <%lu:%lu", (i == 0) ? 1lu : 1lu << i, stats.histogram[i]);
+        }
+    }
+    fprintf(stream, "\n");
+}
+
+void Mandelbrot::RecordVector(const uint32_t* active, const uint32_t* counts, size_t n_lanes, size_t max_iter) {
+    assert(active != nullptr);
+    assert(counts != nullptr);
+    assert(n_lanes > 0);
+
+    uint32_t min_active = active[0];
+    uint32_t max_active = active[0];
+
+    for (size_t i = 0; i < n_lanes; i++) {
+        min_active = std::min(min_active, active[i]);
+        max_active = std::max(max_active, active[i]);
+
+        RecordPixel(active[i], counts[i], max_iter);
+    }
+
+    RecordTrips(max_active, max_active - min_active, n_lanes);
+}
+
+void Mandelbrot::RecordPixel(uint32_t active, uint32_t count, size_t max_iter) {
+    tile_stats.lane_iterations += active;
+
+    if (count > max_iter) {
+        tile_stats.n_interior++;
+    } else {
+        tile_stats.histogram[HistogramBin(count)]++;
+    }
+}
+
+void Mandelbrot::RecordTrips(uint64_t n_trips, uint64_t partial_trips, size_t n_lanes) {
+    tile_stats.n_vectors++;
+    tile_stats.n_trips       += n_trips;
+    tile_stats.lane_slots    += n_trips * n_lanes;
+    tile_stats.partial_trips += partial_trips;
+}
+
+void Mandelbrot::BeginTileStats() {
+    tile_stats = {};
+    tile_start = __rdtsc();
+}
+
+void Mandelbrot::EndTileStats(KernelStats* stats, std::mutex* lock) {
+    assert(stats != nullptr);
+    assert(lock != nullptr);
+
+    uint64_t ticks = __rdtsc() - tile_start;
+
+    tile_stats.n_tiles        = 1;
+    tile_stats.tile_ticks     = ticks;
+    tile_stats.max_tile_ticks = ticks;
+
+    std::lock_guard<std::mutex> guard(*lock);
+    AddStats(stats, tile_stats);
+}
+
+// static ---------------------------------------------------------------------
+
+static size_t HistogramBin(uint32_t count) {
+    return (count == 0) ? 0 : 32 - (size_t)__builtin_clz(count);
+}
+
+static double Percent(uint64_t part, uint64_t total) {
+    return (total > 0) ? 100.0 * (double)part / (double)total : 0.0;
+}
@@ -0,0 +1,263 @@
+#include "subdivide.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+// static ---------------------------------------------------------------------
+
+static const size_t kBatchSize = 256;
+
+// pixels waiting for the point kernel, grouped so that even single pixel columns fill whole vectors
+struct PointBatch {
+    const Mandelbrot::Frame* frame;
+    Mandelbrot::PointKernel kernel;
+
+    Mandelbrot::Point points[kBatchSize];
+    uint32_t iter_count[kBatchSize];
+    float magnitude[kBatchSize];
+    size_t n_points;
+
+    size_t n_iterated;
+};
+
+// inclusive bounds
+struct Rect {
+    int32_t x0;
+    int32_t y0;
+    int32_t x1;
+    int32_t y1;
+};
+
+// rectangles of one subdivision level, their borders are computed before any of them is looked at
+struct RectList {
+    Rect* rects;
+    size_t n_rects;
+    size_t capacity;
+};
+
+static void AddPoint(PointBatch* batch, int32_t x, int32_t y);
+static void AddRow(PointBatch* batch, int32_t y, int32_t x_begin, int32_t x_end);
+static void AddColumn(PointBatch* batch, int32_t x, int32_t y_begin, int32_t y_end);
+static void FlushBatch(PointBatch* batch);
+
+static bool PushRect(RectList* list, Rect rect);
+static void AddInterior(PointBatch* batch, Rect rect);
+
+static void SubdivideRect(PointBatch* batch, Rect rect, RectList* next);
+static bool UniformBorder(const Mandelbrot::MSet* m_set, Rect rect, uint32_t* count);
+static void FillInterior(Mandelbrot::MSet* m_set, Rect rect, uint32_t count);
+
+// global ---------------------------------------------------------------------
+
+size_t Mandelbrot::ComputeSubdivided(const Frame& frame, Tile tile) {
+    assert(frame.m_set != nullptr);
+    assert(frame.m_set->iter_counts != nullptr);
+
+    PointBatch batch = {};
+    batch.frame  = &frame;
+    batch.kernel = Mandelbrot::ChoosePointKernel(frame);
+
+    Rect rect = {tile.x_begin, tile.y_begin, tile.x_end - 1, tile.y_end - 1};
+
+    AddRow(&batch, rect.y0, rect.x0, rect.x1 + 1);
+    if (rect.y1 != rect.y0) {
+        AddRow(&batch, rect.y1, rect.x0, rect.x1 + 1);
+    }
+
+    AddColumn(&batch, rect.x0, rect.y0 + 1, rect.y1);
+    if (rect.x1 != rect.x0) {
+        AddColumn(&batch, rect.x1, rect.y0 + 1, rect.y1);
+    }
+
+    FlushBatch(&batch);
+
+    // level by level, so short split lines of many small rectangles share full vectors
+    RectList current = {};
+    RectList next = {};
+
+    if (!PushRect(&current, rect)) {
+        AddInterior(&batch, rect);
+    }
+
+    while (current.n_rects > 0) {
+        for (size_t i = 0; i < current.n_rects; i++) {
+            SubdivideRect(&batch, current.rects[i], &next);
+        }
+        FlushBatch(&batch);
+
+        RectList done = current;
+        current = next;
+        next = done;
+        next.n_rects = 0;
+    }
+
+    free(current.rects);
+    free(next.rects);
+
+    return batch.n_iterated;
+}
+
+// static ---------------------------------------------------------------------
+
+static void AddPoint(PointBatch* batch, int32_t x, int32_t y) {
+    assert(batch != nullptr);
+
+    if (batch->n_points == kBatchSize) {
+        FlushBatch(batch);
+    }
+
+    batch->points[batch->n_points] = {x, y};
+    batch->n_points++;
+}
+
+// [x_begin, x_end)
+static void AddRow(PointBatch* batch, int32_t y, int32_t x_begin, int32_t x_end) {
+    for (int32_t x = x_begin; x < x_end; x++) {
+        AddPoint(batch, x, y);
+    }
+}
+
+// [y_begin, y_end)
+static void AddColumn(PointBatch* batch, int32_t x, int32_t y_begin, int32_t y_end) {
+    for (int32_t y = y_begin; y < y_end; y++) {
+        AddPoint(batch, x, y);
+    }
+}
+
+static void FlushBatch(PointBatch* batch) {
+    assert(batch != nullptr);
+
+    if (batch->n_points == 0) {
+        return;
+    }
+
+    Mandelbrot::MSet* m_set = batch->frame->m_set;
+    batch->kernel(*batch->frame, batch->points, batch->n_points, batch->iter_count, batch->magnitude);
+
+    for (size_t i = 0; i < batch->n_points; i++) {
+        size_t pos = (size_t)batch->points[i].y * m_set->width + (size_t)batch->points[i].x;
+
+        m_set->iter_counts[pos] = batch->iter_count[i];
+        m_set->magnitudes[pos]  = batch->magnitude[i];
+    }
+
+    batch->n_iterated += batch->n_points;
+    batch->n_points = 0;
+}
+
+static bool PushRect(RectList* list, Rect rect) {
+    assert(list != nullptr);
+
+    if (list->n_rects == list->capacity) {
+        size_t capacity = (list->capacity == 0) ? 64 : 2 * list->capacity;
+        Rect* rects = (Rect*)realloc(list->rects, capacity * sizeof(Rect));
+        if (rects == nullptr) {
+            return false;
+        }
+
+        list->rects    = rects;
+        list->capacity = capacity;
+    }
+
+    list->rects[list->n_rects] = rect;
+    list->n_rects++;
+
+    return true;
+}
+
+static void AddInterior(PointBatch* batch, Rect rect) {
+    for (int32_t y = rect.y0 + 1; y < rect.y1; y++) {
+        AddRow(batch, y, rect.x0 + 1, rect.x1);
+    }
+}
+
+// border of rect is already computed, the split line goes to batch and both halves to next
+static void SubdivideRect(PointBatch* batch, Rect rect, RectList* next) {
+    assert(batch != nullptr);
+    assert(next != nullptr);
+
+    int32_t inner_width  = rect.x1 - rect.x0 - 1;
+    int32_t inner_height = rect.y1 - rect.y0 - 1;
+    if (inner_width <= 0 || inner_height <= 0) {
+        return;
+    }
+
+    Mandelbrot::MSet* m_set = batch->frame->m_set;
+
+    // escaped pixels with one count still have different |z|^2, smooth colors would show the fill,
+    // so with keep_magnitudes only rectangles inside the set are filled
+    uint32_t count = 0;
+    if (UniformBorder(m_set, rect, &count) && (!m_set->keep_magnitudes || count > m_set->max_iter)) {
+        FillInterior(m_set, rect, count);
+        return;
+    }
+
+    // splitting further costs more border than it can save
+    if (inner_width * inner_height <= (int32_t)kSubdivideMinArea) {
+        AddInterior(batch, rect);
+        return;
+    }
+
+    Rect first  = rect;
+    Rect second = rect;
+
+    if (inner_width >= inner_height) {
+        int32_t x_mid = (rect.x0 + rect.x1) / 2;
+        AddColumn(batch, x_mid, rect.y0 + 1, rect.y1);
+        first.x1  = x_mid;
+        second.x0 = x_mid;
+    } else {
+        int32_t y_mid = (rect.y0 + rect.y1) / 2;
+        AddRow(batch, y_mid, rect.x0 + 1, rect.x1);
+        first.y1  = y_mid;
+        second.y0 = y_mid;
+    }
+
+    // without memory for the next level the halves are just computed whole
+    if (!PushRect(next, first)) {
+        AddInterior(batch, first);
+    }
+    if (!PushRect(next, second)) {
+        AddInterior(batch, second);
+    }
+}
+
+static bool UniformBorder(const Mandelbrot::MSet* m_set, Rect rect, uint32_t* count) {
+    assert(m_set != nullptr);
+    assert(count != nullptr);
+
+    const uint32_t* top    = m_set->iter_counts + (size_t)rect.y0 * m_set->width;
+    const uint32_t* bottom = m_set->iter_counts + (size_t)rect.y1 * m_set->width;
+
+    uint32_t first = top[rect.x0];
+    for (int32_t x = rect.x0; x <= rect.x1; x++) {
+        if (top[x] != first || bottom[x] != first) {
+            return false;
+        }
+    }
+
+    for (int32_t y = rect.y0 + 1; y < rect.y1; y++) {
+        const uint32_t* row = m_set->iter_counts + (size_t)y * m_set->width;
+        if (row[rect.x0] != first || row[rect.x1] != first) {
+            return false;
+        }
+    }
+
+    *count = first;
+
+    return true;
+}
+
+// filled pixels take |z|^2 of the corner too, it is 0 inside the set and not kept outside it
+static void FillInterior(Mandelbrot::MSet* m_set, Rect rect, uint32_t count) {
+    assert(m_set != nullptr);
+
+    float magnitude = m_set->magnitudes[(size_t)rect.y0 * m_set->width + (size_t)rect.x0];
+
+    for (int32_t y = rect.y0 + 1; y < rect.y1; y++) {
+        size_t row = (size_t)y * m_set->width;
+
+        std::fill_n(m_set->iter_counts + row + rect.x0 + 1, rect.x1 - rect.x0 - 1, count);
+        std::fill_n(m_set->magnitudes  + row + rect.x0 + 1, rect.x1 - rect.x0 - 1, magnitude);
+    }
+}
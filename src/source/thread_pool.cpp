@@ -0,0 +1,240 @@
+#include "thread_pool.h"
+
+#include <assert.h>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// static ---------------------------------------------------------------------
+
+// tasks owned by one worker: owner takes from begin, thieves cut from end
+struct alignas(64) TaskRange {
+    std::mutex lock;
+    size_t begin;
+    size_t end;
+};
+
+struct Mandelbrot::ThreadPool {
+    size_t n_threads;
+    std::thread* workers; // n_threads - 1, worker 0 is the caller of RunTasks
+    TaskRange* ranges;    // n_threads
+
+    std::mutex lock;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+
+    size_t generation;
+    size_t n_running;
+    bool quit;
+
+    TaskFunc func;
+    void* context;
+};
+
+static void WorkerLoop(Mandelbrot::ThreadPool* pool, size_t worker_id);
+static void RunWorker(Mandelbrot::ThreadPool* pool, size_t worker_id);
+static bool TakeOwnTask(TaskRange* range, size_t* task_id);
+static bool StealTasks(Mandelbrot::ThreadPool* pool, size_t thief_id, size_t* task_id);
+
+// global ---------------------------------------------------------------------
+
+Mandelbrot::ThreadPool* Mandelbrot::CreateThreadPool(size_t n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::thread::hardware_concurrency();
+    }
+    if (n_threads == 0) {
+        n_threads = 1;
+    }
+
+    ThreadPool* pool = new (std::nothrow) ThreadPool;
+    if (pool == nullptr) {
+        return nullptr;
+    }
+
+    pool->ranges = new (std::nothrow) TaskRange[n_threads];
+    if (pool->ranges == nullptr) {
+        delete pool;
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < n_threads; i++) {
+        pool->ranges[i].begin = 0;
+        pool->ranges[i].end   = 0;
+    }
+
+    pool->n_threads  = n_threads;
+    pool->generation = 0;
+    pool->n_running  = 0;
+    pool->quit       = false;
+    pool->func       = nullptr;
+    pool->context    = nullptr;
+
+    pool->workers = new (std::nothrow) std::thread[n_threads - 1];
+    if (pool->workers == nullptr) {
+        delete[] pool->ranges;
+        delete pool;
+        return nullptr;
+    }
+
+    for (size_t i = 1; i < n_threads; i++) {
+        pool->workers[i - 1] = std::thread(WorkerLoop, pool, i);
+    }
+
+    return pool;
+}
+
+void Mandelbrot::DestroyThreadPool(ThreadPool* pool) {
+    if (pool == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->quit = true;
+    }
+    pool->job_ready.notify_all();
+
+    for (size_t i = 0; i + 1 < pool->n_threads; i++) {
+        pool->workers[i].join();
+    }
+
+    delete[] pool->workers;
+    delete[] pool->ranges;
+    delete pool;
+}
+
+size_t Mandelbrot::ThreadCount(const ThreadPool* pool) {
+    assert(pool != nullptr);
+
+    return pool->n_threads;
+}
+
+void Mandelbrot::RunTasks(ThreadPool* pool, size_t n_tasks, TaskFunc func, void* context) {
+    assert(pool != nullptr);
+    assert(func != nullptr);
+
+    if (pool->n_threads == 1) {
+        for (size_t task_id = 0; task_id < n_tasks; task_id++) {
+            func(context, task_id);
+        }
+
+        return;
+    }
+
+    // contiguous chunks keep neighbouring tiles on one core, stealing fixes the imbalance
+    for (size_t i = 0; i < pool->n_threads; i++) {
+        std::lock_guard<std::mutex> guard(pool->ranges[i].lock);
+        pool->ranges[i].begin = n_tasks * i / pool->n_threads;
+        pool->ranges[i].end   = n_tasks * (i + 1) / pool->n_threads;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->func      = func;
+        pool->context   = context;
+        pool->n_running = pool->n_threads - 1;
+        pool->generation++;
+    }
+    pool->job_ready.notify_all();
+
+    RunWorker(pool, 0);
+
+    std::unique_lock<std::mutex> guard(pool->lock);
+    pool->job_done.wait(guard, [pool] { return pool->n_running == 0; });
+}
+
+// static ---------------------------------------------------------------------
+
+static void WorkerLoop(Mandelbrot::ThreadPool* pool, size_t worker_id) {
+    assert(pool != nullptr);
+
+    size_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(pool->lock);
+            pool->job_ready.wait(guard, [pool, seen_generation] {
+                return pool->quit || pool->generation != seen_generation;
+            });
+
+            if (pool->quit) {
+                return;
+            }
+
+            seen_generation = pool->generation;
+        }
+
+        RunWorker(pool, worker_id);
+
+        bool last = false;
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            pool->n_running--;
+            last = (pool->n_running == 0);
+        }
+
+        if (last) {
+            pool->job_done.notify_one();
+        }
+    }
+}
+
+static void RunWorker(Mandelbrot::ThreadPool* pool, size_t worker_id) {
+    assert(pool != nullptr);
+
+    size_t task_id = 0;
+    while (TakeOwnTask(&pool->ranges[worker_id], &task_id)
+           || StealTasks(pool, worker_id, &task_id)) {
+        pool->func(pool->context, task_id);
+    }
+}
+
+static bool TakeOwnTask(TaskRange* range, size_t* task_id) {
+    assert(range != nullptr);
+    assert(task_id != nullptr);
+
+    std::lock_guard<std::mutex> guard(range->lock);
+    if (range->begin == range->end) {
+        return false;
+    }
+
+    *task_id = range->begin++;
+
+    return true;
+}
+
+static bool StealTasks(Mandelbrot::ThreadPool* pool, size_t thief_id, size_t* task_id) {
+    assert(pool != nullptr);
+    assert(task_id != nullptr);
+
+    for (size_t shift = 1; shift < pool->n_threads; shift++) {
+        TaskRange* victim = &pool->ranges[(thief_id + shift) % pool->n_threads];
+
+        size_t steal_begin = 0;
+        size_t steal_end   = 0;
+        {
+            std::lock_guard<std::mutex> guard(victim->lock);
+            size_t left = victim->end - victim->begin;
+            if (left == 0) {
+                continue;
+            }
+
+            // take the upper half, so the victim keeps the tiles close to its cache
+            steal_begin = victim->end - (left + 1) / 2;
+            steal_end   = victim->end;
+            victim->end = steal_begin;
+        }
+
+        *task_id = steal_begin;
+
+        TaskRange* own = &pool->ranges[thief_id];
+        std::lock_guard<std::mutex> guard(own->lock);
+        own->begin = steal_begin + 1;
+        own->end   = steal_end;
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,491 @@
+#include "tile_cache.h"
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
+#include <algorithm>
+#include <new>
+
+// static ---------------------------------------------------------------------
+
+static const size_t  kTilePixels = (size_t)kTileWidth * kTileHight;
+static const int32_t kNoEntry    = -1;
+
+static const char kDiskMagic[8] = {'M', 'S', 'E', 'T', 'T', 'C', '0', '3'};
+
+static_assert(sizeof(Mandelbrot::TileKey) == 80, "keys are compared and hashed as bytes, no padding");
+
+// first bytes of the cache file, a file with other values is cleared
+struct DiskHeader {
+    char magic[8];
+    uint64_t n_slots;
+    uint64_t tile_width;
+    uint64_t tile_hight;
+    uint8_t reserved[32];
+};
+
+// hash is zeroed before the slot is rewritten and set after, a slot cut short by a crash is skipped
+struct DiskSlot {
+    uint64_t hash;
+    Mandelbrot::TileKey key;
+    uint32_t iter_counts[kTilePixels];
+    float magnitudes[kTilePixels];
+};
+
+struct Mandelbrot::TileCache {
+    std::mutex lock;
+
+    // memory tier, entries are linked from the most to the least recently used
+    size_t n_entries;
+    size_t n_used;
+    TileKey* keys;
+    uint64_t* hashes;
+    uint32_t* iter_counts; // kTilePixels per entry
+    float* magnitudes;
+    int32_t* newer;
+    int32_t* older;
+    int32_t newest;
+    int32_t oldest;
+
+    // open addressing with linear probing, index_mask + 1 slots of entry numbers
+    int32_t* index;
+    size_t index_mask;
+
+    // disk tier, nullptr without a file
+    DiskHeader* disk;
+    DiskSlot* slots;
+    size_t disk_size;
+
+    size_t n_hits;
+    size_t n_disk_hits;
+    size_t n_misses;
+};
+
+static int64_t PlaneQuants(double origin, double step);
+static int32_t TileLeadOf(int64_t quants, int64_t origin, int64_t tile_side);
+
+static uint64_t HashBytes(const void* data, size_t size);
+static bool SameKey(const Mandelbrot::TileKey& a, const Mandelbrot::TileKey& b);
+
+static int32_t FindEntry(const Mandelbrot::TileCache* cache, const Mandelbrot::TileKey& key, uint64_t hash);
+static int32_t TakeEntry(Mandelbrot::TileCache* cache, const Mandelbrot::TileKey& key, uint64_t hash);
+static void RemoveFromIndex(Mandelbrot::TileCache* cache, int32_t entry);
+static void Unlink(Mandelbrot::TileCache* cache, int32_t entry);
+static void LinkNewest(Mandelbrot::TileCache* cache, int32_t entry);
+
+static bool MapDisk(Mandelbrot::TileCache* cache, const char* path);
+
+static void CopyFromFrame(const Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, uint32_t* iter_counts, float* magnitudes);
+static void CopyToFrame(Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, const uint32_t* iter_counts,
+                        const float* magnitudes);
+
+// global ---------------------------------------------------------------------
+
+Mandelbrot::TileCache* Mandelbrot::CreateTileCache(const char* disk_path) {
+    TileCache* cache = new (std::nothrow) TileCache;
+    if (cache == nullptr) {
+        return nullptr;
+    }
+
+    size_t n_index = 1;
+    while (n_index < 2 * kTileCacheTiles) {
+        n_index *= 2;
+    }
+
+    cache->n_entries   = kTileCacheTiles;
+    cache->n_used      = 0;
+    cache->keys        = (TileKey*)calloc(kTileCacheTiles, sizeof(TileKey));
+    cache->hashes      = (uint64_t*)calloc(kTileCacheTiles, sizeof(uint64_t));
+    cache->iter_counts = (uint32_t*)calloc(kTileCacheTiles * kTilePixels, sizeof(uint32_t));
+    cache->magnitudes  = (float*)calloc(kTileCacheTiles * kTilePixels, sizeof(float));
+    cache->newer       = (int32_t*)calloc(kTileCacheTiles, sizeof(int32_t));
+    cache->older       = (int32_t*)calloc(kTileCacheTiles, sizeof(int32_t));
+    cache->newest      = kNoEntry;
+    cache->oldest      = kNoEntry;
+    cache->index       = (int32_t*)calloc(n_index, sizeof(int32_t));
+    cache->index_mask  = n_index - 1;
+    cache->disk        = nullptr;
+    cache->slots       = nullptr;
+    cache->disk_size   = 0;
+    cache->n_hits      = 0;
+    cache->n_disk_hits = 0;
+    cache->n_misses    = 0;
+
+    if (cache->keys == nullptr || cache->hashes == nullptr || cache->iter_counts == nullptr
+        || cache->magnitudes == nullptr || cache->newer == nullptr || cache->older == nullptr
+        || cache->index == nullptr) {
+        DestroyTileCache(cache);
+        return nullptr;
+    }
+
+    std::fill_n(cache->index, n_index, kNoEntry);
+
+    if (disk_path != nullptr && !MapDisk(cache, disk_path)) {
+        DestroyTileCache(cache);
+        return nullptr;
+    }
+
+    return cache;
+}
+
+void Mandelbrot::DestroyTileCache(TileCache* cache) {
+    if (cache == nullptr) {
+        return;
+    }
+
+    if (cache->disk != nullptr) {
+        munmap(cache->disk, cache->disk_size);
+    }
+
+    free(cache->keys);
+    free(cache->hashes);
+    free(cache->iter_counts);
+    free(cache->magnitudes);
+    free(cache->newer);
+    free(cache->older);
+    free(cache->index);
+
+    delete cache;
+}
+
+Mandelbrot::TileKey Mandelbrot::MakeTileKey(const Frame& frame, Tile tile) {
+    assert(frame.precision != Precision::kPerturbation);
+
+    const MSet* m_set = frame.m_set;
+    const Viewport& view = frame.view;
+
+    uint64_t step_bits = 0;
+    memcpy(&step_bits, &view.step, sizeof(step_bits));
+
+    uint64_t radius_bits = 0;
+    memcpy(&radius_bits, &m_set->escape_radius, sizeof(radius_bits));
+
+    uint64_t julia_x_bits = 0;
+    uint64_t julia_y_bits = 0;
+    if (m_set->formula == Formula::kJulia) {
+        memcpy(&julia_x_bits, &m_set->julia_x, sizeof(julia_x_bits));
+        memcpy(&julia_y_bits, &m_set->julia_y, sizeof(julia_y_bits));
+    }
+
+    // tile origin in quantized steps from 0 of the plane
+    TileKey key = {};
+    key.x             = PlaneQuants(view.x0, view.step) + (view.origin_x + tile.x_begin) * kTileCacheQuant;
+    key.y             = PlaneQuants(view.y0, view.step) + (view.origin_y + tile.y_begin) * kTileCacheQuant;
+    key.step          = step_bits >> kTileCacheStepBits;
+    key.max_iter      = m_set->max_iter;
+    key.escape_radius = radius_bits;
+    key.julia_x       = julia_x_bits;
+    key.julia_y       = julia_y_bits;
+    key.kernels       = HashBytes(m_set->kernels->name, strlen(m_set->kernels->name));
+    key.width         = (uint32_t)(tile.x_end - tile.x_begin);
+    key.height        = (uint32_t)(tile.y_end - tile.y_begin);
+    key.precision     = (uint32_t)frame.precision;
+    key.flags         = (uint32_t)m_set->interior_checks | (uint32_t)m_set->keep_magnitudes << 1
+                        | (uint32_t)m_set->formula << 2;
+
+    return key;
+}
+
+void Mandelbrot::TileLead(const Viewport& view, int32_t* lead_x, int32_t* lead_y) {
+    assert(lead_x != nullptr);
+    assert(lead_y != nullptr);
+
+    *lead_x = TileLeadOf(PlaneQuants(view.x0, view.step), view.origin_x, (int64_t)kTileWidth);
+    *lead_y = TileLeadOf(PlaneQuants(view.y0, view.step), view.origin_y, (int64_t)kTileHight);
+}
+
+bool Mandelbrot::LoadTile(TileCache* cache, const TileKey& key, MSet* m_set, Tile tile) {
+    assert(cache != nullptr);
+    assert(m_set != nullptr);
+    assert(key.width * key.height <= kTilePixels);
+    assert(key.width == (uint32_t)(tile.x_end - tile.x_begin) && key.height == (uint32_t)(tile.y_end - tile.y_begin));
+
+    uint64_t hash = HashBytes(&key, sizeof(key));
+
+    std::lock_guard<std::mutex> guard(cache->lock);
+
+    int32_t entry = FindEntry(cache, key, hash);
+    if (entry != kNoEntry) {
+        Unlink(cache, entry);
+        LinkNewest(cache, entry);
+
+        CopyToFrame(m_set, tile, cache->iter_counts + (size_t)entry * kTilePixels,
+                    cache->magnitudes + (size_t)entry * kTilePixels);
+        cache->n_hits++;
+
+        return true;
+    }
+
+    if (cache->disk != nullptr) {
+        const DiskSlot* slot = &cache->slots[hash % cache->disk->n_slots];
+        if (slot->hash == hash && SameKey(slot->key, key)) {
+            CopyToFrame(m_set, tile, slot->iter_counts, slot->magnitudes);
+
+            // back in memory, the next visit does not touch the file
+            entry = TakeEntry(cache, key, hash);
+            std::copy_n(slot->iter_counts, kTilePixels, cache->iter_counts + (size_t)entry * kTilePixels);
+            std::copy_n(slot->magnitudes, kTilePixels, cache->magnitudes + (size_t)entry * kTilePixels);
+            cache->n_disk_hits++;
+
+            return true;
+        }
+    }
+
+    cache->n_misses++;
+
+    return false;
+}
+
+void Mandelbrot::StoreTile(TileCache* cache, const TileKey& key, const MSet* m_set, Tile tile) {
+    assert(cache != nullptr);
+    assert(m_set != nullptr);
+    assert(key.width * key.height <= kTilePixels);
+    assert(tile.x_begin >= 0 && tile.y_begin >= 0);
+    assert(tile.x_end <= (int32_t)m_set->width && tile.y_end <= (int32_t)m_set->height);
+
+    uint64_t hash = HashBytes(&key, sizeof(key));
+
+    std::lock_guard<std::mutex> guard(cache->lock);
+
+    int32_t entry = FindEntry(cache, key, hash);
+    if (entry == kNoEntry) {
+        entry = TakeEntry(cache, key, hash);
+    }
+
+    uint32_t* iter_counts = cache->iter_counts + (size_t)entry * kTilePixels;
+    float* magnitudes = cache->magnitudes + (size_t)entry * kTilePixels;
+    CopyFromFrame(m_set, tile, iter_counts, magnitudes);
+
+    if (cache->disk != nullptr) {
+        DiskSlot* slot = &cache->slots[hash % cache->disk->n_slots];
+
+        slot->hash = 0;
+        slot->key  = key;
+        std::copy_n(iter_counts, kTilePixels, slot->iter_counts);
+        std::copy_n(magnitudes, kTilePixels, slot->magnitudes);
+        slot->hash = hash;
+    }
+}
+
+void Mandelbrot::PrintTileCache(FILE* stream, TileCache* cache) {
+    assert(stream != nullptr);
+    assert(cache != nullptr);
+
+    std::lock_guard<std::mutex> guard(cache->lock);
+
+    fprintf(stream, "# tile cache: %zu hits, %zu from disk, %zu misses, %zu of %zu tiles in memory\n",
+            cache->n_hits, cache->n_disk_hits, cache->n_misses, cache->n_used, cache->n_entries);
+}
+
+// static ---------------------------------------------------------------------
+
+// x0 / step rounded to 1 / kTileCacheQuant: pixel 0 of the lattice in steps from 0 of the plane
+static int64_t PlaneQuants(double origin, double step) {
+    return llround(origin / step * (double)kTileCacheQuant);
+}
+
+// whole steps from 0 of the plane to pixel 0 of the frame, modulo the tile side
+static int32_t TileLeadOf(int64_t quants, int64_t origin, int64_t tile_side) {
+    int64_t whole = quants / kTileCacheQuant - ((quants % kTileCacheQuant < 0) ? 1 : 0) + origin;
+
+    return (int32_t)(((whole % tile_side) + tile_side) % tile_side);
+}
+
+// FNV-1a, the same value in every run, so disk slots stay where they are
+static uint64_t HashBytes(const void* data, size_t size) {
+    assert(data != nullptr);
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+    }
+
+    // 0 marks an empty disk slot
+    return (hash != 0) ? hash : 1;
+}
+
+static bool SameKey(const Mandelbrot::TileKey& a, const Mandelbrot::TileKey& b) {
+    return memcmp(&a, &b, sizeof(Mandelbrot::TileKey)) == 0;
+}
+
+static int32_t FindEntry(const Mandelbrot::TileCache* cache, const Mandelbrot::TileKey& key, uint64_t hash) {
+    assert(cache != nullptr);
+
+    for (size_t pos = hash & cache->index_mask; cache->index[pos] != kNoEntry; pos = (pos + 1) & cache->index_mask) {
+        int32_t entry = cache->index[pos];
+        if (cache->hashes[entry] == hash && SameKey(cache->keys[entry], key)) {
+            return entry;
+        }
+    }
+
+    return kNoEntry;
+}
+
+// a free entry while there is one, the least recently used one after that;
+// returns it indexed under key as the most recently used
+static int32_t TakeEntry(Mandelbrot::TileCache* cache, const Mandelbrot::TileKey& key, uint64_t hash) {
+    assert(cache != nullptr);
+
+    int32_t entry = cache->oldest;
+    if (cache->n_used < cache->n_entries) {
+        entry = (int32_t)cache->n_used++;
+    } else {
+        RemoveFromIndex(cache, entry);
+        Unlink(cache, entry);
+    }
+
+    cache->keys[entry]   = key;
+    cache->hashes[entry] = hash;
+
+    size_t pos = hash & cache->index_mask;
+    while (cache->index[pos] != kNoEntry) {
+        pos = (pos + 1) & cache->index_mask;
+    }
+    cache->index[pos] = entry;
+
+    LinkNewest(cache, entry);
+
+    return entry;
+}
+
+// entries after the hole move back into it unless that would put them before their home slot
+static void RemoveFromIndex(Mandelbrot::TileCache* cache, int32_t entry) {
+    assert(cache != nullptr);
+
+    size_t mask = cache->index_mask;
+
+    size_t hole = cache->hashes[entry] & mask;
+    while (cache->index[hole] != entry) {
+        hole = (hole + 1) & mask;
+    }
+
+    for (size_t pos = (hole + 1) & mask; cache->index[pos] != kNoEntry; pos = (pos + 1) & mask) {
+        size_t home = cache->hashes[cache->index[pos]] & mask;
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            cache->index[hole] = cache->index[pos];
+            hole = pos;
+        }
+    }
+
+    cache->index[hole] = kNoEntry;
+}
+
+static void Unlink(Mandelbrot::TileCache* cache, int32_t entry) {
+    assert(cache != nullptr);
+
+    int32_t newer = cache->newer[entry];
+    int32_t older = cache->older[entry];
+
+    if (newer != kNoEntry) {
+        cache->older[newer] = older;
+    } else {
+        cache->newest = older;
+    }
+
+    if (older != kNoEntry) {
+        cache->newer[older] = newer;
+    } else {
+        cache->oldest = newer;
+    }
+}
+
+static void LinkNewest(Mandelbrot::TileCache* cache, int32_t entry) {
+    assert(cache != nullptr);
+
+    cache->newer[entry] = kNoEntry;
+    cache->older[entry] = cache->newest;
+
+    if (cache->newest != kNoEntry) {
+        cache->newer[cache->newest] = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+// the file is sized for kTileCacheSlots and mapped shared, so tiles written to it stay for the next run
+static bool MapDisk(Mandelbrot::TileCache* cache, const char* path) {
+    assert(cache != nullptr);
+    assert(path != nullptr);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t size = sizeof(DiskHeader) + kTileCacheSlots * sizeof(DiskSlot);
+
+    DiskHeader expected = {};
+    memcpy(expected.magic, kDiskMagic, sizeof(kDiskMagic));
+    expected.n_slots    = kTileCacheSlots;
+    expected.tile_width = kTileWidth;
+    expected.tile_hight = kTileHight;
+
+    DiskHeader header = {};
+    struct stat info = {};
+    bool same_layout = fstat(fd, &info) == 0 && (size_t)info.st_size == size
+                       && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+                       && memcmp(&header, &expected, sizeof(header)) == 0;
+
+    // truncating to zero first drops every old slot, the new file reads as zeros (empty slots)
+    if (!same_layout) {
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)size) != 0
+            || pwrite(fd, &expected, sizeof(expected), 0) != (ssize_t)sizeof(expected)) {
+            close(fd);
+            return false;
+        }
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    cache->disk      = (DiskHeader*)mapped;
+    cache->slots     = (DiskSlot*)(cache->disk + 1);
+    cache->disk_size = size;
+
+    return true;
+}
+
+static void CopyFromFrame(const Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, uint32_t* iter_counts, float* magnitudes) {
+    assert(m_set != nullptr);
+    assert(iter_counts != nullptr);
+    assert(magnitudes != nullptr);
+
+    size_t width = (size_t)(tile.x_end - tile.x_begin);
+    for (int32_t y = tile.y_begin; y < tile.y_end; y++) {
+        size_t pos = (size_t)y * m_set->width + (size_t)tile.x_begin;
+        size_t row = (size_t)(y - tile.y_begin) * width;
+
+        std::copy_n(m_set->iter_counts + pos, width, iter_counts + row);
+        std::copy_n(m_set->magnitudes + pos, width, magnitudes + row);
+    }
+}
+
+// only the part of the tile inside the frame
+static void CopyToFrame(Mandelbrot::MSet* m_set, Mandelbrot::Tile tile, const uint32_t* iter_counts,
+                        const float* magnitudes) {
+    assert(m_set != nullptr);
+    assert(iter_counts != nullptr);
+    assert(magnitudes != nullptr);
+
+    int32_t x_begin = std::max(tile.x_begin, 0);
+    int32_t y_begin = std::max(tile.y_begin, 0);
+    int32_t x_end   = std::min(tile.x_end, (int32_t)m_set->width);
+    int32_t y_end   = std::min(tile.y_end, (int32_t)m_set->height);
+
+    size_t width = (size_t)(tile.x_end - tile.x_begin);
+    for (int32_t y = y_begin; y < y_end; y++) {
+        size_t pos = (size_t)y * m_set->width + (size_t)x_begin;
+        size_t row = (size_t)(y - tile.y_begin) * width + (size_t)(x_begin - tile.x_begin);
+
+        std::copy_n(iter_counts + row, x_end - x_begin, m_set->iter_counts + pos);
+        std::copy_n(magnitudes + row, x_end - x_begin, m_set->magnitudes + pos);
+    }
+}
@@ -0,0 +1,428 @@
+#include "zoom.h"
+#include "expmap.h"
+#include "image.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+// static ---------------------------------------------------------------------
+
+static const size_t kMaxZoomSpec  = 512;
+static const size_t kMaxFramePath = kMaxPathLen + 32;
+
+// rows of the map computed so far, only the last n_slots of them are kept: row k is in slot k % n_slots
+struct MapRing {
+    Mandelbrot::ExpMap map;
+    uint32_t* pixels; // n_slots rows of n_angles rgba
+    size_t n_slots;   // a multiple of kZoomChunkRows, so a chunk never wraps around
+    size_t n_rows;
+};
+
+// what all frames share, they only differ by the pixel step: a pixel is at map row
+// row_offset - log_radius[pos], where row_offset depends on the step of the frame, and column angle[pos]
+struct FrameLayout {
+    size_t width;
+    size_t height;
+    float* log_radius; // ln(distance from the center in pixels) in map rows
+    float* angle;      // in map columns, [0, n_angles)
+
+    // over the pixels which are resampled, the center square is computed directly
+    double min_log_radius;
+    double max_log_radius;
+    Mandelbrot::Tile center;
+};
+
+// one frame, a task resamples one of its rows
+struct ResampleRows {
+    const MapRing* ring;
+    const FrameLayout* layout;
+    double row_offset;
+    uint32_t* pixels;
+};
+
+static bool SetUpLayout(FrameLayout* layout, size_t width, size_t height, size_t n_angles);
+static void TearDownLayout(FrameLayout* layout);
+static bool SetUpRing(MapRing* ring, double radius, size_t n_angles, size_t n_slots);
+static void TearDownRing(MapRing* ring);
+
+static void ExtendRing(Mandelbrot::MSet* m_set, const ZoomJob* zoom, MapRing* ring, size_t last_row);
+static Mandelbrot::Error ComputeCenter(Mandelbrot::MSet* m_set, const ZoomJob* zoom, const FrameLayout& layout,
+                                       double step, uint32_t* pixels);
+static void ResampleTask(void* context, size_t task_id);
+static uint32_t SampleRing(const MapRing* ring, double row, double column);
+
+static void FramePath(const char* pattern, size_t frame, char* path);
+static bool WriteFrame(const ZoomJob* zoom, size_t frame, const uint32_t* pixels);
+
+// global ---------------------------------------------------------------------
+
+bool ParseZoom(const char* spec, ZoomJob* zoom) {
+    assert(spec != nullptr);
+    assert(zoom != nullptr);
+
+    *zoom = {};
+
+    // frames is the field before the output, the rest is a job spec
+    char buffer[kMaxZoomSpec] = {};
+    if (strlen(spec) >= sizeof(buffer)) {
+        return false;
+    }
+    strcpy(buffer, spec);
+
+    char* frames = buffer;
+    for (size_t i = 0; i < 5 && frames != nullptr; i++) {
+        frames = strchr(frames, ',');
+        frames = (frames != nullptr) ? frames + 1 : nullptr;
+    }
+    if (frames == nullptr) {
+        return false;
+    }
+
+    char* output = strchr(frames, ',');
+    if (output == nullptr) {
+        return false;
+    }
+    *output = '\0';
+
+    if (sscanf(frames, "%zu", &zoom->n_frames) != 1 || zoom->n_frames == 0) {
+        return false;
+    }
+
+    // job spec is the buffer up to the frames with the output moved right after it
+    memmove(frames, output + 1, strlen(output + 1) + 1);
+    if (!ParseJob(buffer, &zoom->end)) {
+        return false;
+    }
+
+    // the map ring only goes deeper, a zoom out would need the rows it already dropped
+    if (zoom->end.scale > 1.0) {
+        return false;
+    }
+
+    return strcmp(zoom->end.output, "-") == 0 || strchr(zoom->end.output, '#') != nullptr;
+}
+
+Mandelbrot::Error RenderZoom(Mandelbrot::MSet* m_set, const ZoomJob* zoom) {
+    assert(m_set != nullptr);
+    assert(zoom != nullptr);
+    assert(zoom->end.scale <= 1.0);
+
+    using Mandelbrot::Error;
+
+    const RenderJob& end = zoom->end;
+
+    // see GetViewport, step = scale * 4 / avg_side
+    double avg_side   = (double)(end.width + end.height) / 2.0;
+    double first_step = 4.0 / avg_side;
+    double last_step  = end.scale * 4.0 / avg_side;
+
+    // a cell of the outermost row a frame uses is about one pixel
+    double half_diagonal = hypot((double)end.width, (double)end.height) / 2.0;
+    size_t n_angles = (size_t)ceil(2.0 * M_PI * half_diagonal);
+    double rows_per_log = (double)n_angles / (2.0 * M_PI);
+
+    FrameLayout layout = {};
+    if (!SetUpLayout(&layout, end.width, end.height, n_angles)) {
+        TearDownLayout(&layout);
+        return Error::kBadAlloc;
+    }
+
+    // row 0 is one row outside the corner of the first frame, so a frame never needs a row before it
+    double map_radius = first_step * exp((layout.max_log_radius + 1.0) / rows_per_log);
+
+    size_t window  = (size_t)ceil(layout.max_log_radius - layout.min_log_radius) + 2;
+    size_t n_slots = (window + 2 * kZoomChunkRows - 1) / kZoomChunkRows * kZoomChunkRows;
+
+    MapRing ring = {};
+    uint32_t* pixels = (uint32_t*)calloc(end.width * end.height, sizeof(uint32_t));
+    if (pixels == nullptr || !SetUpRing(&ring, map_radius, n_angles, n_slots)) {
+        free(pixels);
+        TearDownRing(&ring);
+        TearDownLayout(&layout);
+        return Error::kBadAlloc;
+    }
+
+    size_t n_center = (size_t)(layout.center.x_end - layout.center.x_begin)
+                      * (size_t)(layout.center.y_end - layout.center.y_begin);
+
+    Error error = Error::kOk;
+    for (size_t frame = 0; frame < zoom->n_frames && error == Error::kOk; frame++) {
+        double progress = (zoom->n_frames > 1) ? (double)frame / (double)(zoom->n_frames - 1) : 1.0;
+        double step = first_step * pow(last_step / first_step, progress);
+
+        ResampleRows rows = {};
+        rows.ring       = &ring;
+        rows.layout     = &layout;
+        rows.row_offset = log(map_radius / step) * rows_per_log;
+        rows.pixels     = pixels;
+
+        // n_center == width * height leaves nothing to resample
+        if (n_center < end.width * end.height) {
+            ExtendRing(m_set, zoom, &ring, (size_t)ceil(rows.row_offset - layout.min_log_radius) + 1);
+            Mandelbrot::RunTasks(m_set->pool, end.height, ResampleTask, &rows);
+        }
+
+        error = ComputeCenter(m_set, zoom, layout, step, pixels);
+        if (error != Error::kOk) {
+            fprintf(stderr, "# Error: zoom frame %zu: bad alloc\n", frame);
+            break;
+        }
+
+        if (!WriteFrame(zoom, frame, pixels)) {
+            fprintf(stderr, "# Error: zoom frame %zu: can not write it\n", frame);
+            error = Error::kBadFile;
+        }
+    }
+
+    // direct is what a Compute of every frame would iterate
+    double map_points = (double)(ring.n_rows * n_angles) + (double)(n_center * zoom->n_frames);
+    double direct_points = (double)(end.width * end.height) * (double)zoom->n_frames;
+    fprintf(stderr, "# zoom: %zu frames, %zu map rows of %zu points, %.0f points computed against %.0f frame by frame\n",
+            zoom->n_frames, ring.n_rows, n_angles, map_points, direct_points);
+
+    free(pixels);
+    TearDownRing(&ring);
+    TearDownLayout(&layout);
+
+    return error;
+}
+
+// static ---------------------------------------------------------------------
+
+// center square has the parity of the frame, so its pixels are exactly frame pixels
+static bool SetUpLayout(FrameLayout* layout, size_t width, size_t height, size_t n_angles) {
+    assert(layout != nullptr);
+
+    layout->width      = width;
+    layout->height     = height;
+    layout->log_radius = (float*)calloc(width * height, sizeof(float));
+    layout->angle      = (float*)calloc(width * height, sizeof(float));
+
+    if (layout->log_radius == nullptr || layout->angle == nullptr) {
+        return false;
+    }
+
+    size_t center_width  = std::min(2 * kZoomCenterPixels + width  % 2, width);
+    size_t center_height = std::min(2 * kZoomCenterPixels + height % 2, height);
+
+    layout->center.x_begin = (int32_t)((width  - center_width)  / 2);
+    layout->center.y_begin = (int32_t)((height - center_height) / 2);
+    layout->center.x_end   = layout->center.x_begin + (int32_t)center_width;
+    layout->center.y_end   = layout->center.y_begin + (int32_t)center_height;
+
+    double rows_per_log = (double)n_angles / (2.0 * M_PI);
+
+    layout->min_log_radius = HUGE_VAL;
+    layout->max_log_radius = -HUGE_VAL;
+
+    // pixel x is at x - width / 2 steps from the center, see GetViewport
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            double dx = (double)x - (double)width  / 2.0;
+            double dy = (double)y - (double)height / 2.0;
+
+            double log_radius = log(hypot(dx, dy)) * rows_per_log;
+            // float may round the last column up to n_angles
+            float angle = (float)(atan2(dy, dx) * rows_per_log + ((dy < 0.0) ? (double)n_angles : 0.0));
+            if (angle >= (float)n_angles) {
+                angle = 0.0f;
+            }
+
+            layout->log_radius[y * width + x] = (float)log_radius;
+            layout->angle[y * width + x]      = angle;
+
+            bool in_center = (int32_t)x >= layout->center.x_begin && (int32_t)x < layout->center.x_end
+                             && (int32_t)y >= layout->center.y_begin && (int32_t)y < layout->center.y_end;
+            if (!in_center) {
+                layout->min_log_radius = std::min(layout->min_log_radius, log_radius);
+                layout->max_log_radius = std::max(layout->max_log_radius, log_radius);
+            }
+        }
+    }
+
+    // whole frame is the center square
+    if (layout->min_log_radius > layout->max_log_radius) {
+        layout->min_log_radius = 0.0;
+        layout->max_log_radius = 0.0;
+    }
+
+    return true;
+}
+
+static void TearDownLayout(FrameLayout* layout) {
+    assert(layout != nullptr);
+
+    free(layout->log_radius);
+    free(layout->angle);
+    layout->log_radius = nullptr;
+    layout->angle      = nullptr;
+}
+
+static bool SetUpRing(MapRing* ring, double radius, size_t n_angles, size_t n_slots) {
+    assert(ring != nullptr);
+
+    if (Mandelbrot::SetUpExpMap(&ring->map, radius, n_angles) != Mandelbrot::Error::kOk) {
+        return false;
+    }
+
+    ring->pixels  = (uint32_t*)calloc(n_slots * n_angles, sizeof(uint32_t));
+    ring->n_slots = n_slots;
+    ring->n_rows  = 0;
+
+    return ring->pixels != nullptr;
+}
+
+static void TearDownRing(MapRing* ring) {
+    assert(ring != nullptr);
+
+    free(ring->pixels);
+    ring->pixels = nullptr;
+
+    if (ring->map.cos_table != nullptr || ring->map.sin_table != nullptr) {
+        Mandelbrot::TearDownExpMap(&ring->map);
+    }
+}
+
+// whole chunks until last_row is there, the rows they overwrite are behind every later frame
+static void ExtendRing(Mandelbrot::MSet* m_set, const ZoomJob* zoom, MapRing* ring, size_t last_row) {
+    assert(m_set != nullptr);
+    assert(zoom != nullptr);
+    assert(ring != nullptr);
+
+    while (ring->n_rows <= last_row) {
+        SetJobView(m_set, &zoom->end);
+
+        uint32_t* chunk = ring->pixels + (ring->n_rows % ring->n_slots) * ring->map.n_angles;
+        Mandelbrot::ComputeExpMap(m_set, ring->map, ring->n_rows, kZoomChunkRows, chunk);
+
+        ring->n_rows += kZoomChunkRows;
+    }
+}
+
+// a small frame of its own with the same center and step, any precision, antialiasing or cache applies to it
+static Mandelbrot::Error ComputeCenter(Mandelbrot::MSet* m_set, const ZoomJob* zoom, const FrameLayout& layout,
+                                       double step, uint32_t* pixels) {
+    assert(m_set != nullptr);
+    assert(zoom != nullptr);
+    assert(pixels != nullptr);
+
+    size_t width  = (size_t)(layout.center.x_end - layout.center.x_begin);
+    size_t height = (size_t)(layout.center.y_end - layout.center.y_begin);
+
+    Mandelbrot::Error error = Mandelbrot::Resize(m_set, width, height);
+    if (error != Mandelbrot::Error::kOk) {
+        return error;
+    }
+
+    SetJobView(m_set, &zoom->end);
+    m_set->scale = step * (double)(width + height) / 8.0;
+    Mandelbrot::Compute(m_set);
+
+    for (size_t y = 0; y < height; y++) {
+        size_t pos = ((size_t)layout.center.y_begin + y) * layout.width + (size_t)layout.center.x_begin;
+        memcpy(pixels + pos, m_set->pixels + 4 * y * width, 4 * width);
+    }
+
+    return Mandelbrot::Error::kOk;
+}
+
+static void ResampleTask(void* context, size_t task_id) {
+    assert(context != nullptr);
+
+    const ResampleRows* rows = (const ResampleRows*)context;
+    const FrameLayout* layout = rows->layout;
+
+    int32_t y = (int32_t)task_id;
+    bool center_row = y >= layout->center.y_begin && y < layout->center.y_end;
+
+    for (int32_t x = 0; x < (int32_t)layout->width; x++) {
+        if (center_row && x >= layout->center.x_begin && x < layout->center.x_end) {
+            continue;
+        }
+
+        size_t pos = task_id * layout->width + (size_t)x;
+        rows->pixels[pos] = SampleRing(rows->ring, rows->row_offset - (double)layout->log_radius[pos],
+                                       (double)layout->angle[pos]);
+    }
+}
+
+// bilinear between the four cells around (row, column), columns wrap around the circle;
+// weights are in 1/256 like the bytes they mix
+static uint32_t SampleRing(const MapRing* ring, double row, double column) {
+    assert(ring != nullptr);
+    assert(row >= 0.0);
+    assert(column >= 0.0 && column < (double)ring->map.n_angles);
+
+    size_t n_angles = ring->map.n_angles;
+
+    size_t row_0 = (size_t)row;
+    size_t col_0 = (size_t)column;
+    size_t col_1 = (col_0 + 1 < n_angles) ? col_0 + 1 : 0;
+
+    assert(row_0 + 1 < ring->n_rows);
+    assert(row_0 + ring->n_slots >= ring->n_rows);
+
+    size_t slot_0 = row_0 % ring->n_slots;
+    size_t slot_1 = (slot_0 + 1 < ring->n_slots) ? slot_0 + 1 : 0;
+
+    uint32_t row_frac = (uint32_t)((row - (double)row_0) * 256.0);
+    uint32_t col_frac = (uint32_t)((column - (double)col_0) * 256.0);
+
+    const uint32_t* upper = ring->pixels + slot_0 * n_angles;
+    const uint32_t* lower = ring->pixels + slot_1 * n_angles;
+
+    const uint32_t texels[4] = {upper[col_0], upper[col_1], lower[col_0], lower[col_1]};
+    const uint32_t weights[4] = {(256 - row_frac) * (256 - col_frac), (256 - row_frac) * col_frac,
+                                 row_frac * (256 - col_frac), row_frac * col_frac};
+
+    uint32_t pixel = 0;
+    for (uint32_t c = 0; c < 32; c += 8) {
+        uint32_t sum = 1u << 15;
+        for (size_t i = 0; i < 4; i++) {
+            sum += weights[i] * ((texels[i] >> c) & 0xFF);
+        }
+
+        pixel |= (sum >> 16) << c;
+    }
+
+    return pixel;
+}
+
+// first run of '#' becomes the frame number padded with zeros to its length
+static void FramePath(const char* pattern, size_t frame, char* path) {
+    assert(pattern != nullptr);
+    assert(path != nullptr);
+
+    const char* hashes = strchr(pattern, '#');
+    assert(hashes != nullptr);
+
+    size_t prefix = (size_t)(hashes - pattern);
+    size_t digits = strspn(hashes, "#");
+
+    snprintf(path, kMaxFramePath, "%.*s%0*zu%s", (int)prefix, pattern, (int)digits, frame, hashes + digits);
+}
+
+static bool WriteFrame(const ZoomJob* zoom, size_t frame, const uint32_t* pixels) {
+    assert(zoom != nullptr);
+    assert(pixels != nullptr);
+
+    const RenderJob& end = zoom->end;
+
+    if (strcmp(end.output, "-") == 0) {
+        return WriteImage(stdout, ImageFormat::kRaw, (const uint8_t*)pixels, end.width, end.height)
+               && fflush(stdout) == 0;
+    }
+
+    char path[kMaxFramePath] = {};
+    FramePath(end.output, frame, path);
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool ok = WriteImage(file, FormatFromPath(path), (const uint8_t*)pixels, end.width, end.height);
+
+    return (fclose(file) == 0) && ok;
+}